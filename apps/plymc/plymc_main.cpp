@@ -57,6 +57,9 @@ void usage()
       " -p       use vertex splatting instead face rasterizing\n"
       " -d#     set <n> as verbose level (default 0)\n"
       " -D#     save <n> debug slices during processing\n"
+      " -b#     keep the merged volume out of core with at most <n> 8^3 blocks in memory\n"
+      "         marching cubes needs two layers of blocks (2*(sx/8)*(sz/8) blocks for a\n"
+      "         volume of sx*sy*sz voxels): with fewer blocks it keeps reloading them\n"
 
       "\nNotes:\n\n"
       "The Quality threshold can be expressed in voxel unit or in absolute units.\n"
@@ -196,6 +199,7 @@ int main(int argc, char *argv[])
 	case 'd' : p.VerboseLevel=atoi(argv[i]+2);printf("Enabling VerboseLevel= %i )\n",p.VerboseLevel);break;
   case 'D' : p.VerboseLevel=1; p.SliceNum=atoi(argv[i]+2);printf("Enabling Debug Volume saving of %i slices (VerboseLevel=1)\n",p.SliceNum);break;
 	case 'M' :	p.SimplificationFlag =true; printf("Enabling PostReconstruction simplification\n"); break;
+	case 'b' :	p.MaxResidentBlocks=atoi(argv[i]+2); printf("Setting out of core volume with at most %i blocks in memory\n",p.MaxResidentBlocks); break;
 		default : {printf("Error unable to parse option '%s'\n",argv[i]); exit(0);}
     }
     ++i;
@@ -33,6 +33,7 @@
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/complex/algorithms/update/flag.h>
 #include <vcg/complex/algorithms/clustering.h>
+#include <vcg/complex/algorithms/clustering_ooc.h>
 
 // input output
 #include <wrap/io_trimesh/import.h>
@@ -57,6 +58,7 @@ int  main(int argc, char **argv)
           "-k cellnum     approx number of cluster that should be defined; (default 10e5)\n"
           "-s size        in absolute units the size of the clustering cell (override the previous param)\n"
           "-d             enable the duplication of faces for double surfaces\n"
+          "-o             out of core: stream the input without loading it\n"
           );
     exit(0);
   }
@@ -64,6 +66,7 @@ int  main(int argc, char **argv)
   int CellNum=100000;
   float CellSize=0;
   bool DupFace=false;
+  bool OutOfCore=false;
 
   int i=3;
   while(i<argc)
@@ -75,13 +78,39 @@ int  main(int argc, char **argv)
     case 'k' :	CellNum=atoi(argv[i+1]); ++i; printf("Using %i clustering cells\n",CellNum); break;
     case 's' :	CellSize=atof(argv[i+1]); ++i; printf("Using %5f as clustering cell size\n",CellSize); break;
     case 'd' :	DupFace=true; printf("Enabling the duplication of faces for double surfaces\n"); break;
+    case 'o' :	OutOfCore=true; printf("Streaming the input mesh\n"); break;
 
     default : {printf("Error unable to parse option '%s'\n",argv[i]); exit(0);}
     }
     ++i;
   }
 
+  typedef vcg::tri::AverageColorCell<MyMesh> CellType;
   MyMesh m;
+  if(OutOfCore)
+  {
+    vcg::Box3f bb;
+    if(!vcg::tri::StreamingClustering<MyMesh,CellType>::ScanBBox(argv[1],bb))
+    {
+      printf("Error reading file  %s\n",argv[1]);
+      exit(0);
+    }
+    vcg::tri::StreamingClustering<MyMesh,CellType> Grid;
+    Grid.DuplicateFaceParam=DupFace;
+    Grid.Init(bb,CellNum,CellSize);
+    printf("Grid of %i x %i x %i cells\n",Grid.Grid.siz[0],Grid.Grid.siz[1],Grid.Grid.siz[2]);
+    int err=Grid.AddPly(argv[1]);
+    if(err!=0)
+    {
+      printf("Error reading file  %s: %s\n",argv[1],vcg::tri::io::ImporterPLY<MyMesh>::ErrorMsg(err));
+      exit(0);
+    }
+    Grid.ExtractMesh(m);
+    printf("Output mesh vn:%i fn:%i\n",m.VN(),m.FN());
+    vcg::tri::io::ExporterPLY<MyMesh>::Save(m,argv[2]);
+    return 0;
+  }
+
   if(vcg::tri::io::ImporterPLY<MyMesh>::Open(m,argv[1])!=0)
   {
     printf("Error reading file  %s\n",argv[1]);
@@ -91,7 +120,7 @@ int  main(int argc, char **argv)
   vcg::tri::UpdateBounding<MyMesh>::Box(m);
   vcg::tri::UpdateNormal<MyMesh>::PerFace(m);
   printf("Input mesh  vn:%i fn:%i\n",m.VN(),m.FN());
-  vcg::tri::Clustering<MyMesh, vcg::tri::AverageColorCell<MyMesh> > Grid;
+  vcg::tri::Clustering<MyMesh, CellType> Grid;
   Grid.DuplicateFaceParam=DupFace;
   Grid.Init(m.bbox,CellNum,CellSize);
   
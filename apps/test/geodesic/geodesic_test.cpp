@@ -0,0 +1,122 @@
+// STD headers
+#include <iostream>
+#include <algorithm>
+
+// VCG headers
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/geodesic.h>
+#include <vcg/math/random_generator.h>
+
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public vcg::UsedTypes<	vcg::Use<MyVertex>::AsVertexType, vcg::Use<MyFace>::AsFaceType>{};
+class MyVertex : public vcg::Vertex< MyUsedTypes, vcg::vertex::Coord3f, vcg::vertex::Qualityf, vcg::vertex::VFAdj, vcg::vertex::Mark, vcg::vertex::BitFlags >{};
+class MyFace   : public vcg::Face  < MyUsedTypes, vcg::face::VertexRef, vcg::face::VFAdj, vcg::face::BitFlags > {};
+class MyMesh   : public vcg::tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> > {};
+
+// exact geodesic distance on the unit sphere from the nearest seed
+void exactDistance(MyMesh &m, const std::vector<MyMesh::VertexPointer> &seedVec, std::vector<double> &d)
+{
+  d.assign(m.vert.size(),std::numeric_limits<double>::max());
+  for(size_t i=0;i<m.vert.size();++i)
+    for(size_t j=0;j<seedVec.size();++j)
+    {
+      const double chord=vcg::Distance(m.vert[i].cP(),seedVec[j]->cP());
+      d[i]=std::min(d[i],2*asin(std::min(1.0,chord/2)));
+    }
+}
+
+// TEST - AFTER SEVERAL MOVES OF THE SEEDS, UPDATE() MUST AGREE WITH A FULL COMPUTE() BETTER THAN COMPUTE() AGREES WITH THE EXACT DISTANCE
+///////////////////////////////////////////////////////////////////////////////
+bool testUpdate()
+{
+  MyMesh m;
+  vcg::tri::Sphere(m,6);
+  vcg::math::MarsenneTwisterRNG rnd(2);
+  std::vector<MyMesh::VertexPointer> seedVec;
+  for(int i=0;i<200;++i)
+  {
+    MyMesh::VertexPointer v=&m.vert[rnd.generate(m.vn)];
+    if(std::find(seedVec.begin(),seedVec.end(),v)==seedVec.end()) seedVec.push_back(v);
+  }
+  vcg::tri::EuclideanDistance<MyMesh> df;
+  vcg::tri::ParallelGeodesic<MyMesh> incremental(m), full(m);
+  incremental.Compute(seedVec,df);
+
+  bool ok=true;
+  std::vector<double> exact;
+  for(int it=0;it<10;++it)
+  {
+    for(int k=0;k<10;++k)
+    {
+      MyMesh::VertexPointer v=&m.vert[rnd.generate(m.vn)];
+      if(std::find(seedVec.begin(),seedVec.end(),v)==seedVec.end()) seedVec[rnd.generate(seedVec.size())]=v;
+    }
+    incremental.Update(seedVec,df);
+    full.Compute(seedVec,df);
+    exactDistance(m,seedVec,exact);
+    double diff=0,approxErr=0;
+    for(int i=0;i<m.vn;++i)
+    {
+      diff=std::max(diff,double(std::fabs(incremental.Dist()[i]-full.Dist()[i])));
+      approxErr=std::max(approxErr,std::fabs(full.Dist()[i]-exact[i]));
+    }
+    std::cout << "  iteration " << it << ": update vs compute " << diff << ", compute vs exact " << approxErr << std::endl;
+    if(diff>0.75*approxErr) ok=false;
+  }
+  return ok;
+}
+
+// TEST - COMPUTE() MUST AGREE WITH THE SERIAL GEODESIC::COMPUTE() WITHIN HALF THE AVERAGE EDGE LENGTH
+///////////////////////////////////////////////////////////////////////////////
+bool testSerial(int subdiv, int seedNum)
+{
+  MyMesh m;
+  vcg::tri::Sphere(m,subdiv);
+  vcg::tri::UpdateTopology<MyMesh>::VertexFace(m);
+  double avgEdge=0;
+  for(int i=0;i<m.fn;++i)
+    for(int j=0;j<3;++j)
+      avgEdge+=vcg::Distance(m.face[i].cP0(j),m.face[i].cP1(j));
+  avgEdge/=3*m.fn;
+
+  vcg::math::MarsenneTwisterRNG rnd(1);
+  std::vector<MyMesh::VertexPointer> seedVec;
+  for(int i=0;i<seedNum;++i)
+  {
+    MyMesh::VertexPointer v=&m.vert[rnd.generate(m.vn)];
+    if(std::find(seedVec.begin(),seedVec.end(),v)==seedVec.end()) seedVec.push_back(v);
+  }
+  vcg::tri::EuclideanDistance<MyMesh> df;
+  vcg::tri::ParallelGeodesic<MyMesh> pg(m);
+  pg.Compute(seedVec,df);
+  vcg::tri::Geodesic<MyMesh>::Compute(m,seedVec,df);
+
+  double diff=0;
+  for(int i=0;i<m.vn;++i)
+    diff=std::max(diff,double(std::fabs(pg.Dist()[i]-m.vert[i].Q())));
+  std::cout << "  " << m.vn << " vertices, " << seedVec.size() << " seeds: parallel vs serial " << diff << ", average edge " << avgEdge << std::endl;
+  return diff<0.5*avgEdge;
+}
+
+int main()
+{
+  int failed=0;
+  if(testUpdate())
+    std::cout << "TEST 1 (incremental update) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 1 (incremental update) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  if(testSerial(6,10) && testSerial(5,200))
+    std::cout << "TEST 2 (parallel vs serial) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 2 (parallel vs serial) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  return failed;
+}
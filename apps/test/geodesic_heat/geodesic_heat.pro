@@ -0,0 +1,10 @@
+TARGET = geodesic_heat_test
+INCLUDEPATH += . ../../.. ../../../eigenlib
+CONFIG += console stl c++11
+TEMPLATE = app
+SOURCES += geodesic_heat_test.cpp
+
+win32: CONFIG += NOMINMAX
+
+# Mac specific Config required to avoid to make application bundles
+CONFIG -= app_bundle
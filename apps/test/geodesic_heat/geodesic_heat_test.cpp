@@ -0,0 +1,57 @@
+// STD headers
+#include <iostream>
+
+// VCG headers
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/geodesic_heat.h>
+
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public vcg::UsedTypes<	vcg::Use<MyVertex>::AsVertexType, vcg::Use<MyFace>::AsFaceType>{};
+class MyVertex : public vcg::Vertex< MyUsedTypes, vcg::vertex::Coord3f, vcg::vertex::Qualityf, vcg::vertex::BitFlags >{};
+class MyFace   : public vcg::Face  < MyUsedTypes, vcg::face::VertexRef, vcg::face::FFAdj, vcg::face::BitFlags > {};
+class MyMesh   : public vcg::tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> > {};
+
+// TEST - ON AN OPEN PLANE THE DISTANCE MUST BE CLOSE TO THE EUCLIDEAN ONE, ALSO ALONG THE BORDER
+///////////////////////////////////////////////////////////////////////////////
+bool testOpenPlane()
+{
+  const int n=61;
+  MyMesh m;
+  vcg::tri::Grid(m,n,n,1,1);
+  vcg::tri::UpdateTopology<MyMesh>::FaceFace(m);
+  vcg::tri::UpdateFlags<MyMesh>::FaceBorderFromFF(m);
+
+  MyMesh::VertexPointer seed=&m.vert[(n/2)*n+n/2];
+  vcg::tri::HeatGeodesic<MyMesh> hg(m);
+  std::vector<MyMesh::VertexPointer> seedVec(1,seed);
+  if(!hg.Compute(seedVec)) return false;
+
+  double innerErr=0,borderErr=0;
+  for(int i=0;i<n;++i)
+    for(int j=0;j<n;++j)
+    {
+      const MyVertex &v=m.vert[i*n+j];
+      const double err=std::fabs(v.Q()-vcg::Distance(v.cP(),seed->cP()));
+      if(i==0 || j==0 || i==n-1 || j==n-1) borderErr=std::max(borderErr,err);
+      else innerErr=std::max(innerErr,err);
+    }
+  const double cornerErr=std::fabs(m.vert[0].Q()-std::sqrt(0.5));
+  std::cout << "  max error inside " << innerErr << ", on the border " << borderErr << ", at the corner " << cornerErr << std::endl;
+  return innerErr<0.02 && borderErr<0.02 && cornerErr<0.005;
+}
+
+int main()
+{
+  int failed=0;
+  if(testOpenPlane())
+    std::cout << "TEST 1 (open plane) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 1 (open plane) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  return failed;
+}
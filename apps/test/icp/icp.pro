@@ -0,0 +1,10 @@
+TARGET = icp_test
+INCLUDEPATH += . ../../.. ../../../eigenlib
+CONFIG += console stl c++11
+TEMPLATE = app
+SOURCES += icp_test.cpp
+
+win32: CONFIG += NOMINMAX
+
+# Mac specific Config required to avoid to make application bundles
+CONFIG -= app_bundle
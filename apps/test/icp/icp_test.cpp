@@ -0,0 +1,113 @@
+// STD headers
+#include <iostream>
+
+// VCG headers
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/complex/algorithms/icp.h>
+#include <vcg/complex/append.h>
+
+class MyFace;
+class MyVertex;
+struct MyUsedTypes : public vcg::UsedTypes<	vcg::Use<MyVertex>::AsVertexType, vcg::Use<MyFace>::AsFaceType>{};
+class MyVertex : public vcg::Vertex< MyUsedTypes, vcg::vertex::Coord3f, vcg::vertex::Normal3f, vcg::vertex::BitFlags >{};
+class MyFace   : public vcg::Face  < MyUsedTypes, vcg::face::VertexRef, vcg::face::Normal3f, vcg::face::BitFlags > {};
+class MyMesh   : public vcg::tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> > {};
+
+typedef vcg::tri::ICP<MyMesh> ICPType;
+
+// distance between the points of the mesh moved with the found and with the exact transformation
+double maxError(MyMesh &m, const vcg::Matrix44f &tr, const vcg::Matrix44f &exact)
+{
+  double err=0;
+  for(size_t i=0;i<m.vert.size();++i)
+    err=std::max(err,double(vcg::Distance(tr*m.vert[i].P(),exact*m.vert[i].P())));
+  return err;
+}
+
+// TEST - ICP MUST CONVERGE (NOT JUST STOP AT maxIterNum) ON A MOVED COPY, WITH THE DEFAULT THRESHOLDS
+///////////////////////////////////////////////////////////////////////////////
+bool testConvergence(MyMesh &fix, bool pointToPlane, float angleDeg, float shift)
+{
+  MyMesh mov;
+  vcg::tri::Append<MyMesh,MyMesh>::MeshCopy(mov,fix);
+  vcg::Matrix44f rot,tra;
+  rot.SetRotateDeg(angleDeg,vcg::Point3f(1,2,3).Normalize());
+  tra.SetTranslate(shift,-shift/2,shift/3);
+  vcg::Matrix44f movTr=tra*rot;
+  vcg::tri::UpdatePosition<MyMesh>::Matrix(mov,movTr);
+  vcg::Matrix44f exact=vcg::Inverse(movTr);
+
+  ICPType icp;
+  icp.par.pointToPlane=pointToPlane;
+  icp.par.sampleNum=2000;
+  icp.Init(fix);
+  vcg::Matrix44f tr; tr.SetIdentity();
+  ICPType::Stat st;
+  if(!icp.Align(mov,tr,st)) return false;
+  const double err=maxError(mov,tr,exact);
+  std::cout << "  " << st.iterNum() << " iterations, error " << err << std::endl;
+  return st.converged && st.iterNum()<icp.par.maxIterNum && err<1e-3;
+}
+
+// TEST - THE POINT TO PLANE SOLVER MUST REJECT A PLANAR (SINGULAR) INPUT AND ACCEPT A BUMPY ONE
+///////////////////////////////////////////////////////////////////////////////
+bool testDegenerate()
+{
+  bool ok=true;
+  for(int bumpy=0;bumpy<2;++bumpy)
+  {
+    std::vector<vcg::Point3f> fixVec,norVec,movVec;
+    std::vector<float> weightVec;
+    for(int i=0;i<20;++i)
+      for(int j=0;j<20;++j)
+      {
+        const float x=100+i*0.5f, y=j*0.5f;
+        const float h=bumpy?0.5f:0.0f;
+        fixVec.push_back(vcg::Point3f(x,y,h*sin(x)*cos(y)));
+        norVec.push_back(vcg::Point3f(-h*cos(x)*cos(y),h*sin(x)*sin(y),1).Normalize());
+        movVec.push_back(fixVec.back()+vcg::Point3f(0.01f,0.02f,0.03f));
+        weightVec.push_back(1);
+      }
+    vcg::Matrix44f res;
+    const bool solved=vcg::ComputeRigidMatchMatrixPointToPlane(fixVec,norVec,movVec,weightVec,res);
+    std::cout << "  " << (bumpy?"bumpy":"planar") << " patch: " << (solved?"solved":"degenerate") << std::endl;
+    if(solved!=(bumpy==1)) ok=false;
+  }
+  return ok;
+}
+
+int main()
+{
+  MyMesh fix;
+  vcg::tri::Torus(fix,3,1,96,48);
+  // make it non symmetric, so the registration has a single solution
+  for(size_t i=0;i<fix.vert.size();++i)
+    fix.vert[i].P()[2]+=0.2f*sin(2*fix.vert[i].P()[0])*cos(3*fix.vert[i].P()[1]);
+  vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(fix);
+
+  int failed=0;
+  if(testConvergence(fix,false,0.5f,0.01f))
+    std::cout << "TEST 1 (point to point convergence) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 1 (point to point convergence) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  if(testConvergence(fix,true,3.0f,0.05f))
+    std::cout << "TEST 2 (point to plane convergence) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 2 (point to plane convergence) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  if(testDegenerate())
+    std::cout << "TEST 3 (point to plane degenerate input) - PASSED(!)" << std::endl;
+  else
+  {
+    std::cout << "TEST 3 (point to plane degenerate input) - FAILED(!)" << std::endl;
+    ++failed;
+  }
+  return failed;
+}
@@ -0,0 +1,476 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_ALIGN_GLOBAL
+#define __VCGLIB_ALIGN_GLOBAL
+
+#include <eigenlib/Eigen/Sparse>
+#include <vcg/complex/algorithms/icp.h>
+
+namespace vcg{
+namespace tri{
+
+/*! \brief Global registration of many roughly aligned range maps.
+
+Only a random subset of Param::viewSampleNum vertices (with their normals) of each view is kept in memory,
+in the view local frame, so the meshes can be freed after AddView() and the memory grows linearly with the number of views.
+
+Process() works in two steps:
+ - <b>pairwise alignment</b>: the pairs of views whose bounding boxes intersect (in the current poses) are candidates.
+   The overlap of a pair is the fraction of the samples of the moving view that have a fix point closer than
+   Param::consensusDist with a normal within Param::consensusNormalDot (the consensus criterion of OverlapEstimation).
+   The pairs that overlap enough are registered with ICP (two passes, the second with half the distance threshold).
+   The work is split by fix view and the views are processed in parallel:
+   each task builds the index of its fix view, uses it for all its pairs and then frees it, so only one index per thread is alive.
+ - <b>global alignment</b>: each registered pair keeps Param::matesNum of its consensus samples as virtual mates
+   (the sample in the moving view and its image in the fix view through the pairwise matrix, see Pulli 1999).
+   The poses minimizing the distance of all the mates are found by Gauss-Newton iterations; each one linearizes
+   the rotations and solves the sparse normal equations (6 unknowns per view) with a sparse Cholesky factorization.
+   The first view of each connected component of the pair graph does not move.
+
+\code
+GlobalAlignment<MyMesh> ga;
+for(...) ga.AddView(mesh[i],pose[i]);      // meshes can be freed
+ga.Process();
+for(...) pose[i]=ga.Tr(i);
+\endcode
+
+Ref:
+K.Pulli
+Multiview registration for large data sets
+3DIM 1999
+*/
+template <class MeshType>
+class GlobalAlignment
+{
+public:
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef typename MeshType::CoordType CoordType;
+  typedef typename MeshType::VertexIterator VertexIterator;
+  typedef Matrix44<ScalarType> Matrix44x;
+  typedef Box3<ScalarType> Box3x;
+  typedef ICP<MeshType> ICPType;
+  typedef Eigen::SparseMatrix<double> SpMat;
+  typedef Point3<double> Point3x;
+
+  class Param
+  {
+  public:
+    int viewSampleNum;             ///< points of each view kept in memory
+    ScalarType consensusDist;      ///< distance for the overlap consensus (0 means 2% of the average diagonal of the views)
+    ScalarType consensusNormalDot; ///< minimum dot product of the normals for the overlap consensus (not checked if the views have no normals)
+    int overlapSampleNum;          ///< samples of the moving view used to estimate the overlap
+    ScalarType minOverlap;         ///< pairs with a smaller overlap (before or after ICP) are discarded
+    int matesNum;                  ///< virtual mates kept for each pair
+    int maxGlobalIterNum;          ///< maximum number of Gauss-Newton iterations of the global alignment
+    ScalarType minGlobalStep;      ///< the global alignment stops when no view moves more than this (0 means consensusDist/1000)
+    unsigned int randSeed;
+    typename ICPType::Param icp;   ///< parameters of the pairwise ICP (maxDistance 0 means consensusDist, minTrStep 0 means minGlobalStep)
+
+    Param()
+    {
+      viewSampleNum=10000;
+      consensusDist=0;
+      consensusNormalDot=0.965f; // 15 degrees
+      overlapSampleNum=1000;
+      minOverlap=0.1f;
+      matesNum=100;
+      maxGlobalIterNum=20;
+      minGlobalStep=0;
+      randSeed=0;
+      icp.sampleNum=2000;
+      icp.trimRatio=0.7f;
+      icp.pointToPlane=true;     // used only if the views have normals
+    }
+  };
+
+  class View
+  {
+  public:
+    std::vector<CoordType> pos;   ///< samples, in local coords
+    std::vector<CoordType> nor;   ///< their normals (empty if the mesh had none)
+    Box3x bbox;                   ///< local bounding box of the samples
+    Matrix44x tr;                 ///< pose: local to global coords
+  };
+
+  class AlignPair
+  {
+  public:
+    int fix,mov;
+    bool valid;
+    ScalarType initOverlap;       ///< overlap in the starting poses
+    ScalarType overlap;           ///< overlap after ICP
+    ScalarType rms;               ///< final ICP error
+    int iterNum;                  ///< ICP iterations
+    Matrix44x tr;                 ///< brings the mov local coords in the fix local coords
+    std::vector<CoordType> mates; ///< samples of mov (local coords), matched with tr*mates in fix
+  };
+
+  class Stat
+  {
+  public:
+    int candidateNum;
+    int validNum;
+    int componentNum;
+    double pairTime;              ///< milliseconds
+    double globalTime;
+    std::vector<ScalarType> globalRms; ///< rms distance of the mates before each global iteration
+
+    Stat() { clear(); }
+    void clear() { candidateNum=validNum=componentNum=0; pairTime=globalTime=0; globalRms.clear(); }
+    void Dump(FILE *fp) const
+    {
+      fprintf(fp,"Pairs %i candidate %i aligned in %6.1f ms\n",candidateNum,validNum,pairTime);
+      fprintf(fp,"Global alignment of %i components, %i iterations in %6.1f ms\n",componentNum,int(globalRms.size()),globalTime);
+      for(size_t i=0;i<globalRms.size();++i)
+        fprintf(fp,"%3i rms %g\n",int(i),globalRms[i]);
+    }
+  };
+
+  Param par;
+  Stat stat;
+  std::vector<View> viewVec;
+  std::vector<AlignPair> pairVec;
+
+  /// Add a view with its starting pose (local to global coords); returns its index.
+  int AddView(MeshType &m, const Matrix44x &tr)
+  {
+    std::vector<CoordType> posVec,norVec;
+    posVec.reserve(m.vn);
+    for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+      if(!vi->IsD())
+      {
+        posVec.push_back(vi->cP());
+        if(HasPerVertexNormal(m)) norVec.push_back(vi->cN());
+      }
+    return AddView(posVec,norVec,tr);
+  }
+
+  /// Add a view given as a point set (the normals can be empty).
+  int AddView(const std::vector<CoordType> &posVec, const std::vector<CoordType> &norVec, const Matrix44x &tr)
+  {
+    assert(norVec.empty() || norVec.size()==posVec.size());
+    const int id=int(viewVec.size());
+    viewVec.push_back(View());
+    View &v=viewVec.back();
+    std::vector<int> ind;
+    ICPType::SampleIndices(int(posVec.size()),par.viewSampleNum,par.randSeed+id,ind);
+    v.pos.resize(ind.size());
+    if(!norVec.empty()) v.nor.resize(ind.size());
+    v.bbox.SetNull();
+    for(size_t i=0;i<ind.size();++i)
+    {
+      v.pos[i]=posVec[ind[i]];
+      if(!norVec.empty()) v.nor[i]=norVec[ind[i]];
+      v.bbox.Add(v.pos[i]);
+    }
+    v.tr=tr;
+    return id;
+  }
+
+  int ViewNum() const { return int(viewVec.size()); }
+  const Matrix44x &Tr(int i) const { return viewVec[i].tr; }
+
+  /// Copy of par with the automatic (zero) values derived from the current views; par itself is left untouched.
+  Param EffectiveParam() const
+  {
+    Param pa=par;
+    if(pa.consensusDist==0)
+    {
+      double diagSum=0;
+      for(size_t i=0;i<viewVec.size();++i) diagSum+=viewVec[i].bbox.Diag();
+      if(!viewVec.empty()) pa.consensusDist=ScalarType(0.02*diagSum/viewVec.size());
+    }
+    if(pa.icp.maxDistance==0) pa.icp.maxDistance=pa.consensusDist;
+    if(pa.minGlobalStep==0) pa.minGlobalStep=pa.consensusDist/1000;
+    if(pa.icp.minTrStep==0) pa.icp.minTrStep=pa.minGlobalStep;
+    return pa;
+  }
+
+  void Process()
+  {
+    stat.clear();
+    const Param pa=EffectiveParam();
+    double t0=Now();
+    ComputeCandidatePairs(pa);
+    AlignPairs(pa);
+    stat.pairTime=Now()-t0;
+    t0=Now();
+    GlobalAlign(pa);
+    stat.globalTime=Now()-t0;
+  }
+
+  /// Candidate pairs: the views whose global bounding boxes, enlarged by consensusDist, intersect.
+  void ComputeCandidatePairs(const Param &pa)
+  {
+    const int vn=int(viewVec.size());
+    std::vector<Box3x> gBox(vn);
+    for(int i=0;i<vn;++i)
+    {
+      gBox[i].SetNull();
+      if(!viewVec[i].bbox.IsNull()) gBox[i].Add(viewVec[i].tr,viewVec[i].bbox);
+      gBox[i].Offset(pa.consensusDist);
+    }
+    pairVec.clear();
+    for(int i=0;i<vn;++i)
+      for(int j=i+1;j<vn;++j)
+        if(!viewVec[i].pos.empty() && !viewVec[j].pos.empty() && gBox[i].Collide(gBox[j]))
+        {
+          AlignPair ap;
+          ap.fix=i; ap.mov=j;
+          ap.valid=false;
+          ap.initOverlap=ap.overlap=ap.rms=0;
+          ap.iterNum=0;
+          pairVec.push_back(ap);
+        }
+    stat.candidateNum=int(pairVec.size());
+  }
+
+  /// Pairwise ICP of the candidate pairs, in parallel over the fix views.
+  void AlignPairs(const Param &pa)
+  {
+    // pairVec is sorted by fix view
+    std::vector<int> firstPair(viewVec.size()+1,0);
+    for(size_t i=0;i<pairVec.size();++i) firstPair[pairVec[i].fix+1]++;
+    for(size_t i=0;i<viewVec.size();++i) firstPair[i+1]+=firstPair[i];
+
+    const int vn=int(viewVec.size());
+#pragma omp parallel for schedule(dynamic,1)
+    for(int i=0;i<vn;++i)
+    {
+      if(firstPair[i]==firstPair[i+1]) continue;
+      ICPType icp;
+      icp.par=pa.icp;
+      icp.Init(viewVec[i].pos,viewVec[i].nor);
+      if(!icp.HasFixNormal()) icp.par.pointToPlane=false;
+      for(int p=firstPair[i];p<firstPair[i+1];++p)
+        AlignPairWithIndex(pa,icp,pairVec[p]);
+    }
+    stat.validNum=0;
+    for(size_t i=0;i<pairVec.size();++i)
+      if(pairVec[i].valid) ++stat.validNum;
+  }
+
+  /// Find the poses that best agree with all the valid pairs.
+  void GlobalAlign(const Param &pa)
+  {
+    const int vn=int(viewVec.size());
+    // the views of each connected component are referred to the first one
+    std::vector<int> comp(vn);
+    for(int i=0;i<vn;++i) comp[i]=i;
+    for(size_t p=0;p<pairVec.size();++p)
+      if(pairVec[p].valid)
+      {
+        int a=Root(comp,pairVec[p].fix), b=Root(comp,pairVec[p].mov);
+        if(a!=b) comp[std::max(a,b)]=std::min(a,b);
+      }
+    std::vector<int> unk(vn,-1);
+    int unkNum=0;
+    stat.componentNum=0;
+    for(int i=0;i<vn;++i)
+    {
+      if(Root(comp,i)==i) ++stat.componentNum;
+      else unk[i]=unkNum++;
+    }
+    if(unkNum==0) return;
+
+    std::vector<int> validVec;
+    for(size_t p=0;p<pairVec.size();++p)
+      if(pairVec[p].valid) validVec.push_back(int(p));
+    const int pn=int(validVec.size());
+    std::vector<Eigen::Matrix<double,12,12>,Eigen::aligned_allocator<Eigen::Matrix<double,12,12> > > blockA(pn);
+    std::vector<Eigen::Matrix<double,12,1>,Eigen::aligned_allocator<Eigen::Matrix<double,12,1> > > blockB(pn);
+    std::vector<double> errVec(pn);
+    std::vector<int> mateNumVec(pn);
+
+    for(int it=0;it<pa.maxGlobalIterNum;++it)
+    {
+      // rotations are linearized around the barycenter of the mates
+      Point3x c(0,0,0);
+      int mateNum=0;
+      for(int k=0;k<pn;++k)
+      {
+        const AlignPair &ap=pairVec[validVec[k]];
+        for(size_t m=0;m<ap.mates.size();++m)
+          c+=Point3x::Construct(viewVec[ap.mov].tr*ap.mates[m]);
+        mateNum+=int(ap.mates.size());
+      }
+      if(mateNum==0) return;
+      c/=mateNum;
+
+#pragma omp parallel for schedule(dynamic,16)
+      for(int k=0;k<pn;++k)
+        BuildPairBlock(pairVec[validVec[k]],c,blockA[k],blockB[k],errVec[k]);
+      double errSum=0;
+      for(int k=0;k<pn;++k) errSum+=errVec[k];
+      stat.globalRms.push_back(ScalarType(std::sqrt(errSum/mateNum)));
+
+      // block (a,b) of the pair k: rows/columns 0-5 are the mov view, 6-11 the fix one
+      std::vector<Eigen::Triplet<double> > IJV;
+      IJV.reserve(size_t(pn)*144+size_t(unkNum)*6);
+      Eigen::VectorXd b=Eigen::VectorXd::Zero(6*unkNum);
+      for(int k=0;k<pn;++k)
+      {
+        const int v[2]={unk[pairVec[validVec[k]].mov],unk[pairVec[validVec[k]].fix]};
+        for(int s=0;s<2;++s)
+        {
+          if(v[s]<0) continue;
+          b.segment<6>(6*v[s])+=blockB[k].template segment<6>(6*s);
+          for(int t=0;t<2;++t)
+            if(v[t]>=0)
+              for(int r=0;r<6;++r)
+                for(int q=0;q<6;++q)
+                  IJV.push_back(Eigen::Triplet<double>(6*v[s]+r,6*v[t]+q,blockA[k](6*s+r,6*t+q)));
+        }
+      }
+      // tiny damping: keeps the system definite for views constrained only by degenerate (e.g. planar) mates
+      for(int i=0;i<6*unkNum;++i)
+        IJV.push_back(Eigen::Triplet<double>(i,i,1e-9*(1+errSum/mateNum)));
+      SpMat A(6*unkNum,6*unkNum);
+      A.setFromTriplets(IJV.begin(),IJV.end());
+      Eigen::SimplicialLDLT<SpMat> solver(A);
+      if(solver.info()!=Eigen::Success) return;
+      const Eigen::VectorXd x=solver.solve(b);
+
+      ScalarType maxStep=0;
+      for(int i=0;i<vn;++i)
+        if(unk[i]>=0)
+        {
+          const Matrix44x inc=IncrementMatrix(x.segment<6>(6*unk[i]),c);
+          for(int j=0;j<8;++j)
+          {
+            const CoordType p=viewVec[i].tr*viewVec[i].bbox.P(j);
+            maxStep=std::max(maxStep,Distance(inc*p,p));
+          }
+          viewVec[i].tr=inc*viewVec[i].tr;
+        }
+      if(maxStep<=pa.minGlobalStep) break;
+    }
+  }
+
+protected:
+  void AlignPairWithIndex(const Param &pa, ICPType &icp, AlignPair &ap) const
+  {
+    const View &fv=viewVec[ap.fix];
+    const View &mv=viewVec[ap.mov];
+    Matrix44x rel=Inverse(fv.tr)*mv.tr;
+    std::vector<int> ovInd;
+    ICPType::SampleIndices(int(mv.pos.size()),pa.overlapSampleNum,pa.randSeed+ap.mov,ovInd);
+    ap.initOverlap=Overlap(pa,icp,mv,ovInd,rel,0);
+    if(ovInd.empty() || ap.initOverlap<pa.minOverlap) return;
+
+    std::vector<CoordType> sampleVec;
+    icp.SamplePoints(mv.pos,sampleVec);
+    typename ICPType::Stat st;
+    // coarse to fine: a second pass with half the distance threshold drops the pairs across the overlap border
+    icp.par.maxDistance=pa.icp.maxDistance;
+    if(!icp.Align(sampleVec,rel,st)) return;
+    ap.iterNum=st.iterNum();
+    icp.par.maxDistance=pa.icp.maxDistance/2;
+    if(!icp.Align(sampleVec,rel,st)) return;
+    ap.iterNum+=st.iterNum();
+    ap.tr=rel;
+    ap.rms=st.lastRms();
+    std::vector<int> consInd;
+    ap.overlap=Overlap(pa,icp,mv,ovInd,rel,&consInd);
+    if(ap.overlap<pa.minOverlap || consInd.empty()) return;
+    // mates evenly taken from the samples in consensus
+    const int mn=std::min(pa.matesNum,int(consInd.size()));
+    ap.mates.resize(mn);
+    for(int i=0;i<mn;++i)
+      ap.mates[i]=mv.pos[consInd[(size_t(i)*consInd.size())/mn]];
+    ap.valid=true;
+  }
+
+  /// Fraction of the samples of mv (transformed by tr in the fix frame) in consensus with the fix view.
+  ScalarType Overlap(const Param &pa, const ICPType &icp, const View &mv, const std::vector<int> &ind, const Matrix44x &tr, std::vector<int> *consInd) const
+  {
+    if(ind.empty()) return 0;
+    const bool checkNormal=icp.HasFixNormal() && !mv.nor.empty();
+    Matrix44x rot=tr;
+    rot.SetColumn(3,Point4<ScalarType>(0,0,0,1));
+    int cnt=0;
+    for(size_t i=0;i<ind.size();++i)
+    {
+      int ci;
+      const ScalarType d=icp.Closest(tr*mv.pos[ind[i]],ci);
+      if(d>pa.consensusDist) continue;
+      if(checkNormal && (rot*mv.nor[ind[i]]).dot(icp.FixN(ci))<pa.consensusNormalDot) continue;
+      ++cnt;
+      if(consInd) consInd->push_back(ind[i]);
+    }
+    return ScalarType(cnt)/ScalarType(ind.size());
+  }
+
+  /// Normal equations of the mates of a pair. For a mate a of mov and b=ap.tr*a of fix, in global coords
+  /// x=Tmov*a and y=Tfix*b, the linearized residual (x + w_mov^(x-c) + t_mov) - (y + w_fix^(y-c) + t_fix)
+  /// is accumulated for the unknowns (w_mov,t_mov,w_fix,t_fix).
+  void BuildPairBlock(const AlignPair &ap, const Point3x &c, Eigen::Matrix<double,12,12> &A, Eigen::Matrix<double,12,1> &B, double &err) const
+  {
+    A.setZero(); B.setZero(); err=0;
+    const Matrix44x &tm=viewVec[ap.mov].tr;
+    const Matrix44x tf=viewVec[ap.fix].tr*ap.tr;
+    Eigen::Matrix<double,3,12> J;
+    for(size_t m=0;m<ap.mates.size();++m)
+    {
+      const Point3x x=Point3x::Construct(tm*ap.mates[m])-c;
+      const Point3x y=Point3x::Construct(tf*ap.mates[m])-c;
+      const Point3x r=x-y;
+      // w^p = -[p]_x w
+      J << 0, x[2],-x[1], 1,0,0,   0,-y[2], y[1], -1, 0, 0,
+          -x[2], 0, x[0], 0,1,0,   y[2], 0,-y[0],  0,-1, 0,
+           x[1],-x[0], 0, 0,0,1,  -y[1], y[0], 0,  0, 0,-1;
+      Eigen::Vector3d re(r[0],r[1],r[2]);
+      A+=J.transpose()*J;
+      B-=J.transpose()*re;
+      err+=r.SquaredNorm();
+    }
+  }
+
+  static Matrix44x IncrementMatrix(const Eigen::Matrix<double,6,1> &x, const Point3x &c)
+  {
+    Point3x w(x[0],x[1],x[2]);
+    const double angle=w.Norm();
+    Matrix44x rot,tc,tmc;
+    rot.SetIdentity();
+    if(angle>0) rot.SetRotateRad(ScalarType(angle),Point3<ScalarType>::Construct(w/angle));
+    tc.SetTranslate(Point3<ScalarType>::Construct(c+Point3x(x[3],x[4],x[5])));
+    tmc.SetTranslate(Point3<ScalarType>::Construct(-c));
+    return tc*rot*tmc;
+  }
+
+  static int Root(std::vector<int> &comp, int i)
+  {
+    while(comp[i]!=i) i=comp[i]=comp[comp[i]];
+    return i;
+  }
+
+  static double Now()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count()/1000.0;
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCGLIB_ALIGN_GLOBAL
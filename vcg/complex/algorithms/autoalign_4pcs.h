@@ -37,6 +37,7 @@ used in the paper pseudocode.
 #include <vcg/complex/algorithms/point_sampling.h>
 #include <vcg/math/random_generator.h>
 #include <ctime>
+#include <chrono>
 namespace vcg{
 namespace tri{
 
@@ -94,15 +95,22 @@ public:
     }
   };
 
+  /* per stage timings (wall clock, in clock() units) and counters */
   struct Stat
   {
-    Stat() : initTime(0),selectCoplanarBaseTime(0),findCongruentTime(0),testAlignmentTime(0)
+    Stat() : initTime(0),computeR1Time(0),selectCoplanarBaseTime(0),findCongruentTime(0),testAlignmentTime(0),
+      congruentNum(0),candidateNum(0),earlyRejectNum(0)
     {}
     clock_t initTime;
+    clock_t computeR1Time;
     clock_t selectCoplanarBaseTime;
     clock_t findCongruentTime;
     clock_t testAlignmentTime;
+    int congruentNum;      // congruent sets found on Q
+    int candidateNum;      // congruent sets whose score on ExtB exceeds scoreFeet (the candidates tested on subsetP)
+    int earlyRejectNum;    // evaluations interrupted because the partial score could no longer reach the threshold
     float init()   {return 1000.0f*float(initTime)/float(CLOCKS_PER_SEC);}
+    float computeR1() {return 1000.0f*float(computeR1Time)/float(CLOCKS_PER_SEC);}
     float select() {return 1000.0f*float(selectCoplanarBaseTime)/float(CLOCKS_PER_SEC);}
     float findCongruent() {return 1000.0f*float(findCongruentTime)/float(CLOCKS_PER_SEC);}
     float testAlignment() {return 1000.0f*float(testAlignmentTime)/float(CLOCKS_PER_SEC);}
@@ -160,6 +168,13 @@ public:
   vcg::GridStaticPtr<typename MeshType::VertexType, ScalarType > ugridQ;
   vcg::GridStaticPtr<typename MeshType::VertexType, ScalarType > ugridP;
 
+  /* wall clock time in clock() units: the stages run in parallel, so clock() would sum the time of all the threads */
+  static clock_t Clock()
+  {
+    return clock_t(double(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count())*CLOCKS_PER_SEC/1000000.0);
+  }
+
   /* returns the closest point between to segments x1-x2 and x3-x4.  */
     void IntersectionLineLine(const CoordType & x1,const CoordType & x2,const CoordType & x3,const CoordType & x4, CoordType&x)
     {
@@ -170,7 +185,7 @@ public:
 
 void Init(MeshType &_movP,MeshType &_fixQ)
 {
-  clock_t t0= clock();
+  clock_t t0= Clock();
   P = &_movP;
   Q = &_fixQ;
   tri::UpdateBounding<MeshType>::Box(*P);
@@ -186,7 +201,7 @@ void Init(MeshType &_movP,MeshType &_fixQ)
   tri::PoissonPruning(*Q, subsetQ, par.samplingRadius, par.seed);
   par.deltaAbs = par.samplingRadius * par.deltaPerc;
   side = P->bbox.Dim()[P->bbox.MaxDim()]*par.overlap; //rough implementation
-  stat.initTime+=clock()-t0;
+  stat.initTime+=Clock()-t0;
 }
 
 
@@ -194,7 +209,7 @@ void Init(MeshType &_movP,MeshType &_fixQ)
 //
 bool SelectCoplanarBase(FourPoints &B, ScalarType &r1, ScalarType &r2)
 {
-  clock_t t0= clock();
+  clock_t t0= Clock();
 
   // choose the inter point distance
   ScalarType dtol = side*0.1; //rough implementation
@@ -286,7 +301,7 @@ bool SelectCoplanarBase(FourPoints &B, ScalarType &r1, ScalarType &r2)
   }
 
   //qDebug("ExtB %i",ExtB[0].size()+ExtB[1].size()+ExtB[2].size()+ExtB[3].size());
-  stat.selectCoplanarBaseTime+=clock()-t0;
+  stat.selectCoplanarBaseTime+=Clock()-t0;
   return true;
 }
 
@@ -315,28 +330,35 @@ bool IsTransfCongruent(const FourPoints &B, const FourPoints &fp, vcg::Matrix44<
 }
 
 /// Compute the vector R1 of couple of points on FixQ at a given distance.
-/// Used by FindCongruent
+/// Used by FindCongruent. The rows of couples are built in parallel and joined in order.
 void ComputeR1(std::vector<Couple > &R1)
 {
-  R1.clear();
-  for(size_t vi = 0; vi  < subsetQ.size(); ++vi)
-    for(size_t vj = vi; vj < subsetQ.size(); ++vj){
+  clock_t t0=Clock();
+  const int n=int(subsetQ.size());
+  std::vector<std::vector<Couple> > rowR1(n);
+#pragma omp parallel for schedule(dynamic,16)
+  for(int vi = 0; vi  < n; ++vi)
+    for(int vj = vi; vj < n; ++vj){
       ScalarType d = Distance(subsetQ[vi]->P(),subsetQ[vj]->P());
       if( (d < side+par.deltaAbs))
       {
-        R1.push_back(Couple(subsetQ[vi],subsetQ[vj], d));
-        R1.push_back(Couple(subsetQ[vj],subsetQ[vi], d));
+        rowR1[vi].push_back(Couple(subsetQ[vi],subsetQ[vj], d));
+        rowR1[vi].push_back(Couple(subsetQ[vj],subsetQ[vi], d));
       }
     }
 
+  R1.clear();
+  for(int vi = 0; vi < n; ++vi)
+    R1.insert(R1.end(),rowR1[vi].begin(),rowR1[vi].end());
   std::sort(R1.begin(),R1.end());
+  stat.computeR1Time+=Clock()-t0;
 }
 
 // Find congruent elements of a base B, on Q, with approximation delta
 // and put them in the U vector.
 bool FindCongruent(const std::vector<Couple > &R1, const FourPoints &B, const ScalarType r1, const ScalarType r2)
 {
-  clock_t t0=clock();
+  clock_t t0=Clock();
   int n_base=0;
   bool done = false;
   int n_closests = 0, n_congr = 0;
@@ -389,8 +411,15 @@ bool FindCongruent(const std::vector<Couple > &R1, const FourPoints &B, const Sc
   GridType ugrid; // griglia
   ugrid.Set(Invr.vert.begin(),Invr.vert.end());
   n_closests = 0; n_congr = 0; ac =0 ; acf = 0; tr = 0; trf = 0;
-  printf("R2Inv.size  = %d \n",R2inv.size());
-  for(unsigned int i = 0 ; i < R2inv.size() ; ++i)
+  printf("R2Inv.size  = %d \n",int(R2inv.size()));
+
+  // the points of R2inv are processed in parallel (Invr, its grid and ugridQ are only read);
+  // the candidates of each point are kept apart and appended to U in order
+  const int r2Num=int(R2inv.size());
+  std::vector<std::vector<Candidate> > found(r2Num);
+  int n_reject=0;
+#pragma omp parallel for schedule(dynamic,64) reduction(+:n_closests,n_base,trf,tr,n_congr,n_reject)
+  for(int i = 0 ; i < r2Num ; ++i)
   {
     std::vector<typename PMesh::VertexType*> closests;
 
@@ -423,18 +452,22 @@ bool FindCongruent(const std::vector<Couple > &R1, const FourPoints &B, const Sc
         tr++;
         n_congr++;
         Candidate c(p,mat);
-        EvaluateAlignment(c);
+        if(!EvaluateAlignment(c)) n_reject++;
 
         if( c.score > par.scoreFeet)
-          U.push_back(c);
+          found[i].push_back(c);
       }
     }
   }
+  for(int i = 0 ; i < r2Num ; ++i)
+    U.insert(U.end(),found[i].begin(),found[i].end());
+  stat.congruentNum+=n_congr;
+  stat.earlyRejectNum+=n_reject;
 
   vcg::tri::Allocator<PMesh>::DeletePerVertexAttribute(Invr,id);
   printf("n_closests %5d = (An %5d ) + ( Tr %5d ) + (OK) %5d\n",n_closests,acf,trf,n_congr);
 
-  stat.findCongruentTime += clock()-t0;
+  stat.findCongruentTime += Clock()-t0;
   return done;
 }
 
@@ -456,28 +489,71 @@ int EvaluateSample(Candidate & fp, const CoordType & tp, const CoordType & np)
   else return 0;
 }
 
-// Check a candidate against the small subset of points ExtB
-void EvaluateAlignment(Candidate  & fp){
+// Check a candidate against the small subset of points ExtB.
+// Each sample adds at most one to the score, so the evaluation stops as soon as the partial score
+// can no longer exceed par.scoreFeet; in that case the score is that upper bound and false is returned.
+bool EvaluateAlignment(Candidate  & fp){
         int n_delta_close = 0;
+        int remaining = int(ExtB[0].size()+ExtB[1].size()+ExtB[2].size()+ExtB[3].size());
         for(int i  = 0 ; i< 4; ++i) {
             for(unsigned int j = 0; j < ExtB[i].size();++j){
+                if(n_delta_close+remaining <= par.scoreFeet) {
+                  fp.score = n_delta_close+remaining;
+                  return false;
+                }
                 n_delta_close+=EvaluateSample(fp, ExtB[i][j]->P(), ExtB[i][j]->cN());
+                --remaining;
             }
         }
         fp.score = n_delta_close;
+        return true;
 }
 
-void TestAlignment(Candidate  & fp)
+// Check a candidate against subsetP. If the partial score can no longer exceed minScore
+// the evaluation stops, the score is that upper bound and false is returned.
+bool TestAlignment(Candidate  & fp, int minScore = std::numeric_limits<int>::min())
 {
-  clock_t t0 = clock();
+  const int n = int(subsetP.size());
   int n_delta_close = 0;
-  for(unsigned int j = 0; j < subsetP.size();++j){
+  for(int j = 0; j < n;++j){
+    if(n_delta_close+(n-j) <= minScore) {
+      fp.score = n_delta_close+(n-j);
+      return false;
+    }
     CoordType np = subsetP[j]->N();
     CoordType tp = subsetP[j]->P();
     n_delta_close+=EvaluateSample(fp,tp,np);
   }
   fp.score =  n_delta_close;
-  stat.testAlignmentTime += clock()-t0;
+  return true;
+}
+
+// Test all the candidates in U on subsetP and return the index of the first one with the highest score
+// strictly greater than minScore (-1 if none).
+// The candidates are tested in parallel batches; each batch uses the best score of the previous ones
+// to interrupt the candidates that cannot beat it, so the winner is the same of a serial scan.
+int TestCandidates(int minScore)
+{
+  clock_t t0 = Clock();
+  const int batchSize = 64;
+  const int candNum = int(U.size());
+  int best = -1;
+  int n_reject = 0;
+  for(int b = 0; b < candNum; b += batchSize)
+  {
+    const int e = std::min(candNum, b+batchSize);
+    const int bound = (best==-1) ? minScore : U[best].score;
+#pragma omp parallel for schedule(dynamic,1) reduction(+:n_reject)
+    for(int i = b; i < e; ++i)
+      if(!TestAlignment(U[i],bound)) n_reject++;
+    for(int i = b; i < e; ++i)
+      if(U[i].score > ((best==-1) ? minScore : U[best].score))
+        best = i;
+  }
+  stat.candidateNum += candNum;
+  stat.earlyRejectNum += n_reject;
+  stat.testAlignmentTime += Clock()-t0;
+  return best;
 }
 
 
@@ -498,13 +574,10 @@ bool Align(Matrix44x & result, vcg::CallBackPos * cb )
     {
       U.clear();
       FindCongruent(R1,B,r1,r2);
-      qDebug("Attempt %i found %i candidate best score %i",i,U.size(),bestC.score);
-      for(size_t i = 0 ; i <  U.size() ;++i)
-      {
-        TestAlignment(U[i]);
-        if(U[i].score > bestC.score)
-          bestC = U[i];
-      }
+      printf("Attempt %i found %i candidate best score %i\n",i,int(U.size()),bestC.score);
+      const int best = TestCandidates(bestC.score);
+      if(best != -1)
+        bestC = U[best];
     }
   }
   result = bestC.T;
@@ -513,7 +586,6 @@ bool Align(Matrix44x & result, vcg::CallBackPos * cb )
 
 bool Align(int L, Matrix44x & result, vcg::CallBackPos * cb )
 {
-    int bestv = 0;
     bool found;
     int n_tries = 0;
     U.clear();
@@ -561,17 +633,7 @@ bool Align(int L, Matrix44x & result, vcg::CallBackPos * cb )
 
 //    std::sort(U.begin(),U.end());
     if(cb) cb(90,"TestAlignment");
-    bestv  = -std::numeric_limits<float>::max();
-    iwinner = 0;
-
-    for(int i = 0 ; i <  U.size() ;++i)
-     {
-        TestAlignment(U[i]);
-        if(U[i].score > bestv){
-            bestv = U[i].score;
-            iwinner = i;
-            }
-    }
+    iwinner = TestCandidates(std::numeric_limits<int>::min());
 
     result = U[iwinner].T;
     Invr.Clear();
@@ -1483,43 +1483,104 @@ public:
     return total;
   }
 
+  /** Find the self intersecting faces of the mesh; each of them is added once to ret (in face order).
+      Broad phase: the bounding boxes of the faces are binned in a uniform grid by sorting the (cell, face) pairs.
+      The cells are processed in parallel in blocks: each block collects in its own buffer the pairs of faces whose
+      boxes overlap (a pair is taken only in the cell containing the corner of the overlap, so it is found once)
+      and then tests them with TestFaceFaceIntersection.
+      */
   static bool SelfIntersections(MeshType &m, std::vector<FaceType*> &ret)
   {
-    RequirePerFaceMark(m);
     ret.clear();
-    int referredBit = FaceType::NewBitFlag();
-    tri::UpdateFlags<MeshType>::FaceClear(m,referredBit);
-
-    TriMeshGrid gM;
-    gM.Set(m.face.begin(),m.face.end());
-
-    for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
+    std::vector<int> ind;
+    for(size_t i=0;i<m.face.size();++i)
+      if(!m.face[i].IsD()) ind.push_back(int(i));
+    const int n=int(ind.size());
+    if(n<2) return false;
+    std::vector<Box3Type> bb(m.face.size());
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<n;++i)
+      m.face[ind[i]].GetBBox(bb[ind[i]]);
+    Box3Type all;
+    for(int i=0;i<n;++i) all.Add(bb[ind[i]]);
+    Point3i siz;
+    BestDim((long long)n,all.Dim(),siz);
+    CoordType cell;
+    for(int k=0;k<3;++k)
+      cell[k] = (all.Dim()[k]>0) ? all.Dim()[k]/siz[k] : ScalarType(1);
+
+    // (cell, face) pairs sorted by cell
+    std::vector<int> first(n+1,0);
+    for(int i=0;i<n;++i)
     {
-      (*fi).SetUserBit(referredBit);
-      Box3< ScalarType> bbox;
-      (*fi).GetBBox(bbox);
-      std::vector<FaceType*> inBox;
-      vcg::tri::GetInBoxFace(m, gM, bbox,inBox);
-      bool Intersected=false;
-      typename std::vector<FaceType*>::iterator fib;
-      for(fib=inBox.begin();fib!=inBox.end();++fib)
-      {
-        if(!(*fib)->IsUserBit(referredBit) && (*fib != &*fi) )
-          if(Clean<MeshType>::TestFaceFaceIntersection(&*fi,*fib)){
-            ret.push_back(*fib);
-            if(!Intersected) {
-              ret.push_back(&*fi);
-              Intersected=true;
-            }
+      const Point3i lo=GridCoord(all,cell,siz,bb[ind[i]].min), hi=GridCoord(all,cell,siz,bb[ind[i]].max);
+      first[i+1]=first[i]+(hi[0]-lo[0]+1)*(hi[1]-lo[1]+1)*(hi[2]-lo[2]+1);
+    }
+    std::vector<std::pair<int,int> > entry(first[n]);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<n;++i)
+    {
+      const Point3i lo=GridCoord(all,cell,siz,bb[ind[i]].min), hi=GridCoord(all,cell,siz,bb[ind[i]].max);
+      int e=first[i];
+      for(int z=lo[2];z<=hi[2];++z)
+        for(int y=lo[1];y<=hi[1];++y)
+          for(int x=lo[0];x<=hi[0];++x)
+            entry[e++]=std::make_pair(x+siz[0]*(y+siz[1]*z),ind[i]);
+    }
+    std::sort(entry.begin(),entry.end());
+    std::vector<int> cellStart;
+    for(int e=0;e<int(entry.size());++e)
+      if(e==0 || entry[e].first!=entry[e-1].first) cellStart.push_back(e);
+    cellStart.push_back(int(entry.size()));
+
+    const int cellNum=int(cellStart.size())-1;
+    const int blockSize=256;
+    const int blockNum=(cellNum+blockSize-1)/blockSize;
+    std::vector<std::vector<int> > hit(blockNum);
+#pragma omp parallel for schedule(dynamic,1)
+    for(int b=0;b<blockNum;++b)
+    {
+      std::vector<std::pair<int,int> > cand;
+      const int cellEnd=std::min(cellNum,(b+1)*blockSize);
+      for(int c=b*blockSize;c<cellEnd;++c)
+        for(int e0=cellStart[c];e0<cellStart[c+1];++e0)
+          for(int e1=e0+1;e1<cellStart[c+1];++e1)
+          {
+            const Box3Type &b0=bb[entry[e0].second], &b1=bb[entry[e1].second];
+            if(b0.min[0]>b1.max[0] || b0.max[0]<b1.min[0] ||
+               b0.min[1]>b1.max[1] || b0.max[1]<b1.min[1] ||
+               b0.min[2]>b1.max[2] || b0.max[2]<b1.min[2]) continue;
+            CoordType corner;
+            for(int k=0;k<3;++k) corner[k]=std::max(b0.min[k],b1.min[k]);
+            const Point3i g=GridCoord(all,cell,siz,corner);
+            if(g[0]+siz[0]*(g[1]+siz[1]*g[2]) != entry[e0].first) continue;
+            cand.push_back(std::make_pair(entry[e0].second,entry[e1].second));
           }
-      }
-      inBox.clear();
+      for(size_t k=0;k<cand.size();++k)
+        if(TestFaceFaceIntersection(&m.face[cand[k].first],&m.face[cand[k].second]))
+        {
+          hit[b].push_back(cand[k].first);
+          hit[b].push_back(cand[k].second);
+        }
     }
 
-    FaceType::DeleteBitFlag(referredBit);
+    std::vector<char> intersected(m.face.size(),0);
+    for(int b=0;b<blockNum;++b)
+      for(size_t k=0;k<hit[b].size();++k)
+        intersected[hit[b][k]]=1;
+    for(size_t i=0;i<m.face.size();++i)
+      if(intersected[i]) ret.push_back(&m.face[i]);
     return (ret.size()>0);
   }
 
+  static Point3i GridCoord(const Box3Type &bb, const CoordType &cell, const Point3i &siz, const CoordType &p)
+  {
+    Point3i g;
+    for(int k=0;k<3;++k)
+      g[k]=std::max(0,std::min(siz[k]-1,int((p[k]-bb.min[k])/cell[k])));
+    return g;
+  }
+
   /**
       This function simply test that the vn and fn counters be consistent with the size of the containers and the number of deleted simplexes.
       */
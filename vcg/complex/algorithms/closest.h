@@ -25,6 +25,7 @@
 #ifndef __VCG_TRIMESH_CLOSEST
 #define __VCG_TRIMESH_CLOSEST
 #include <math.h>
+#include <unordered_set>
 
 #include <vcg/space/point3.h>
 #include <vcg/space/box3.h>
@@ -77,6 +78,30 @@ namespace vcg {
         };
         
 
+        /// Marker that keeps its own set of marked elements instead of using the IMark of the mesh.
+        /// Queries using different instances can run concurrently on the same mesh and grid
+        /// (e.g. one instance for each thread).
+        template <class MESH_TYPE,class OBJ_TYPE>
+        class LocalTmark
+        {
+            std::unordered_set<const OBJ_TYPE *> marked;
+        public:
+            LocalTmark(){}
+            LocalTmark(MESH_TYPE *){}
+            void UnMarkAll(){ marked.clear();}
+            bool IsMarked(OBJ_TYPE* obj){return marked.count(obj)!=0;}
+            void Mark(OBJ_TYPE* obj){ marked.insert(obj);}
+            void SetMesh(MESH_TYPE *){}
+        };
+
+        template <class MESH_TYPE>
+        class FaceLocalTmark:public LocalTmark<MESH_TYPE,typename MESH_TYPE::FaceType>
+        {
+        public:
+            FaceLocalTmark(){}
+            FaceLocalTmark(MESH_TYPE *m) {this->SetMesh(m);}
+        };
+
         template <class MESH_TYPE>
         class EmptyTMark
         {
@@ -240,6 +240,14 @@ class Clustering
 
   BasicGrid<ScalarType> Grid;
 
+  /// Cell of a point; points outside the grid box go to the nearest border cell.
+  void PToCell(const CoordType &p, Point3i &pi) const
+  {
+    Grid.PToIP(p, pi);
+    for(int i=0;i<3;++i)
+      pi[i]=math::Clamp(pi[i],0,Grid.siz[i]-1);
+  }
+
   std::unordered_set<SimpleTri,SimpleTri> TriSet;
   typedef typename std::unordered_set<SimpleTri,SimpleTri>::iterator TriHashSetIterator;
   std::unordered_map<Point3i,CellType> GridCell;
@@ -252,7 +260,7 @@ class Clustering
                 if(!UseOnlySelected || (*vi).IsS())
                     {
                         Point3i pi;
-                        Grid.PToIP((*vi).cP(), pi );
+                        PToCell((*vi).cP(), pi );
                         GridCell[pi].AddVertex(m,Grid,pi,*(vi));
                     }
     }
@@ -261,23 +269,147 @@ class Clustering
   {
     FaceIterator fi;
     for(fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
-            {
-                Point3i pi;
-                SimpleTri st;
-                for(int i=0;i<3;++i)
-                {
-                    Grid.PToIP((*fi).cV(i)->cP(), pi );
-                    st.v[i]=&(GridCell[pi]);
-                    st.v[i]->AddFaceVertex(m,*(fi),i);
-                }
-                if( (st.v[0]!=st.v[1]) && (st.v[0]!=st.v[2]) && (st.v[1]!=st.v[2]) )
-                { // if we allow the duplication of faces we sort the vertex only partially (to maintain the original face orientation)
-                    if(DuplicateFaceParam) st.sortOrient();
-                                        else st.sort();
-                    TriSet.insert(st);
-                }
-            //  printf("Inserted %8i triangles, clustered to %8i tri and %i cells\n",distance(m.face.begin(),fi),TriSet.size(),GridCell.size());
-            }
+      AddFace(m,*fi);
+  }
+
+  /// Add a single face: its vertices are accumulated in their cells and the clustered triangle is recorded.
+  /// It allows to feed the clustering with a stream of faces without having the whole mesh.
+  void AddFace(MeshType &m, FaceType &f)
+  {
+    Point3i pi;
+    SimpleTri st;
+    for(int i=0;i<3;++i)
+    {
+      PToCell(f.cV(i)->cP(), pi );
+      st.v[i]=&(GridCell[pi]);
+      st.v[i]->AddFaceVertex(m,f,i);
+    }
+    if( (st.v[0]!=st.v[1]) && (st.v[0]!=st.v[2]) && (st.v[1]!=st.v[2]) )
+    { // if we allow the duplication of faces we sort the vertex only partially (to maintain the original face orientation)
+      if(DuplicateFaceParam) st.sortOrient();
+      else st.sort();
+      TriSet.insert(st);
+    }
+  }
+
+  /// Parallel version of AddPointSet.
+  /// The cell key of each vertex is computed in parallel, the (key,vertex) pairs are radix sorted and each cell
+  /// accumulates its own vertices in parallel, in the original order, so the result is the same of AddPointSet.
+  void AddPointSetParallel(MeshType &m, bool UseOnlySelected=false)
+  {
+    const int vn=int(m.vert.size());
+    const int keyBits=CellKeyBits();
+    const CellKey invalid=(CellKey(1)<<keyBits)-1;
+    std::vector<KeyIndex> vk(vn);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      const VertexType &v=m.vert[i];
+      vk[i].first = (v.IsD() || (UseOnlySelected && !v.IsS())) ? invalid : PackCell(v.cP());
+      vk[i].second=i;
+    }
+    RadixSortByKey(vk,keyBits);
+
+    std::vector<int> runStart;
+    std::vector<CellType *> cellPtr;
+    BuildCellRuns(vk,invalid,runStart,cellPtr);
+    const int runNum=int(cellPtr.size());
+#pragma omp parallel for schedule(dynamic, 256)
+    for(int r=0;r<runNum;++r)
+    {
+      Point3i pi=UnpackCell(vk[runStart[r]].first);
+      for(int t=runStart[r];t<runStart[r+1];++t)
+        cellPtr[r]->AddVertex(m,Grid,pi,m.vert[vk[t].second]);
+    }
+  }
+
+  /// Parallel version of AddMesh, giving the same cells and triangles.
+  /// Face wedges are radix sorted by the key of their cell and the cells accumulate their wedges in parallel
+  /// in the original order. Triangles are then deduplicated by sorting the packed ids of their cells,
+  /// so that only the distinct ones are inserted in TriSet.
+  void AddMeshParallel(MeshType &m)
+  {
+    const int vn=int(m.vert.size());
+    const int fn=int(m.face.size());
+    const int keyBits=CellKeyBits();
+    const CellKey invalid=(CellKey(1)<<keyBits)-1;
+    std::vector<CellKey> vkey(vn,invalid);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+      if(!m.vert[i].IsD()) vkey[i]=PackCell(m.vert[i].cP());
+
+    std::vector<KeyIndex> wk(size_t(fn)*3);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j)
+      {
+        wk[i*3+j].first = m.face[i].IsD() ? invalid : vkey[tri::Index(m,m.face[i].cV(j))];
+        wk[i*3+j].second= i*3+j;
+      }
+    RadixSortByKey(wk,keyBits);
+
+    std::vector<int> runStart;
+    std::vector<CellType *> cellPtr;
+    BuildCellRuns(wk,invalid,runStart,cellPtr);
+    const int runNum=int(cellPtr.size());
+    std::vector<int> wedgeCell(size_t(fn)*3,-1);
+#pragma omp parallel for schedule(dynamic, 256)
+    for(int r=0;r<runNum;++r)
+      for(int t=runStart[r];t<runStart[r+1];++t)
+      {
+        const int w=wk[t].second;
+        wedgeCell[w]=r;
+        cellPtr[r]->AddFaceVertex(m,m.face[w/3],w%3);
+      }
+
+    // canonical cell triple of each non degenerate face, sorted as the faces inserted in TriSet
+    std::vector<Point3i> ft(fn);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+    {
+      Point3i &t=ft[i];
+      t=Point3i(wedgeCell[i*3],wedgeCell[i*3+1],wedgeCell[i*3+2]);
+      if(t[0]<0 || t[0]==t[1] || t[0]==t[2] || t[1]==t[2]) { t[0]=-1; continue; }
+      if(DuplicateFaceParam)
+      {
+        if(t[1]<t[0] && t[1]<t[2]) t=Point3i(t[1],t[2],t[0]);
+        else if(t[2]<t[0] && t[2]<t[1]) t=Point3i(t[2],t[0],t[1]);
+      }
+      else
+      {
+        if(t[0]>t[1]) std::swap(t[0],t[1]);
+        if(t[0]>t[2]) std::swap(t[0],t[2]);
+        if(t[1]>t[2]) std::swap(t[1],t[2]);
+      }
+    }
+    std::vector<KeyIndex> tk;
+    tk.reserve(fn);
+    for(int i=0;i<fn;++i)
+      if(ft[i][0]>=0) tk.push_back(KeyIndex(0,i));
+
+    // lexicographic sort of the triples: first on (t1,t2) then, stably, on t0.
+    int runBits=1;
+    while((CellKey(1)<<runBits) <= CellKey(runNum)) ++runBits;
+    const int tn=int(tk.size());
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<tn;++i)
+      tk[i].first=(CellKey(ft[tk[i].second][1])<<runBits) | CellKey(ft[tk[i].second][2]);
+    RadixSortByKey(tk,2*runBits);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<tn;++i)
+      tk[i].first=CellKey(ft[tk[i].second][0]);
+    RadixSortByKey(tk,runBits);
+
+    for(int i=0;i<tn;++i)
+    {
+      const Point3i &t=ft[tk[i].second];
+      if(i>0 && t==ft[tk[i-1].second]) continue;
+      SimpleTri st;
+      for(int j=0;j<3;++j) st.v[j]=cellPtr[t[j]];
+      if(DuplicateFaceParam) st.sortOrient();
+                        else st.sort();
+      TriSet.insert(st);
+    }
   }
 
   int CountPointSet() {return GridCell.size(); }
@@ -356,6 +488,88 @@ class Clustering
     }
 
   }
+
+private:
+  typedef unsigned long long CellKey;
+  typedef std::pair<CellKey,int> KeyIndex;
+
+  // Bits used for each axis in a packed cell key; the all ones key is never a valid cell.
+  int CellAxisBits() const
+  {
+    int maxSiz=std::max(Grid.siz[0],std::max(Grid.siz[1],Grid.siz[2]));
+    int bits=1;
+    while((1<<bits) <= maxSiz+1) ++bits;
+    assert(3*bits<=64);
+    return bits;
+  }
+  int CellKeyBits() const { return 3*CellAxisBits(); }
+
+  CellKey PackCell(const CoordType &p) const
+  {
+    const int bits=CellAxisBits();
+    Point3i pi;
+    PToCell(p, pi);
+    return (CellKey(pi[2])<<(2*bits)) | (CellKey(pi[1])<<bits) | CellKey(pi[0]);
+  }
+  Point3i UnpackCell(CellKey k) const
+  {
+    const int bits=CellAxisBits();
+    const CellKey mask=(CellKey(1)<<bits)-1;
+    return Point3i(int(k&mask), int((k>>bits)&mask), int(k>>(2*bits)));
+  }
+
+  // Create (or find) the cells of the runs of equal keys of a sorted vector, skipping the invalid key.
+  void BuildCellRuns(const std::vector<KeyIndex> &v, CellKey invalid, std::vector<int> &runStart, std::vector<CellType *> &cellPtr)
+  {
+    runStart.clear();
+    cellPtr.clear();
+    int n=int(v.size());
+    for(int i=0;i<n;++i)
+    {
+      if(v[i].first==invalid) { n=i; break; }
+      if(i==0 || v[i].first!=v[i-1].first)
+      {
+        runStart.push_back(i);
+        cellPtr.push_back(&GridCell[UnpackCell(v[i].first)]);
+      }
+    }
+    runStart.push_back(n);
+  }
+
+  // Stable LSD radix sort on the lowest keyBits bits of the keys, 8 bits per pass.
+  // Histograms are computed over a fixed number of chunks, so the result does not depend on the number of threads.
+  static void RadixSortByKey(std::vector<KeyIndex> &v, int keyBits)
+  {
+    const int n=int(v.size());
+    const int chunkNum=std::max(1,std::min(256,n/16384));
+    std::vector<KeyIndex> tmp(n);
+    std::vector<int> hist(chunkNum*256);
+    for(int shift=0;shift<keyBits;shift+=8)
+    {
+      std::fill(hist.begin(),hist.end(),0);
+#pragma omp parallel for schedule(static)
+      for(int c=0;c<chunkNum;++c)
+      {
+        const int b=int((long long)(n)*c/chunkNum), e=int((long long)(n)*(c+1)/chunkNum);
+        for(int i=b;i<e;++i) hist[c*256+int((v[i].first>>shift)&0xff)]++;
+      }
+      int sum=0;
+      for(int d=0;d<256;++d)
+        for(int c=0;c<chunkNum;++c)
+        {
+          int h=hist[c*256+d];
+          hist[c*256+d]=sum;
+          sum+=h;
+        }
+#pragma omp parallel for schedule(static)
+      for(int c=0;c<chunkNum;++c)
+      {
+        const int b=int((long long)(n)*c/chunkNum), e=int((long long)(n)*(c+1)/chunkNum);
+        for(int i=b;i<e;++i) tmp[hist[c*256+int((v[i].first>>shift)&0xff)]++]=v[i];
+      }
+      v.swap(tmp);
+    }
+  }
 }; //end class clustering
  } // namespace tri
 } // namespace vcg
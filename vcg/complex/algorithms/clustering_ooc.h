@@ -0,0 +1,319 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_CLUSTERING_OOC
+#define __VCGLIB_CLUSTERING_OOC
+
+#include <vcg/complex/algorithms/clustering.h>
+#include <wrap/io_trimesh/import_ply.h>
+#include <wrap/ply/plystuff.h>
+
+namespace vcg{
+namespace tri{
+
+/** \brief Out of core vertex clustering of ply files.
+
+The vertices of a ply file are read one at a time and accumulated in their cell with CellType::AddVertex(),
+so the input mesh is never loaded: for each input vertex only the index of its cell is kept, while the faces
+are streamed and turned into triples of cells. The cell table holds only the occupied cells (its size is bounded
+by the grid size chosen in Init()); the triples are collected in a buffer that is periodically sorted and
+compacted, so duplicated triangles are stored once.
+
+Since the vertex positions are not available while the faces are read, the orientation of each output triangle
+is the one of the majority of the input faces clustered to it, instead of the one agreeing with the cell
+normals as in Clustering. The vertex normals are the ones accumulated by the cells (i.e. the normals of the
+ply, if any); cells without normal get the sum of the normals of their output triangles.
+
+Typical usage:
+\code
+Box3f bb;
+StreamingClustering<MyMesh,AverageColorCell<MyMesh> >::ScanBBox("big.ply",bb);
+StreamingClustering<MyMesh,AverageColorCell<MyMesh> > C;
+C.Init(bb,100000);
+C.AddPly("big.ply");
+C.ExtractMesh(simplified);
+\endcode
+*/
+template<class MeshType, class CellType>
+class StreamingClustering
+{
+public:
+  typedef typename MeshType::ScalarType  ScalarType;
+  typedef typename MeshType::CoordType   CoordType;
+  typedef typename MeshType::VertexType  VertexType;
+  typedef io::ImporterPLY<MeshType>      ImporterType;
+  typedef typename ImporterType::template LoadPly_VertAux<ScalarType> VertAux;
+  typedef typename ImporterType::LoadPly_FaceAux FaceAux;
+
+  // Same meaning of Clustering::DuplicateFaceParam
+  bool DuplicateFaceParam;
+  BasicGrid<ScalarType> Grid;
+
+  StreamingClustering() : DuplicateFaceParam(false), triSorted(0) {}
+
+  /// Bounding box of the vertices of a ply file (one streaming pass, nothing is cached on disk).
+  static bool ScanBBox(const char *filename, Box3<ScalarType> &bb)
+  {
+    return ply::ScanBBox(filename,bb,false);
+  }
+
+  /// Same parameters of Clustering::Init(). It removes all the cells and triangles.
+  void Init(Box3<ScalarType> _mbb, int _size, ScalarType _cellsize=0)
+  {
+    Clear();
+    Grid.bbox=_mbb;
+    ScalarType infl = (_cellsize == (ScalarType)0) ? (Grid.bbox.Diag() / _size) : (_cellsize);
+    Grid.bbox.min-=CoordType(infl,infl,infl);
+    Grid.bbox.max+=CoordType(infl,infl,infl);
+    Grid.dim  = Grid.bbox.max - Grid.bbox.min;
+    if(_cellsize==0)
+      BestDim( _size, Grid.dim, Grid.siz );
+    else
+      Grid.siz = Point3i::Construct(Grid.dim / _cellsize);
+    Grid.voxel[0] = Grid.dim[0]/Grid.siz[0];
+    Grid.voxel[1] = Grid.dim[1]/Grid.siz[1];
+    Grid.voxel[2] = Grid.dim[2]/Grid.siz[2];
+  }
+
+  void Clear()
+  {
+    cellMap.clear();
+    cellVec.clear();
+    triVec.clear();
+    triSorted=0;
+  }
+
+  int CountPointSet() const { return int(cellVec.size()); }
+
+  /// Cluster all the vertices and faces of a ply file; polygons are fan triangulated.
+  /// It can be called on many files. Returns 0 or one of the io::PlyInfo error codes (see ImporterPLY::ErrorMsg()).
+  int AddPly(const char *filename, CallBackPos *cb=0)
+  {
+    ply::PlyFile pf;
+    if( pf.Open(filename,ply::PlyFile::MODE_READ)==-1 )
+      return pf.GetError();
+
+    if( pf.AddToRead(ImporterType::VertDesc(0))==-1 && pf.AddToRead(ImporterType::VertDesc(24)) ) return io::PlyInfo::E_NO_VERTEX;
+    if( pf.AddToRead(ImporterType::VertDesc(1))==-1 && pf.AddToRead(ImporterType::VertDesc(25)) ) return io::PlyInfo::E_NO_VERTEX;
+    if( pf.AddToRead(ImporterType::VertDesc(2))==-1 && pf.AddToRead(ImporterType::VertDesc(26)) ) return io::PlyInfo::E_NO_VERTEX;
+    if( pf.AddToRead(ImporterType::FaceDesc(0))==-1 )
+    {
+      int ii;
+      for (ii=_FACEDESC_FIRST_;ii< _FACEDESC_LAST_;++ii)
+        if( pf.AddToRead(ImporterType::FaceDesc(ii))!=-1 ) break;
+      if (ii==_FACEDESC_LAST_) return io::PlyInfo::E_NO_FACE;
+    }
+
+    // scratch mesh with a single vertex used to pass each vertex to its cell
+    MeshType tmp;
+    Allocator<MeshType>::AddVertices(tmp,1);
+    VertexType &v=tmp.vert[0];
+
+    bool hasColor=false;
+    if( HasPerVertexColor(tmp) )
+    {
+      v.C()=Color4b::White;
+      if( pf.AddToRead(ImporterType::VertDesc(5))!=-1 )
+      {
+        pf.AddToRead(ImporterType::VertDesc(6));
+        pf.AddToRead(ImporterType::VertDesc(7));
+        hasColor=true;
+      }
+      else if( pf.AddToRead(ImporterType::VertDesc(9))!=-1 )
+      {
+        pf.AddToRead(ImporterType::VertDesc(10));
+        pf.AddToRead(ImporterType::VertDesc(11));
+        hasColor=true;
+      }
+    }
+    if( HasPerVertexNormal(tmp) )
+    {
+      for(int k=0;k<3;++k)
+        if( pf.AddToRead(ImporterType::VertDesc(14+k))==-1 )
+          pf.AddToRead(ImporterType::VertDesc(27+k));
+      v.N()=CoordType(0,0,0);
+    }
+
+    std::vector<int> vertCell; // the only per vertex data kept: the index of the cell of the vertex
+    std::vector<char> dummy(1<<16);
+    VertAux va;
+    va.n[0]=va.n[1]=va.n[2]=0;
+    FaceAux fa;
+    for(int i=0;i<int(pf.elements.size());++i)
+    {
+      const int n=pf.ElemNumber(i);
+      pf.SetCurElement(i);
+      if( !strcmp( pf.ElemName(i),"vertex" ) )
+      {
+        vertCell.resize(n);
+        for(int j=0;j<n;++j)
+        {
+          if(cb && (j%10000)==0) cb(int(10.0*j/std::max(n,1)),"Clustering vertices");
+          if( pf.Read( (void *)&(va) )==-1 ) return io::PlyInfo::E_SHORTFILE;
+          v.P()=CoordType(va.p[0],va.p[1],va.p[2]);
+          if(hasColor) v.C()=Color4b(va.r,va.g,va.b,255);
+          if(HasPerVertexNormal(tmp)) v.N()=CoordType(va.n[0],va.n[1],va.n[2]);
+          Point3i pi;
+          Grid.PToIP(v.cP(),pi);
+          for(int k=0;k<3;++k) pi[k]=math::Clamp(pi[k],0,Grid.siz[k]-1); // as in Clustering::PToCell()
+          const int c=CellIndex(pi);
+          cellVec[c].AddVertex(tmp,Grid,pi,v);
+          vertCell[j]=c;
+        }
+      }
+      else if( !strcmp( pf.ElemName(i),"face" ) )
+      {
+        const int vn=int(vertCell.size());
+        for(int j=0;j<n;++j)
+        {
+          if(cb && (j%10000)==0) cb(10+int(90.0*j/std::max(n,1)),"Clustering faces");
+          if( pf.Read( (void *)&(fa) )==-1 ) return io::PlyInfo::E_SHORTFILE;
+          for(int k=0;k<fa.size;++k)
+            if( fa.v[k]<0 || fa.v[k]>=vn ) return io::PlyInfo::E_BAD_VERT_INDEX;
+          for(int k=2;k<fa.size;++k)
+            AddTri(vertCell[fa.v[0]],vertCell[fa.v[k-1]],vertCell[fa.v[k]]);
+        }
+      }
+      else
+      {
+        for(int j=0;j<n;++j)
+          pf.Read( (void *)&dummy[0] );
+      }
+    }
+    return ply::E_NOERROR;
+  }
+
+  /// Build the simplified mesh: a vertex for each occupied cell (in order of creation) and the clustered triangles.
+  void ExtractMesh(MeshType &m)
+  {
+    m.Clear();
+    if(cellVec.empty()) return;
+    CompactTri();
+
+    Allocator<MeshType>::AddVertices(m,cellVec.size());
+    std::vector<char> noNormal(cellVec.size(),0);
+    for(size_t i=0;i<cellVec.size();++i)
+    {
+      m.vert[i].P()=cellVec[i].Pos();
+      if(HasPerVertexNormal(m))
+      {
+        m.vert[i].N()=cellVec[i].N();
+        noNormal[i]=(m.vert[i].N()==CoordType(0,0,0));
+      }
+      if(HasPerVertexColor(m))
+        m.vert[i].C()=cellVec[i].Col();
+    }
+
+    Allocator<MeshType>::AddFaces(m,triVec.size());
+    for(size_t i=0;i<triVec.size();++i)
+    {
+      const ClusterTri &t=triVec[i];
+      const bool flip = !DuplicateFaceParam && t.vote<0;
+      m.face[i].V(0)=&m.vert[t.v[flip?1:0]];
+      m.face[i].V(1)=&m.vert[t.v[flip?0:1]];
+      m.face[i].V(2)=&m.vert[t.v[2]];
+      if(HasPerVertexNormal(m))
+      {
+        const CoordType N=TriangleNormal(m.face[i]);
+        for(int k=0;k<3;++k)
+          if(noNormal[t.v[k]]) m.face[i].V(k)->N()+=N;
+      }
+    }
+  }
+
+private:
+  typedef unsigned long long CellKey;
+
+  // Triple of cell indices of an output triangle. The indices are sorted (or, if DuplicateFaceParam, rotated so that
+  // the first is the smallest one); vote is the number of input faces with the sorted orientation minus the opposite ones.
+  struct ClusterTri
+  {
+    int v[3];
+    int vote;
+    bool operator < (const ClusterTri &t) const
+    {
+      return (v[0]!=t.v[0])?(v[0]<t.v[0]):
+             (v[1]!=t.v[1])?(v[1]<t.v[1]):
+                            (v[2]<t.v[2]);
+    }
+    bool SameCells(const ClusterTri &t) const { return v[0]==t.v[0] && v[1]==t.v[1] && v[2]==t.v[2]; }
+  };
+
+  std::unordered_map<CellKey,int> cellMap; // cell of the grid -> index in cellVec
+  std::vector<CellType> cellVec;
+  std::vector<ClusterTri> triVec;          // the first triSorted are sorted and distinct, the others are still to be merged
+  size_t triSorted;
+
+  int CellIndex(const Point3i &pi)
+  {
+    const CellKey key=(CellKey(pi[2])*CellKey(Grid.siz[1]+1)+CellKey(pi[1]))*CellKey(Grid.siz[0]+1)+CellKey(pi[0]);
+    typename std::unordered_map<CellKey,int>::iterator ci=cellMap.find(key);
+    if(ci!=cellMap.end()) return ci->second;
+    const int c=int(cellVec.size());
+    cellMap[key]=c;
+    cellVec.push_back(CellType());
+    return c;
+  }
+
+  void AddTri(int c0, int c1, int c2)
+  {
+    if(c0==c1 || c0==c2 || c1==c2) return;
+    ClusterTri t;
+    t.v[0]=c0; t.v[1]=c1; t.v[2]=c2;
+    t.vote=1;
+    if(DuplicateFaceParam)
+    {
+      if(t.v[1]<t.v[0] && t.v[1]<t.v[2]) { std::swap(t.v[0],t.v[1]); std::swap(t.v[1],t.v[2]); }
+      else if(t.v[2]<t.v[0] && t.v[2]<t.v[1]) { std::swap(t.v[0],t.v[2]); std::swap(t.v[1],t.v[2]); }
+    }
+    else
+    { // each swap flips the orientation
+      if(t.v[0]>t.v[1]) { std::swap(t.v[0],t.v[1]); t.vote=-t.vote; }
+      if(t.v[0]>t.v[2]) { std::swap(t.v[0],t.v[2]); t.vote=-t.vote; }
+      if(t.v[1]>t.v[2]) { std::swap(t.v[1],t.v[2]); t.vote=-t.vote; }
+    }
+    triVec.push_back(t);
+    // merge when the unsorted part is as large as the sorted one, so the buffer stays within twice the distinct triangles
+    if(triVec.size()-triSorted >= std::max(triSorted,size_t(1<<16)))
+      CompactTri();
+  }
+
+  // Sort the new triangles, merge them with the sorted ones and sum the votes of the repeated triples.
+  void CompactTri()
+  {
+    std::sort(triVec.begin()+triSorted,triVec.end());
+    std::inplace_merge(triVec.begin(),triVec.begin()+triSorted,triVec.end());
+    size_t last=0;
+    for(size_t i=1;i<triVec.size();++i)
+    {
+      if(triVec[i].SameCells(triVec[last])) triVec[last].vote+=triVec[i].vote;
+      else triVec[++last]=triVec[i];
+    }
+    if(!triVec.empty()) triVec.resize(last+1);
+    triSorted=triVec.size();
+  }
+};
+
+} // namespace tri
+} // namespace vcg
+
+#endif
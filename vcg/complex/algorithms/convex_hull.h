@@ -54,6 +54,17 @@ private:
 
   typedef std::pair<InputVertexPointer, ScalarType> Pair;
 
+  // A fan face created by an expansion step, with the two faces whose visibility lists contain its candidate points
+  struct FanFace
+  {
+    int face;
+    int oldFace[2];
+  };
+
+  // The per point loops run in parallel only above these sizes
+  static const int ParallelMinPointNum = 20000;
+  static const int ParallelMinConflictNum = 8192;
+
 
   // Initialize the convex hull with the biggest tetraedron created using the vertices of the input mesh
   static void InitConvexHull(InputMesh& mesh, CHMesh& convexHull)
@@ -156,6 +167,152 @@ private:
   }
 
 
+  // Mark as visited the points strictly inside the convex hull of the points extreme along 14 directions (axes and diagonals);
+  // they cannot be vertices of the hull. The coordinates are given as separate arrays so that the tests vectorize.
+  static int DiscardInteriorPoints(InputMesh& mesh, const std::vector<ScalarType>& px, const std::vector<ScalarType>& py, const std::vector<ScalarType>& pz)
+  {
+    const int vn = int(px.size());
+    const int dirNum = 14;
+    static const ScalarType dir[dirNum][3] = { {1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1},
+                                               {1,1,1},{-1,-1,-1},{1,1,-1},{-1,-1,1},{1,-1,1},{-1,1,-1},{-1,1,1},{1,-1,-1} };
+    // extreme points, computed on fixed chunks and merged in order so that ties are always broken the same way
+    const int chunkNum = 64;
+    std::vector<int> chunkBest(chunkNum*dirNum,-1);
+#pragma omp parallel for schedule(dynamic,1)
+    for (int c = 0; c < chunkNum; c++)
+    {
+      const int first = int((long long)vn*c/chunkNum), last = int((long long)vn*(c+1)/chunkNum);
+      for (int k = 0; k < dirNum; k++)
+      {
+        int best = -1;
+        ScalarType bestVal = 0;
+        for (int i = first; i < last; i++)
+        {
+          const ScalarType val = dir[k][0]*px[i] + dir[k][1]*py[i] + dir[k][2]*pz[i];
+          if (best == -1 || val > bestVal) { best = i; bestVal = val; }
+        }
+        chunkBest[c*dirNum+k] = best;
+      }
+    }
+    std::vector<int> ext;
+    for (int k = 0; k < dirNum; k++)
+    {
+      int best = -1;
+      ScalarType bestVal = 0;
+      for (int c = 0; c < chunkNum; c++)
+      {
+        const int i = chunkBest[c*dirNum+k];
+        if (i == -1) continue;
+        const ScalarType val = dir[k][0]*px[i] + dir[k][1]*py[i] + dir[k][2]*pz[i];
+        if (best == -1 || val > bestVal) { best = i; bestVal = val; }
+      }
+      if (best != -1) ext.push_back(best);
+    }
+    std::sort(ext.begin(), ext.end());
+    ext.erase(std::unique(ext.begin(), ext.end()), ext.end());
+    const int en = int(ext.size());
+    if (en < 4)
+      return 0;
+
+    // faces of the hull of the extreme points: planes through three of them leaving all the others on one side
+    Box3<ScalarType> bb;
+    for (int i = 0; i < en; i++) bb.Add(mesh.vert[ext[i]].P());
+    const double eps = 1e-5 * bb.Diag();
+    std::vector<Point3<double> > planeN;
+    std::vector<double> planeD;
+    for (int a = 0; a < en; a++)
+      for (int b = a + 1; b < en; b++)
+        for (int c = b + 1; c < en; c++)
+        {
+          Point3<double> p0 = Point3<double>::Construct(mesh.vert[ext[a]].P());
+          Point3<double> n = (Point3<double>::Construct(mesh.vert[ext[b]].P()) - p0) ^ (Point3<double>::Construct(mesh.vert[ext[c]].P()) - p0);
+          if (n.Norm() <= eps * eps) continue;
+          n.Normalize();
+          int above = 0, below = 0;
+          for (int i = 0; i < en; i++)
+          {
+            const double d = (Point3<double>::Construct(mesh.vert[ext[i]].P()) - p0) * n;
+            if (d > eps) above++;
+            if (d < -eps) below++;
+          }
+          if (above > 0 && below > 0) continue;
+          if (above + below == 0) continue; // all the extreme points are coplanar
+          if (above > 0) n = -n;
+          bool dup = false;
+          for (size_t j = 0; j < planeN.size() && !dup; j++)
+            dup = (planeN[j] * n > 1 - 1e-9) && std::abs(planeD[j] - n * p0) < eps;
+          if (!dup) { planeN.push_back(n); planeD.push_back(n * p0); }
+        }
+    if (planeN.size() < 4)
+      return 0;
+
+    // a point is discarded if it is below all the planes by more than eps
+    const int planeNum = int(planeN.size());
+    std::vector<ScalarType> nx(planeNum), ny(planeNum), nz(planeNum), nd(planeNum);
+    for (int j = 0; j < planeNum; j++)
+    {
+      nx[j] = ScalarType(planeN[j][0]); ny[j] = ScalarType(planeN[j][1]); nz[j] = ScalarType(planeN[j][2]);
+      nd[j] = ScalarType(planeD[j] - eps);
+    }
+    const int blockSize = 256;
+    const int blockNum = (vn + blockSize - 1) / blockSize;
+    int discarded = 0;
+#pragma omp parallel for schedule(static) reduction(+:discarded)
+    for (int bi = 0; bi < blockNum; bi++)
+    {
+      const int first = bi * blockSize;
+      const int n = std::min(blockSize, vn - first);
+      unsigned char inside[blockSize];
+      for (int i = 0; i < n; i++) inside[i] = 1;
+      for (int j = 0; j < planeNum; j++)
+      {
+        const ScalarType a = nx[j], b = ny[j], c = nz[j], d = nd[j];
+        const ScalarType *x = &px[first], *y = &py[first], *z = &pz[first];
+        for (int i = 0; i < n; i++)
+          inside[i] &= (unsigned char)(a*x[i] + b*y[i] + c*z[i] < d);
+      }
+      for (int i = 0; i < n; i++)
+        if (inside[i] && !mesh.vert[first+i].IsV())
+        {
+          mesh.vert[first+i].SetV();
+          discarded++;
+        }
+    }
+    return discarded;
+  }
+
+  // Build the visibility list of a fan face (and find its furthest point) from the lists of the two faces it replaces
+  static void BuildFanFaceList(CHMesh& convexHull, const FanFace& ff, std::vector<std::vector<InputVertexPointer> >& listVertexPerFace, std::vector<Pair>& furthestVexterPerFace)
+  {
+    const std::vector<InputVertexPointer>& l0 = listVertexPerFace[ff.oldFace[0]];
+    const std::vector<InputVertexPointer>& l1 = listVertexPerFace[ff.oldFace[1]];
+    std::vector<InputVertexPointer> vertexToTest(l0.size() + l1.size());
+    typename std::vector<InputVertexPointer>::iterator tempIt = std::set_union(l0.begin(), l0.end(), l1.begin(), l1.end(), vertexToTest.begin());
+    vertexToTest.resize(tempIt - vertexToTest.begin());
+
+    const CHFacePointer fi = &convexHull.face[ff.face];
+    std::vector<InputVertexPointer> tempVect;
+    Pair newInfo = std::make_pair((InputVertexPointer)NULL , 0.0f);
+    for (size_t ii = 0; ii < vertexToTest.size(); ii++)
+    {
+      if (!(*vertexToTest[ii]).IsV())
+      {
+        float dist = ((*vertexToTest[ii]).P() - (*fi).P(0)).dot((*fi).N());
+        if (dist > 0)
+        {
+          tempVect.push_back(vertexToTest[ii]);
+          if (dist > newInfo.second)
+          {
+            newInfo.second = dist;
+            newInfo.first = vertexToTest[ii];
+          }
+        }
+      }
+    }
+    listVertexPerFace[ff.face].swap(tempVect);
+    furthestVexterPerFace[ff.face] = newInfo;
+  }
+
 public:
 
 
@@ -166,8 +323,13 @@ public:
 
     "The quickhull algorithm for convex hulls" by C. Bradford Barber et al.
     ACM Transactions on Mathematical Software, Volume 22 Issue 4, Dec. 1996
+
+    If prefilter is true the points inside the polytope of the extreme points along 14 directions are discarded
+    before starting, which for large clouds removes most of the points at the cost of one linear pass.
+    The initial assignment of the points to the faces and the visibility lists of the new faces of each step
+    are computed in parallel; the result does not depend on the number of threads.
   */
-  static bool ComputeConvexHull(InputMesh& mesh, CHMesh& convexHull)
+  static bool ComputeConvexHull(InputMesh& mesh, CHMesh& convexHull, bool prefilter=true)
   {
     vcg::tri::RequireFFAdjacency(convexHull);
     vcg::tri::RequirePerFaceNormal(convexHull);
@@ -178,28 +340,64 @@ public:
     vcg::tri::UpdateFlags<InputMesh>::VertexClearV(mesh);
     InitConvexHull(mesh, convexHull);
 
-    //Build list of visible vertices for each convex hull face and find the furthest vertex for each face
+    //Coordinates as separate arrays for the parallel loops
+    const int vn = int(mesh.vert.size());
+    std::vector<ScalarType> px(vn), py(vn), pz(vn);
+#pragma omp parallel for schedule(static) if(vn > ParallelMinPointNum)
+    for (int i = 0; i < vn; i++)
+    {
+      px[i] = mesh.vert[i].P()[0];
+      py[i] = mesh.vert[i].P()[1];
+      pz[i] = mesh.vert[i].P()[2];
+    }
+    if (prefilter)
+      DiscardInteriorPoints(mesh, px, py, pz);
+
+    //Build list of visible vertices for each convex hull face and find the furthest vertex for each face.
+    //The faces seen by each point are found in parallel, then the lists are filled in index order.
+    const int initFaceNum = int(convexHull.face.size());
+    ScalarType fN[4][3], fP[4][3];
+    for (int j = 0; j < initFaceNum; j++)
+      for (int k = 0; k < 3; k++)
+      {
+        fN[j][k] = convexHull.face[j].N()[k];
+        fP[j][k] = convexHull.face[j].P(0)[k];
+      }
+    std::vector<unsigned char> visMask(vn, 0);
+#pragma omp parallel for schedule(static) if(vn > ParallelMinPointNum)
+    for (int i = 0; i < vn; i++)
+    {
+      if (mesh.vert[i].IsV()) continue;
+      unsigned char mask = 0;
+      for (int j = 0; j < initFaceNum; j++)
+      {
+        ScalarType dist = (px[i] - fP[j][0]) * fN[j][0] + (py[i] - fP[j][1]) * fN[j][1] + (pz[i] - fP[j][2]) * fN[j][2];
+        if (dist > 0) mask |= (unsigned char)(1 << j);
+      }
+      visMask[i] = mask;
+    }
+    std::vector<ScalarType>().swap(px);
+    std::vector<ScalarType>().swap(py);
+    std::vector<ScalarType>().swap(pz);
+
     std::vector<std::vector<InputVertexPointer>> listVertexPerFace(convexHull.face.size());
     std::vector<Pair> furthestVexterPerFace(convexHull.face.size(), std::make_pair((InputVertexPointer)NULL, 0.0f));
-    for (size_t i = 0; i < mesh.vert.size(); i++)
-    {
-    if (!mesh.vert[i].IsV())
+    for (int i = 0; i < vn; i++)
     {
-      for (size_t j = 0; j < convexHull.face.size(); j++)
+      if (visMask[i] == 0) continue;
+      for (int j = 0; j < initFaceNum; j++)
       {
+        if ((visMask[i] & (1 << j)) == 0) continue;
         ScalarType dist = (mesh.vert[i].P() - convexHull.face[j].P(0)).dot(convexHull.face[j].N());
-        if (dist > 0)
+        listVertexPerFace[j].push_back(&mesh.vert[i]);
+        if (dist > furthestVexterPerFace[j].second)
         {
-          listVertexPerFace[j].push_back(&mesh.vert[i]);
-          if (dist > furthestVexterPerFace[j].second)
-          {
-            furthestVexterPerFace[j].second = dist;
-            furthestVexterPerFace[j].first = &mesh.vert[i];
-          }
+          furthestVexterPerFace[j].second = dist;
+          furthestVexterPerFace[j].first = &mesh.vert[i];
         }
       }
     }
-    }
+    std::vector<unsigned char>().swap(visMask);
 
     for (size_t i = 0; i < listVertexPerFace.size(); i++)
     {
@@ -248,6 +446,7 @@ public:
 
         //Add a new face for each border
         std::unordered_map< CHVertexPointer, std::pair<int, char> > fanMap;
+        std::vector<FanFace> fanVec;
         for (size_t jj = 0; jj < borderFace.size(); jj++)
         {
           int indexFace = borderFace[jj];
@@ -282,32 +481,14 @@ public:
                   fanMap[vp[ii]] = std::make_pair(newFace, indexE);
                 }
               }
-              //Build the visibility list for the new face
-              std::vector<InputVertexPointer> tempVect;
-              int indices[2] = { indexFace, int(vcg::tri::Index(convexHull, f->FFp(j)) )};
-              std::vector<InputVertexPointer> vertexToTest(listVertexPerFace[indices[0]].size() + listVertexPerFace[indices[1]].size());
-              typename std::vector<InputVertexPointer>::iterator tempIt = std::set_union(listVertexPerFace[indices[0]].begin(), listVertexPerFace[indices[0]].end(), listVertexPerFace[indices[1]].begin(), listVertexPerFace[indices[1]].end(), vertexToTest.begin());
-              vertexToTest.resize(tempIt - vertexToTest.begin());
-
-              Pair newInfo = std::make_pair((InputVertexPointer)NULL , 0.0f);
-              for (size_t ii = 0; ii < vertexToTest.size(); ii++)
-              {
-                if (!(*vertexToTest[ii]).IsV())
-                {
-                  float dist = ((*vertexToTest[ii]).P() - (*fi).P(0)).dot((*fi).N());
-                  if (dist > 0)
-                  {
-                    tempVect.push_back(vertexToTest[ii]);
-                    if (dist > newInfo.second)
-                    {
-                      newInfo.second = dist;
-                      newInfo.first = vertexToTest[ii];
-                    }
-                  }
-                }
-              }
-              listVertexPerFace.push_back(tempVect);
-              furthestVexterPerFace.push_back(newInfo);
+              //The visibility list of the new face is built after the whole fan has been created
+              FanFace ff;
+              ff.face = newFace;
+              ff.oldFace[0] = indexFace;
+              ff.oldFace[1] = int(vcg::tri::Index(convexHull, f->FFp(j)));
+              fanVec.push_back(ff);
+              listVertexPerFace.push_back(std::vector<InputVertexPointer>());
+              furthestVexterPerFace.push_back(std::make_pair((InputVertexPointer)NULL , 0.0f));
               //Update topology of the new face
               CHFacePointer ffp = f->FFp(j);
               int ffi = f->FFi(j);
@@ -320,6 +501,15 @@ public:
             }
           }
         }
+        //Build the visibility lists of the fan faces; they are independent, so they are computed concurrently
+        const int fanNum = int(fanVec.size());
+        size_t conflictNum = 0;
+        for (int k = 0; k < fanNum; k++)
+          conflictNum += listVertexPerFace[fanVec[k].oldFace[0]].size() + listVertexPerFace[fanVec[k].oldFace[1]].size();
+#pragma omp parallel for schedule(dynamic,1) if(conflictNum > size_t(ParallelMinConflictNum))
+        for (int k = 0; k < fanNum; k++)
+          BuildFanFaceList(convexHull, fanVec[k], listVertexPerFace, furthestVexterPerFace);
+
         //Delete the faces inside the updated convex hull
         for (size_t j = 0; j < visFace.size(); j++)
         {
@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <list>
+#include <unordered_map>
 #include <vcg/complex/algorithms/update/topology.h>
 #include <vcg/complex/algorithms/update/flag.h>
 
@@ -146,11 +147,15 @@ protected:
       (*s).previous = front.end();
       (*s).next = front.end();
     }
-    //now create loops:
+    //now create loops: the edges are indexed by their first vertex (keeping the list order)
+    std::unordered_map<int, std::vector<std::list<FrontEdge>::iterator> > startMap;
+    for(std::list<FrontEdge>::iterator j = front.begin(); j != front.end(); j++)
+      startMap[(*j).v0].push_back(j);
     for(std::list<FrontEdge>::iterator s = front.begin(); s != front.end(); s++) {
-      for(std::list<FrontEdge>::iterator j = front.begin(); j != front.end(); j++) {
+      std::vector<std::list<FrontEdge>::iterator> &cand = startMap[(*s).v1];
+      for(size_t k = 0; k < cand.size(); k++) {
+        std::list<FrontEdge>::iterator j = cand[k];
         if(s == j) continue;
-        if((*s).v1 != (*j).v0) continue;
         if((*j).previous != front.end()) continue;
         (*s).next = j;
         (*j).previous = s;
@@ -445,11 +450,10 @@ protected:
     {
         (*e).active = false;
         //std::list<FrontEdge>::iterator res = std::find(front.begin(),front.end(),e);
-        FrontEdge tmp = *e;
+        // splice keeps e valid, now pointing into deads
         deads.splice(deads.end(), front, e);
-        std::list<FrontEdge>::iterator newe = std::find(deads.begin(),deads.end(),tmp);
-        tmp.previous->next = newe;
-        tmp.next->previous = newe;
+        (*e).previous->next = e;
+        (*e).next->previous = e;
     }
   }
 
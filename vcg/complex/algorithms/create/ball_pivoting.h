@@ -75,30 +75,206 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
     if(radius == 0) // radius ==0 means that an auto guess should be attempted.
       radius = sqrt((this->mesh.bbox.Diag()*this->mesh.bbox.Diag())/this->mesh.vn);
 
+    ownBit = true;
+    usedBit = VertexType::NewBitFlag();
+    Init();
+  }
 
-    min_edge *= radius;
-    max_edge *= radius;
+  ~BallPivoting() {
+    if(ownBit) VertexType::DeleteBitFlag(usedBit);
+    delete tree;
+  }
 
-    VertexConstDataWrapper<MESH> ww(this->mesh);
-    tree = new KdTree<ScalarType>(ww);
-//    tree->setMaxNofNeighbors(16);
+  /// \brief Partitioned parallel reconstruction of the points of a mesh (without faces).
+  ///
+  /// The bounding box is split along its longest axis in slabs with the same number of points.
+  /// Each slab (plus a margin of points of the nearby slabs) is reconstructed concurrently by its own
+  /// BallPivoting and keeps the faces whose barycenter falls in the slab. Since the pivoting is local, near a cut the
+  /// two slabs build mostly the same triangles; the pieces grown from different seeds are then oriented consistently
+  /// and a band around each cut is processed again (concurrently for all the cuts): the faces where the two slabs
+  /// disagree are removed and the holes are closed continuing the front from the existing faces.
+  /// The parameters are the same of the constructor; slabNum==0 means one slab every 50k points (at most 64).
+  /// Slabs are merged if they are too thin for the given radius. The radius is computed on the whole mesh.
+  static void BuildMeshParallel(MESH &m, float _radius = 0, float minr = 0.2, float angle = M_PI/2,
+                                int slabNum = 0, CallBackPos *cb = 0)
+  {
+    if(m.fn>0 || slabNum==1) // existing faces are handled only by the serial version
+    {
+      BallPivoting<MESH> pivot(m,_radius,minr,angle);
+      pivot.BuildMesh(cb);
+      return;
+    }
+    UpdateBounding<MESH>::Box(m);
+    Point3x bar(0,0,0);
+    std::vector<int> ind;
+    for(int i=0;i<(int)m.vert.size();++i)
+      if(!m.vert[i].IsD()) { bar+=m.vert[i].cP(); ind.push_back(i); }
+    assert(m.vn > 3);
+    bar/=m.vn;
+    const ScalarType r = (_radius==0) ? ScalarType(sqrt((m.bbox.Diag()*m.bbox.Diag())/m.vn)) : ScalarType(_radius);
+    const int axis = m.bbox.MaxDim();
+    const ScalarType margin = 4*r;     // extra points around each slab
+    const ScalarType band = 7*r;       // half width of the points and faces used to close a seam
+    const ScalarType inner = 4*r;      // half width of the region where the seam can grow
+
+    // cuts at the quantiles of the coordinate, dropping the ones that make too thin slabs
+    if(slabNum<=0) slabNum = std::max(1,std::min(64,m.vn/50000));
+    std::vector<ScalarType> coord(ind.size());
+    for(size_t i=0;i<ind.size();++i) coord[i]=m.vert[ind[i]].cP()[axis];
+    std::vector<ScalarType> cut;
+    ScalarType last = m.bbox.min[axis];
+    for(int s=1;s<slabNum;++s)
+    {
+      typename std::vector<ScalarType>::iterator q = coord.begin()+(coord.size()*s)/slabNum;
+      std::nth_element(coord.begin(),q,coord.end());
+      if(*q-last >= 4*band && m.bbox.max[axis]-*q >= 4*band) { cut.push_back(*q); last=*q; }
+    }
+    if(cut.empty())
+    {
+      BallPivoting<MESH> pivot(m,r,minr,angle);
+      pivot.BuildMesh(cb);
+      return;
+    }
+    const int sn = int(cut.size())+1;
+    const ScalarType inf = std::numeric_limits<ScalarType>::max();
+    std::vector<ScalarType> lo(sn,-inf), hi(sn,inf);
+    for(int s=0;s<sn-1;++s) { hi[s]=cut[s]; lo[s+1]=cut[s]; }
+
+    const int bit = VertexType::NewBitFlag(); // all the partial meshes share the same user bit
+    std::vector<std::vector<int> > slabFaces(sn), slabComp(sn);
+    std::vector<int> compOffset(sn+1,0);
+    if(cb) cb(0,"Pivoting slabs");
+#pragma omp parallel for schedule(dynamic,1)
+    for(int s=0;s<sn;++s)
+    {
+      std::vector<int> sub;
+      for(size_t i=0;i<ind.size();++i)
+      {
+        const ScalarType c = m.vert[ind[i]].cP()[axis];
+        if(c >= lo[s]-margin && c < hi[s]+margin) sub.push_back(ind[i]);
+      }
+      if(sub.size()<=3) continue;
+      MESH sm;
+      BuildSubMesh(m,sub,sm);
+      BallPivoting<MESH> pivot(sm,r,minr,angle,bit,bar);
+      pivot.BuildMesh();
+      // connected components of the slab, to fix their orientation later
+      std::vector<int> parent(sub.size());
+      std::vector<char> parity(sub.size(),0);
+      for(size_t i=0;i<parent.size();++i) parent[i]=int(i);
+      char p;
+      for(size_t i=0;i<sm.face.size();++i)
+        for(int k=1;k<3;++k)
+        {
+          const int a = FindParity(parent,parity,int(tri::Index(sm,sm.face[i].V(0))),p);
+          const int b = FindParity(parent,parity,int(tri::Index(sm,sm.face[i].V(k))),p);
+          if(a!=b) parent[b]=a;
+        }
+      for(size_t i=0;i<sm.face.size();++i)
+      {
+        const ScalarType c = Barycenter(sm.face[i])[axis];
+        if(c < lo[s] || c >= hi[s]) continue;
+        for(int k=0;k<3;++k) slabFaces[s].push_back(sub[tri::Index(sm,sm.face[i].V(k))]);
+        slabComp[s].push_back(FindParity(parent,parity,int(tri::Index(sm,sm.face[i].V(0))),p));
+      }
+      compOffset[s+1]=int(sub.size());
+    }
+    std::vector<int> faceStart(sn+1,int(m.face.size())), comp;
+    for(int s=0;s<sn;++s)
+    {
+      compOffset[s+1]+=compOffset[s];
+      for(size_t i=0;i<slabComp[s].size();++i) comp.push_back(compOffset[s]+slabComp[s][i]);
+      AppendFaces(m,slabFaces[s]);
+      faceStart[s+1]=int(m.face.size());
+    }
+    // each slab chooses the orientation of its seeds on its own
+    ReconcileOrientation(m,faceStart,comp,compOffset[sn],cut,axis,3*r,2*r);
 
-    usedBit = VertexType::NewBitFlag();
-    UpdateFlags<MESH>::VertexClear(this->mesh,usedBit);
-    UpdateFlags<MESH>::VertexClearV(this->mesh);
+    // faces and points of the band around each cut
+    std::vector<std::vector<int> > seamPoints(sn-1), seamFaces(sn-1);
+    for(size_t i=0;i<ind.size();++i)
+    {
+      const ScalarType c = m.vert[ind[i]].cP()[axis];
+      const int k = NearestCut(cut,c);
+      if(fabs(c-cut[k]) <= band) seamPoints[k].push_back(ind[i]);
+    }
+    for(int i=0;i<(int)m.face.size();++i)
+      for(int j=0;j<3;++j)
+      {
+        const ScalarType c = m.face[i].cP(j)[axis];
+        const int k = NearestCut(cut,c);
+        if(fabs(c-cut[k]) <= band) { seamFaces[k].push_back(i); break; }
+      }
 
-    for(int i = 0; i < (int)this->mesh.face.size(); i++) {
-      FaceType &f = this->mesh.face[i];
-      if(f.IsD()) continue;
-      for(int k = 0; k < 3; k++) {
-        Mark(f.V(k));
+    if(cb) cb(70,"Closing seams");
+    std::vector<std::vector<int> > newFaces(sn-1), deadFaces(sn-1);
+#pragma omp parallel for schedule(dynamic,1)
+    for(int k=0;k<sn-1;++k)
+    {
+      std::vector<int> sub(seamPoints[k]);
+      for(size_t i=0;i<seamFaces[k].size();++i)
+        for(int j=0;j<3;++j) sub.push_back(int(tri::Index(m,m.face[seamFaces[k][i]].V(j))));
+      std::sort(sub.begin(),sub.end());
+      sub.erase(std::unique(sub.begin(),sub.end()),sub.end());
+      if(sub.size()<=3) continue;
+      // where the two slabs disagree the faces overlap: remove the ones with edges shared by more than two faces
+      // or by two faces with the same orientation, the holes are filled by the pivoting
+      std::vector<int> ft(seamFaces[k].size()*3);
+      for(size_t i=0;i<seamFaces[k].size();++i)
+        for(int j=0;j<3;++j)
+          ft[i*3+j] = int(std::lower_bound(sub.begin(),sub.end(),int(tri::Index(m,m.face[seamFaces[k][i]].V(j))))-sub.begin());
+      std::vector<char> keep(seamFaces[k].size(),1);
+      for(bool changed=true;changed;)
+      {
+        changed=false;
+        std::map<std::pair<int,int>,std::pair<int,int> > edgeUse; // (min,max) -> (faces, faces with v0<v1)
+        for(size_t i=0;i<keep.size();++i) if(keep[i])
+          for(int j=0;j<3;++j)
+          {
+            const int a=ft[i*3+j], b=ft[i*3+(j+1)%3];
+            std::pair<int,int> &u = edgeUse[std::make_pair(std::min(a,b),std::max(a,b))];
+            u.first++; if(a<b) u.second++;
+          }
+        for(size_t i=0;i<keep.size();++i) if(keep[i])
+        {
+          if(fabs(Barycenter(m.face[seamFaces[k][i]])[axis]-cut[k]) > inner) continue;
+          for(int j=0;j<3;++j)
+          {
+            const int a=ft[i*3+j], b=ft[i*3+(j+1)%3];
+            const std::pair<int,int> &u = edgeUse[std::make_pair(std::min(a,b),std::max(a,b))];
+            if(u.first>2 || (u.first==2 && u.second!=1)) { keep[i]=0; changed=true; break; }
+          }
+        }
       }
+      MESH sm;
+      BuildSubMesh(m,sub,sm);
+      for(size_t i=0;i<keep.size();++i)
+      {
+        if(keep[i]) tri::Allocator<MESH>::AddFace(sm,ft[i*3],ft[i*3+1],ft[i*3+2]);
+        else deadFaces[k].push_back(seamFaces[k][i]);
+      }
+      if(tri::HasVFAdjacency(sm)) tri::UpdateTopology<MESH>::VertexFace(sm);
+      const size_t oldFn = sm.face.size();
+      BallPivoting<MESH> pivot(sm,r,minr,angle,bit,bar);
+      // outside the inner region no point can be used and the front does not advance
+      for(size_t i=0;i<sm.vert.size();++i)
+        if(fabs(sm.vert[i].cP()[axis]-cut[k]) > inner) sm.vert[i].SetUserBit(bit);
+      std::vector<std::list<FrontEdge>::iterator> toKill;
+      for(std::list<FrontEdge>::iterator e = pivot.front.begin(); e != pivot.front.end(); ++e)
+        if(fabs(sm.vert[(*e).v0].cP()[axis]-cut[k]) > inner || fabs(sm.vert[(*e).v1].cP()[axis]-cut[k]) > inner)
+          toKill.push_back(e);
+      for(size_t i=0;i<toKill.size();++i) pivot.KillEdge(toKill[i]);
+      pivot.BuildMesh();
+      for(size_t i=oldFn;i<sm.face.size();++i)
+        for(int j=0;j<3;++j) newFaces[k].push_back(sub[tri::Index(sm,sm.face[i].V(j))]);
     }
-  }
-
-  ~BallPivoting() {
-    VertexType::DeleteBitFlag(usedBit);
-    delete tree;
+    for(int k=0;k<sn-1;++k)
+      for(size_t i=0;i<deadFaces[k].size();++i)
+        if(!m.face[deadFaces[k][i]].IsD()) tri::Allocator<MESH>::DeleteFace(m,m.face[deadFaces[k][i]]);
+    tri::Allocator<MESH>::CompactFaceVector(m);
+    for(int k=0;k<sn-1;++k) AppendFaces(m,newFaces[k]);
+    VertexType::DeleteBitFlag(bit);
+    if(cb) cb(100,"Done");
   }
 
   bool Seed(int &v0, int &v1, int &v2) {
@@ -320,21 +496,24 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
       return -1;
     }
 
-    //test if id is in some border (to return touch
-    for(std::list<FrontEdge>::iterator k = this->front.begin(); k != this->front.end(); k++)
+    //test if id is in some border (to return touch); only border vertices can start a front edge
+    if(candidate->IsB())
     {
-      if((*k).v0 == candidateIndex)
+      for(std::list<FrontEdge>::iterator k = this->front.begin(); k != this->front.end(); k++)
       {
-        touch.first = AdvancingFront<MESH>::FRONT;
-        touch.second = k;
+        if((*k).v0 == candidateIndex)
+        {
+          touch.first = AdvancingFront<MESH>::FRONT;
+          touch.second = k;
+        }
       }
-    }
-    for(std::list<FrontEdge>::iterator k = this->deads.begin(); k != this->deads.end(); k++)
-    {
-      if((*k).v0 == candidateIndex)
+      for(std::list<FrontEdge>::iterator k = this->deads.begin(); k != this->deads.end(); k++)
       {
-        touch.first = AdvancingFront<MESH>::DEADS;
-        touch.second = k;
+        if((*k).v0 == candidateIndex)
+        {
+          touch.first = AdvancingFront<MESH>::DEADS;
+          touch.second = k;
+        }
       }
     }
 
@@ -348,6 +527,144 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
   int usedBit;       //use to detect if a vertex has been already processed.
   Point3x baricenter;//used for the first seed.
   KdTree<ScalarType> *tree;
+  bool ownBit;       //false if the user bit belongs to the caller
+
+  // Used by BuildMeshParallel: absolute radius, user bit and baricenter given by the caller.
+  BallPivoting(MESH &_mesh, ScalarType _radius, float minr, float angle, int _usedBit, const Point3x &_baricenter):
+    AdvancingFront<MESH>(_mesh), radius(_radius),
+    min_edge(minr), max_edge(1.8), max_angle(cos(angle)),
+    last_seed(-1), usedBit(_usedBit), baricenter(_baricenter), ownBit(false) {
+    UpdateBounding<MESH>::Box(_mesh);
+    Init();
+  }
+
+  void Init() {
+    min_edge *= radius;
+    max_edge *= radius;
+
+    VertexConstDataWrapper<MESH> ww(this->mesh);
+    tree = new KdTree<ScalarType>(ww);
+//    tree->setMaxNofNeighbors(16);
+
+    UpdateFlags<MESH>::VertexClear(this->mesh,usedBit);
+    UpdateFlags<MESH>::VertexClearV(this->mesh);
+
+    for(int i = 0; i < (int)this->mesh.face.size(); i++) {
+      FaceType &f = this->mesh.face[i];
+      if(f.IsD()) continue;
+      for(int k = 0; k < 3; k++) {
+        Mark(f.V(k));
+      }
+    }
+  }
+
+  // copy the given vertices of m (sorted indexes) in a new mesh without faces
+  static void BuildSubMesh(MESH &m, const std::vector<int> &sub, MESH &sm)
+  {
+    tri::Allocator<MESH>::AddVertices(sm,sub.size());
+    for(size_t i=0;i<sub.size();++i)
+    {
+      sm.vert[i].ImportData(m.vert[sub[i]]);
+      sm.vert[i].Flags()=0;
+    }
+  }
+
+  static void AppendFaces(MESH &m, const std::vector<int> &tri)
+  {
+    if(tri.empty()) return;
+    typename MESH::FaceIterator fi = tri::Allocator<MESH>::AddFaces(m,tri.size()/3);
+    for(size_t i=0;i<tri.size();i+=3,++fi)
+    {
+      for(int k=0;k<3;++k) (*fi).V(k)=&m.vert[tri[i+k]];
+      (*fi).N() = TriangleNormal(*fi).Normalize();
+    }
+  }
+
+  // union find with the parity of each element with respect to its root
+  static int FindParity(std::vector<int> &parent, std::vector<char> &parity, int x, char &p)
+  {
+    p = 0;
+    int root = x;
+    while(parent[root]!=root) { p ^= parity[root]; root = parent[root]; }
+    char q = p; // path compression
+    while(parent[x]!=root) { int next = parent[x]; char px = parity[x]; parent[x] = root; parity[x] = q; q ^= px; x = next; }
+    return root;
+  }
+
+  /// Make the orientation of the pieces built by different slabs consistent. The faces of each slab near a cut
+  /// are paired with the closest faces of the next slab: each pair votes for keeping or flipping the two pieces
+  /// (connected components of the slabs) they belong to. The flips are propagated starting from the strongest votes
+  /// and for each group of joined pieces the orientation of the majority of the faces is kept.
+  static void ReconcileOrientation(MESH &m, const std::vector<int> &faceStart, const std::vector<int> &comp, int compNum,
+                                   const std::vector<ScalarType> &cut, int axis, ScalarType band, ScalarType maxDist)
+  {
+    const int cn = int(cut.size());
+    std::vector<std::map<std::pair<int,int>,int> > vote(cn);
+#pragma omp parallel for schedule(dynamic,1)
+    for(int k=0;k<cn;++k)
+    {
+      std::vector<int> fb;
+      std::vector<Point3x> pb;
+      for(int i=faceStart[k+1];i<faceStart[k+2];++i)
+      {
+        const Point3x b = Barycenter(m.face[i]);
+        if(fabs(b[axis]-cut[k]) <= band) { fb.push_back(i); pb.push_back(b); }
+      }
+      if(fb.empty()) continue;
+      VectorConstDataWrapper<std::vector<Point3x> > ww(pb);
+      KdTree<ScalarType> tree(ww);
+      for(int i=faceStart[k];i<faceStart[k+1];++i)
+      {
+        const Point3x b = Barycenter(m.face[i]);
+        if(fabs(b[axis]-cut[k]) > band) continue;
+        unsigned int ind; ScalarType sqDist;
+        tree.doQueryClosest(b,ind,sqDist);
+        if(sqDist > maxDist*maxDist) continue;
+        const int fi = fb[ind];
+        vote[k][std::make_pair(comp[i-faceStart[0]],comp[fi-faceStart[0]])] += (m.face[i].cN()*m.face[fi].cN() > 0) ? 1 : -1;
+      }
+    }
+
+    std::map<std::pair<int,int>,int> total;
+    for(int k=0;k<cn;++k)
+      for(typename std::map<std::pair<int,int>,int>::iterator vi=vote[k].begin();vi!=vote[k].end();++vi)
+        total[vi->first] += vi->second;
+    std::vector<std::pair<int,std::pair<int,int> > > link;
+    for(typename std::map<std::pair<int,int>,int>::iterator vi=total.begin();vi!=total.end();++vi)
+      if(vi->second!=0) link.push_back(std::make_pair(-abs(vi->second),vi->first));
+    std::sort(link.begin(),link.end());
+    std::vector<int> parent(compNum);
+    std::vector<char> parity(compNum,0);
+    for(int i=0;i<compNum;++i) parent[i]=i;
+    char p0,p1;
+    for(size_t i=0;i<link.size();++i)
+    {
+      const int a = FindParity(parent,parity,link[i].second.first,p0);
+      const int b = FindParity(parent,parity,link[i].second.second,p1);
+      if(a==b) continue;
+      parent[b] = a;
+      parity[b] = p0 ^ p1 ^ char(total[link[i].second]<0);
+    }
+    const int fn = faceStart.back()-faceStart[0];
+    std::vector<int> balance(compNum,0); // faces to flip minus faces to keep for each group
+    std::vector<char> flip(fn);
+    for(int i=0;i<fn;++i)
+      balance[FindParity(parent,parity,comp[i],flip[i])] += flip[i] ? 1 : -1;
+    for(int i=0;i<fn;++i)
+      if(flip[i] != char(balance[FindParity(parent,parity,comp[i],p0)]>0))
+      {
+        FaceType &f = m.face[faceStart[0]+i];
+        std::swap(f.V(1),f.V(2));
+        f.N() = -f.N();
+      }
+  }
+
+  static int NearestCut(const std::vector<ScalarType> &cut, ScalarType c)
+  {
+    int k = int(std::lower_bound(cut.begin(),cut.end(),c)-cut.begin());
+    if(k==int(cut.size()) || (k>0 && c-cut[k-1] < cut[k]-c)) --k;
+    return k;
+  }
 
 
   /* returns the sphere touching p0, p1, p2 of radius r such that
@@ -0,0 +1,247 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_PARALLEL_WALKER
+#define __VCG_PARALLEL_WALKER
+
+#include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <vcg/complex/algorithms/create/mc_trivial_walker.h>
+#include <vcg/complex/append.h>
+
+namespace vcg {
+namespace tri {
+
+/** \brief Slab parallel and incremental Marching Cubes extraction.
+
+The extraction box is split in slabs of cells along the Y axis (the walking direction of TrivialWalker).
+Each slab is polygonized by its own TrivialWalker and MarchingCubes into its own mesh, so slabs are processed
+concurrently. The vertices lying on the plane shared by two consecutive slabs are created by both of them:
+they are identified by the volume edge they come from and merged when the slab meshes are stitched together.
+
+The slab meshes are kept, so that after a change of the volume only the slabs intersecting the changed
+region (see SetDirty()) are polygonized again by Update().
+
+The volume must support concurrent reads (like SimpleVolume); walkers that compute the field
+on the fly with internal caches are not thread safe.
+
+Typical usage:
+\code
+ParallelWalker<MyMesh,MyVolume> walker;
+walker.BuildMesh(mesh, volume, threshold);
+// ... change the voxels inside the box dirtyBox ...
+walker.SetDirty(dirtyBox);
+walker.Update(mesh, volume);
+\endcode
+*/
+template <class MeshType, class VolumeType>
+class ParallelWalker
+{
+public:
+  typedef typename MeshType::VertexPointer VertexPointer;
+  typedef typename MeshType::FaceIterator FaceIterator;
+
+  /// TrivialWalker that also returns the vertices created on the first and on the last Y plane of its box
+  class SlabWalker : public TrivialWalker<MeshType,VolumeType>
+  {
+  public:
+    std::vector<int> firstX,firstZ; // vertex indexes of the X/Z edges of the first plane
+    std::vector<int> lastX,lastZ;   // vertex indexes of the X/Z edges of the last plane
+
+    template<class EXTRACTOR_TYPE>
+    void BuildMesh(MeshType &mesh, VolumeType &volume, EXTRACTOR_TYPE &extractor, const float threshold)
+    {
+      this->_volume = &volume;
+      this->_mesh   = &mesh;
+      this->_mesh->Clear();
+      this->_thr=threshold;
+      this->Begin();
+      extractor.Initialize();
+      const Box3i &bb=this->_bbox;
+      for (int j=bb.min.Y(); j<(bb.max.Y()-1)-1; j+=1)
+      {
+        for (int i=bb.min.X(); i<(bb.max.X()-1)-1; i+=1)
+          for (int k=bb.min.Z(); k<(bb.max.Z()-1)-1; k+=1)
+          {
+            Point3i p1(i,j,k);
+            Point3i p2(i+1,j+1,k+1);
+            if(volume.ValidCell(p1,p2))
+              extractor.ProcessCell(p1, p2);
+          }
+        if(j==bb.min.Y())
+        {
+          firstX.assign(this->_x_cs,this->_x_cs+this->_slice_dimension);
+          firstZ.assign(this->_z_cs,this->_z_cs+this->_slice_dimension);
+        }
+        this->NextYSlice();
+      }
+      lastX.assign(this->_x_cs,this->_x_cs+this->_slice_dimension);
+      lastZ.assign(this->_z_cs,this->_z_cs+this->_slice_dimension);
+      extractor.Finalize();
+      this->_volume = NULL;
+      this->_mesh   = NULL;
+    }
+  };
+  typedef MarchingCubes<MeshType,SlabWalker> SlabMarchingCubes;
+
+  class Slab
+  {
+  public:
+    Slab():dirty(true) {}
+    Box3i box;
+    MeshType mesh;
+    SlabWalker walker;
+    bool dirty;
+  };
+
+  ParallelWalker(int slabCellNum=16) : _slabCellNum(slabCellNum), _volume(NULL), _thr(0)
+  {
+    _bbox.SetNull();
+  }
+
+  ~ParallelWalker()
+  {
+    Clear();
+  }
+
+  /// Set the portion of the volume to be traversed (by default the whole volume)
+  void SetExtractionBox(Box3i subbox)
+  {
+    Clear();
+    _bbox = subbox;
+  }
+
+  /// Polygonize the whole volume in parallel.
+  void BuildMesh(MeshType &mesh, VolumeType &volume, const float threshold, vcg::CallBackPos * cb=0)
+  {
+    if(_bbox.IsNull())
+      _bbox = Box3i(Point3i(0,0,0),volume.ISize());
+    InitSlabs();
+    _volume = &volume;
+    _thr = threshold;
+    Update(mesh,volume,cb);
+  }
+
+  /// Mark as dirty the slabs whose cells use some of the voxels of the given box.
+  void SetDirty(const Box3i &voxelBox)
+  {
+    for(size_t s=0;s<_slab.size();++s)
+    {
+      const Box3i &b=_slab[s]->box;
+      // a slab polygonizes the cells [min.Y, max.Y-2) that use the voxels [min.Y, max.Y-2]
+      if(voxelBox.min.Y() <= b.max.Y()-2 && voxelBox.max.Y() >= b.min.Y())
+        _slab[s]->dirty=true;
+    }
+  }
+
+  /// Polygonize again the dirty slabs (in parallel) and rebuild the mesh.
+  /// BuildMesh() must have been called before, the threshold of that call is used.
+  void Update(MeshType &mesh, VolumeType &volume, vcg::CallBackPos * cb=0)
+  {
+    assert(!_slab.empty());
+    _volume = &volume;
+    const int slabNum=int(_slab.size());
+    if(cb) cb(0,"Marching volume");
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int s=0;s<slabNum;++s)
+      if(_slab[s]->dirty)
+      {
+        Slab &sl=*_slab[s];
+        SlabMarchingCubes mc(sl.mesh,sl.walker);
+        sl.walker.BuildMesh(sl.mesh,volume,mc,_thr);
+        sl.dirty=false;
+      }
+    if(cb) cb(90,"Stitching slabs");
+    Stitch(mesh);
+  }
+
+  void Clear()
+  {
+    for(size_t s=0;s<_slab.size();++s)
+      delete _slab[s];
+    _slab.clear();
+  }
+
+protected:
+  Box3i _bbox;
+  int _slabCellNum;
+  std::vector<Slab *> _slab;
+  VolumeType *_volume;
+  float _thr;
+
+  void InitSlabs()
+  {
+    Clear();
+    // TrivialWalker processes the cells with min.Y <= j < max.Y-2
+    const int cellBegin=_bbox.min.Y();
+    const int cellEnd=_bbox.max.Y()-2;
+    for(int j=cellBegin;j<cellEnd;j+=_slabCellNum)
+    {
+      Slab *sl=new Slab();
+      sl->box=_bbox;
+      sl->box.min.Y()=j;
+      sl->box.max.Y()=std::min(j+_slabCellNum,cellEnd)+2;
+      sl->walker.SetExtractionBox(sl->box);
+      _slab.push_back(sl);
+    }
+  }
+
+  /// Join the slab meshes, merging the vertices created by two slabs on the same edge of their common plane.
+  void Stitch(MeshType &mesh)
+  {
+    mesh.Clear();
+    std::vector<int> offset(_slab.size()+1,0);
+    for(size_t s=0;s<_slab.size();++s)
+    {
+      offset[s+1]=offset[s]+int(_slab[s]->mesh.vert.size());
+      tri::Append<MeshType,MeshType>::Mesh(mesh,_slab[s]->mesh);
+    }
+
+    std::vector<int> remap(mesh.vert.size());
+    for(size_t i=0;i<remap.size();++i) remap[i]=int(i);
+    bool merged=false;
+    for(size_t s=0;s+1<_slab.size();++s)
+    {
+      const SlabWalker &w0=_slab[s]->walker;
+      const SlabWalker &w1=_slab[s+1]->walker;
+      for(size_t i=0;i<w0.lastX.size();++i)
+      {
+        if(w0.lastX[i]!=-1 && w1.firstX[i]!=-1) { remap[offset[s+1]+w1.firstX[i]]=offset[s]+w0.lastX[i]; merged=true; }
+        if(w0.lastZ[i]!=-1 && w1.firstZ[i]!=-1) { remap[offset[s+1]+w1.firstZ[i]]=offset[s]+w0.lastZ[i]; merged=true; }
+      }
+    }
+    if(!merged) return;
+
+    const int fn=int(mesh.face.size());
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j)
+        mesh.face[i].V(j)=&mesh.vert[remap[tri::Index(mesh,mesh.face[i].V(j))]];
+    for(size_t i=0;i<remap.size();++i)
+      if(remap[i]!=int(i))
+        tri::Allocator<MeshType>::DeleteVertex(mesh,mesh.vert[i]);
+    tri::Allocator<MeshType>::CompactVertexVector(mesh);
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCG_PARALLEL_WALKER
@@ -164,6 +164,7 @@ private:
   // SetExtractionBox set the portion of the volume to be traversed
   void SetExtractionBox(Box3i subbox)
     {
+        FreeSlices();
         _bbox = subbox;
         _slice_dimension = _bbox.DimX()*_bbox.DimZ();
 
@@ -178,8 +179,21 @@ private:
     { 
       _bbox.SetNull();
       _slice_dimension=0;
+      _x_cs = _y_cs = _z_cs = _x_ns = _z_ns = NULL;
     }
 
+    ~TrivialWalker()
+    {
+      FreeSlices();
+    }
+
+private:
+    // the slice buffers are owned by the walker, so it cannot be copied
+    TrivialWalker(const TrivialWalker &);
+    TrivialWalker &operator=(const TrivialWalker &);
+
+public:
+
     template<class EXTRACTOR_TYPE>
   void BuildMesh(MeshType &mesh, VolumeType &volume, EXTRACTOR_TYPE &extractor, const float threshold, vcg::CallBackPos * cb=0)
   {
@@ -218,7 +232,7 @@ private:
 
     bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
     {
-        int pos = p0.X()+p0.Z()*_bbox.DimX();
+        int pos = (p0.X()-_bbox.min.X())+(p0.Z()-_bbox.min.Z())*_bbox.DimX();
         int vidx;
 
         if (p0.X()!=p1.X()) // punti allineati lungo l'asse X
@@ -344,6 +358,13 @@ protected:
         _current_slice += 1;
     }
 
+    void FreeSlices()
+    {
+        delete [] _x_cs; delete [] _y_cs; delete [] _z_cs;
+        delete [] _x_ns; delete [] _z_ns;
+        _x_cs = _y_cs = _z_cs = _x_ns = _z_ns = NULL;
+    }
+
     void Begin()
     {
         _current_slice = _bbox.min.Y();
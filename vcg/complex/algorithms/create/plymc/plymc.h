@@ -132,6 +132,7 @@ public:
       SimplificationFlag=false;
       VertSplatFlag=false;
       MergeColor=false;
+      MaxResidentBlocks=0;
       basename = "plymcout";
     }
 
@@ -164,6 +165,7 @@ public:
     bool SimplificationFlag;
     bool VertSplatFlag;
     bool MergeColor;
+    int MaxResidentBlocks; // if >0 the merged volume is kept out of core with at most this many 8^3 blocks in memory
     std::string basename;
     std::vector<std::string> OutNameVec;
     std::vector<std::string> OutNameSimpVec;
@@ -258,8 +260,9 @@ public:
       size_t found =meshname.find_last_of("/\\");
       std::string shortname = meshname.substr(found+1);
 
+      // the volume of a single mesh is always in core, only the merged one can be out of core
       Volume <Voxelf> B;
-      B.Init(VV);
+      B.Init(VV,true);
 
       bool res=false;
       double quality=0;
@@ -282,13 +285,14 @@ public:
             // Classical approach: scan each face
             int tt0=clock();
             printf("---- Face Rasterization");
-            for(SFaceIterator fi=m.face.begin(); fi!=m.face.end();++fi)
+            // faces are binned to the blocks of the volume and the blocks rasterized in parallel
+            std::vector<double> faceQuality(m.face.size());
+            for(size_t i=0;i<m.face.size();++i)
                 {
-                    if(closed || (p.PLYFileQualityFlag==false && p.GeodesicQualityFlag==false)) quality=1.0;
-                    else quality=w*(*fi).Q();
-                    if(quality)
-                            res |= B.ScanFace((*fi).V(0)->P(),(*fi).V(1)->P(),(*fi).V(2)->P(),quality,(*fi).N());
+                    if(closed || (p.PLYFileQualityFlag==false && p.GeodesicQualityFlag==false)) faceQuality[i]=1.0;
+                    else faceQuality[i]=w*m.face[i].Q();
                 }
+            res = B.ScanMeshParallel(m,faceQuality);
             printf(" : %li\n",clock()-tt0);
 
     } else
@@ -318,7 +322,7 @@ public:
         if(p.IntraSmoothFlag)
         {
             Volume <Voxelf> SM;
-            SM.Init(VV);
+            SM.Init(VV,true);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02is",vstp++),p.SliceNum	);
@@ -328,7 +332,7 @@ public:
     if(p.SmoothNum>0)
         {
             Volume <Voxelf> SM;
-            SM.Init(VV);
+            SM.Init(VV,true);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02isf",vstp++),p.SliceNum	);
@@ -391,8 +395,11 @@ bool Process(vcg::CallBackPos *cb=0)
 
           Box3f fullbf; fullbf.Import(fullb);
 
+          VV.MaxResidentBlocks=p.MaxResidentBlocks;
           VV.Init(cells,fullbf,p.IDiv,p.IPos);
           printf("\n\n --------------- Allocated subcells. %i\n",VV.Allocated());
+          if(p.MaxResidentBlocks>0 && p.MaxResidentBlocks<2*VV.asz[0]*VV.asz[2])
+            printf("Warning: less than two layers of blocks (%i) in memory, marching cubes will reload blocks often\n",2*VV.asz[0]*VV.asz[2]);
 
           std::string filename=p.basename;
           if(p.IDiv!=Point3i(1,1,1))
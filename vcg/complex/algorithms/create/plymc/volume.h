@@ -26,6 +26,9 @@
 
 #include "voxel.h"
 #include <vcg/space/index/grid_static_ptr.h>
+#include <atomic>
+#include <cstdio>
+#include <memory>
 
 namespace vcg {
 
@@ -63,7 +66,8 @@ public:
     }
     // I dati veri e propri
     // Sono contenuti in un vettore di blocchi.
-    std::vector<  std::vector<VOX_TYPE>  > rv;
+    // It is mutable because, when the volume is out of core, the blocks are loaded on access (see MaxResidentBlocks)
+    mutable std::vector<  std::vector<VOX_TYPE>  > rv;
     Box3x   bbox;
 
         _int64 AskedCells;
@@ -112,14 +116,18 @@ bool Verbose; // se true stampa un sacco di info in piu su logfp;
          DeltaVoxelSafe=BLOCKSIDE();
          Verbose=true;
          LogFP=stderr;
+         MaxResidentBlocks=0;
         }
 
-    void Init(const Volume &VV)
+    // Init with the same grid and parameters of VV. The out of core limit is copied too, unless inCore is true;
+    // the new volume always gets its own spill file.
+    void Init(const Volume &VV, bool inCore=false)
     {
         SetDefaultParam();
         WN=VV.WN;
         WP=VV.WP;
         DeltaVoxelSafe=VV.DeltaVoxelSafe;
+        if(!inCore) MaxResidentBlocks=VV.MaxResidentBlocks;
     Init(VV.AskedCells,VV.bbox,VV.div,VV.pos);
     }
 
@@ -155,6 +163,7 @@ bool Verbose; // se true stampa un sacco di info in piu su logfp;
         rv.resize(asz[0]*asz[1]*asz[2]);
         for(size_t i=0;i<rv.size();++i)
             rv[i].resize(0,VOX_TYPE::Zero());
+        InitSpill();
         SetDim(bb);
     }
 
@@ -327,6 +336,7 @@ public:
         assert(rpos < int(rv.size()));
         int lx = x%BLOCKSIDE();		int ly = y%BLOCKSIDE();		int lz = z % BLOCKSIDE();
         lpos = lz*BLOCKSIDE()*BLOCKSIDE()+ly*BLOCKSIDE()+lx;
+        if(MaxResidentBlocks>0) return !Block(rpos).empty();
         if(rv[rpos].empty()) return false;
         return true;
      }
@@ -367,8 +377,207 @@ public:
 
     void Alloc(int rpos, const VOX_TYPE &zeroval)
     {
+        if(MaxResidentBlocks>0)
+        {
+          MakeRoom();
+          AddResident(rpos);
+        }
         rv[rpos].resize(BLOCKSIDE()*BLOCKSIDE()*BLOCKSIDE(),zeroval);
     }
+
+    /************************************/
+    // Out of core management.
+    // When MaxResidentBlocks>0 at most that many blocks are kept in memory: the others are spilled to a
+    // temporary file and loaded back when accessed. The file is an anonymous tmpfile() or, if SpillFileName is
+    // not empty, a file named SpillFileName followed by a number unique to the volume, removed when it is closed.
+    // Only the non empty voxels of a block (B() or Cnt()>0) are written, preceded by a bitmask.
+    // The block to be evicted is chosen with the clock (second chance) approximation of LRU; the blocks
+    // touched by the last accesses are never evicted, so references returned by V() stay valid
+    // while a few neighbours are accessed (as done by Expand, Refill and CopySmooth).
+    // All the traversals (VolumeIterator) go block by block, so each block is loaded about once per pass;
+    // marching cubes walks by Y slices, so MaxResidentBlocks should be larger than two layers of
+    // blocks (2*asz[0]*asz[2]) to avoid thrashing.
+    // An out of core volume must not be accessed by many threads at the same time:
+    // the parallel loops of this class run serially in this case.
+    int MaxResidentBlocks;
+    std::string SpillFileName;
+
+    /// Return the block <rpos>, loading it if it has been spilled. It is empty if the block has never been allocated.
+    std::vector<VOX_TYPE> &Block(int rpos) const
+    {
+      if(MaxResidentBlocks==0) return rv[rpos];
+      assert(spillPos.size()==rv.size()); // MaxResidentBlocks must be set before Init()
+      if(rv[rpos].empty() && spillPos[rpos]>=0)
+      {
+        MakeRoom();
+        LoadBlock(rpos);
+        AddResident(rpos);
+      }
+      if(residentIdx[rpos]>=0) refBit[rpos]=1;
+      recent[recentCnt++ % RecentNum]=rpos;
+      return rv[rpos];
+    }
+
+    /// Number of blocks currently kept in memory.
+    int Resident() const
+    {
+      if(MaxResidentBlocks==0) return Allocated();
+      return int(residentVec.size());
+    }
+
+private:
+    enum { RecentNum = 64 };
+    mutable std::shared_ptr<FILE> spillFP;
+    mutable std::vector<_int64> spillPos;  // position of the block in the spill file (-1 if not spilled)
+    mutable std::vector<int> spillCap;     // bytes reserved in the spill file for the block
+    mutable std::vector<int> residentIdx;  // position of the block in residentVec (-1 if not in memory)
+    mutable std::vector<int> residentVec;
+    mutable std::vector<char> refBit;
+    mutable int recent[RecentNum];
+    mutable int recentCnt;
+    mutable size_t clockHand;
+
+    void InitSpill()
+    {
+      spillFP.reset();
+      spillPos.clear(); spillCap.clear(); residentIdx.clear(); residentVec.clear(); refBit.clear();
+      recentCnt=0; clockHand=0;
+      if(MaxResidentBlocks==0) return;
+      MaxResidentBlocks=std::max(MaxResidentBlocks,2*RecentNum);
+      spillPos.resize(rv.size(),-1);
+      spillCap.resize(rv.size(),0);
+      residentIdx.resize(rv.size(),-1);
+      refBit.resize(rv.size(),0);
+      for(int i=0;i<RecentNum;++i) recent[i]=-1;
+      SpillFileCloser closer;
+      if(!SpillFileName.empty())
+      {
+        static std::atomic<int> spillFileCnt(0); // volumes can be initialized from different threads
+        char buf[32];
+        sprintf(buf,"_%05i.tmp",spillFileCnt++);
+        closer.name=SpillFileName+buf;
+      }
+      FILE *fp = closer.name.empty() ? tmpfile() : fopen(closer.name.c_str(),"w+b");
+      if(!fp)
+      {
+        printf("Error: unable to open the spill file for the out of core volume\n");
+        exit(-1);
+      }
+      spillFP.reset(fp,closer);
+    }
+
+    struct SpillFileCloser
+    {
+      std::string name;
+      void operator()(FILE *fp) const
+      {
+        fclose(fp);
+        if(!name.empty()) remove(name.c_str());
+      }
+    };
+
+    static int SpillSeek(FILE *fp, _int64 off, int whence)
+    {
+#ifdef _WIN32
+      return _fseeki64(fp,off,whence);
+#else
+      return fseeko(fp,off_t(off),whence);
+#endif
+    }
+    static _int64 SpillTell(FILE *fp)
+    {
+#ifdef _WIN32
+      return _ftelli64(fp);
+#else
+      return ftello(fp);
+#endif
+    }
+
+    void AddResident(int rpos) const
+    {
+      residentIdx[rpos]=int(residentVec.size());
+      residentVec.push_back(rpos);
+      refBit[rpos]=1;
+    }
+
+    bool IsRecent(int rpos) const
+    {
+      for(int i=0;i<RecentNum;++i)
+        if(recent[i]==rpos) return true;
+      return false;
+    }
+
+    // Evict blocks until there is room for a new one.
+    void MakeRoom() const
+    {
+      while(int(residentVec.size())>=MaxResidentBlocks)
+      {
+        if(clockHand>=residentVec.size()) clockHand=0;
+        int rpos=residentVec[clockHand];
+        if(refBit[rpos] || IsRecent(rpos))
+        {
+          refBit[rpos]=0;
+          ++clockHand;
+          continue;
+        }
+        SpillBlock(rpos);
+        residentVec[clockHand]=residentVec.back();
+        residentIdx[residentVec[clockHand]]=int(clockHand);
+        residentVec.pop_back();
+        residentIdx[rpos]=-1;
+      }
+    }
+
+    void SpillBlock(int rpos) const
+    {
+      const int blockSize=BLOCKSIDE()*BLOCKSIDE()*BLOCKSIDE();
+      std::vector<unsigned char> mask(blockSize/8,0);
+      std::vector<VOX_TYPE> full;
+      for(int i=0;i<blockSize;++i)
+        if(rv[rpos][i].B() || rv[rpos][i].Cnt()>0)
+        {
+          mask[i/8] |= (1<<(i%8));
+          full.push_back(rv[rpos][i]);
+        }
+      std::vector<VOX_TYPE>().swap(rv[rpos]);
+      if(full.empty()) { spillPos[rpos]=-1; return; } // nothing to save, the block goes back to unallocated
+
+      int fullNum=int(full.size());
+      int bytes=int(mask.size()+sizeof(int)+fullNum*sizeof(VOX_TYPE));
+      FILE *fp=spillFP.get();
+      // the slot of the previous spill is reused if large enough and the file is not shared with a copy of this volume
+      if(spillPos[rpos]>=0 && spillCap[rpos]>=bytes && spillFP.use_count()==1)
+        SpillSeek(fp,spillPos[rpos],SEEK_SET);
+      else
+      {
+        SpillSeek(fp,0,SEEK_END);
+        spillPos[rpos]=SpillTell(fp);
+        spillCap[rpos]=bytes;
+      }
+      fwrite(&mask[0],1,mask.size(),fp);
+      fwrite(&fullNum,sizeof(int),1,fp);
+      fwrite(&full[0],sizeof(VOX_TYPE),fullNum,fp);
+    }
+
+    void LoadBlock(int rpos) const
+    {
+      const int blockSize=BLOCKSIDE()*BLOCKSIDE()*BLOCKSIDE();
+      std::vector<unsigned char> mask(blockSize/8,0);
+      int fullNum=0;
+      FILE *fp=spillFP.get();
+      SpillSeek(fp,spillPos[rpos],SEEK_SET);
+      size_t ok = fread(&mask[0],1,mask.size(),fp);
+      ok += fread(&fullNum,sizeof(int),1,fp);
+      std::vector<VOX_TYPE> full(fullNum,VOX_TYPE::Zero());
+      ok += fread(&full[0],sizeof(VOX_TYPE),fullNum,fp);
+      assert(ok==mask.size()+1+size_t(fullNum));
+      rv[rpos].resize(blockSize,VOX_TYPE::Zero());
+      for(int i=0,j=0;i<blockSize;++i)
+        if(mask[i/8] & (1<<(i%8)))
+          rv[rpos][i]=full[j++];
+    }
+
+public:
     /************************************/
     // Funzioni di accesso ai dati
   bool ValidCell(const Point3i &p1, const Point3i &p2) const
@@ -393,20 +602,20 @@ public:
     VOX_TYPE &V(const int &x,const int &y,const int &z) {
         int rpos,lpos;
         if(!Pos(x,y,z,rpos,lpos)) Alloc(rpos,VOX_TYPE::Zero());
-        return rv[rpos][lpos];
+        return Block(rpos)[lpos];
     }
 
     const VOX_TYPE &cV(const int &x,const int &y,const int &z) const
     {
         int rpos,lpos;
         if(!Pos(x,y,z,rpos,lpos)) return VOX_TYPE::Zero();
-        else return rv[rpos][lpos];
+        else return Block(rpos)[lpos];
     }
     const VOX_TYPE &V(const int &x,const int &y,const int &z) const
     {
         int rpos,lpos;
         if(!Pos(x,y,z,rpos,lpos)) return VOX_TYPE::Zero();
-        else return rv[rpos][lpos];
+        else return Block(rpos)[lpos];
     }
     /************************************/
     void Fill(VOX_TYPE (__cdecl *func)(const Point3i &p) )
@@ -503,7 +712,7 @@ void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
     {
         if((*svi).Cnt()>0)
         {
-            VOX_TYPE &sv=S.rv[svi.rpos][svi.lpos];
+            VOX_TYPE &sv=S.Block(svi.rpos)[svi.lpos];
             (*svi).Normalize(1); // contiene il valore mediato
             float SafeThr = fabs(sv.V());
 
@@ -538,6 +747,32 @@ void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
 
 void Merge(Volume<VOX_TYPE> &S)
 {
+ // Volumes initialized with the same parameters share the block layout: blocks are merged independently.
+ if(S.asz==asz && S.SubPartSafe.min==SubPartSafe.min && S.rv.size()==rv.size())
+ {
+   const int blockNum=int(rv.size());
+   const int blockSize=BLOCKSIDE()*BLOCKSIDE()*BLOCKSIDE();
+   int loccnt=0;
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:loccnt) if(MaxResidentBlocks==0 && S.MaxResidentBlocks==0)
+   for(int rpos=0;rpos<blockNum;++rpos)
+     if(!S.Block(rpos).empty())
+       for(int lpos=0;lpos<blockSize;++lpos)
+       {
+         const VOX_TYPE &sv=S.Block(rpos)[lpos];
+         if(!sv.B()) continue;
+         if(Block(rpos).empty()) Alloc(rpos,VOX_TYPE::Zero());
+         VOX_TYPE &dv=Block(rpos)[lpos];
+         if(dv.B()) dv.Merge(sv);
+         else {
+           dv.Set(sv);
+           dv.SetB(true);
+         }
+         ++loccnt;
+       }
+   printf("Merge2 %i voxels\n",loccnt);
+   return;
+ }
+
  VolumeIterator< Volume > svi(S);
  svi.Restart();
  svi.FirstNotEmpty();
@@ -727,6 +962,14 @@ return true;
 // assume che i punti della faccia in ingresso siano stati interized
 bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
                        double quality, const Point3x & nn)//, const int name )	// OK
+{
+  return ScanFace(v0,v1,v2,quality,nn,SubPartSafe);
+}
+
+// Same of the above but only the voxels inside the <clip> box (that must be contained in SubPartSafe) are written.
+// Used to rasterize the same face on different blocks from different threads.
+bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
+                       double quality, const Point3x & nn, const Box3i &clip)
 {
     const scalar EPS     = scalar(1e-12);
 //	const scalar EPS_INT = scalar(1e-20);
@@ -783,9 +1026,9 @@ bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
 
 
     // Clamping dei valori di rasterizzazione al subbox corrente
-    sx = std::max(SubPartSafe.min[0],sx); ex = std::min(SubPartSafe.max[0]-1,ex);
-    sy = std::max(SubPartSafe.min[1],sy); ey = std::min(SubPartSafe.max[1]-1,ey);
-    sz = std::max(SubPartSafe.min[2],sz); ez = std::min(SubPartSafe.max[2]-1,ez);
+    sx = std::max(clip.min[0],sx); ex = std::min(clip.max[0]-1,ex);
+    sy = std::max(clip.min[1],sy); ey = std::min(clip.max[1]-1,ey);
+    sz = std::max(clip.min[2],sz); ez = std::min(clip.max[2]-1,ez);
 
         // Rasterizzazione xy
 
@@ -802,7 +1045,7 @@ bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
             {
                 double iz = ( dist - double(x)*norm[0] - double(y)*norm[1] ) / norm[2];
                 //assert(iz>=fbox.min[2] && iz<=fbox.max[2]);
-                AddXYInt(x,y,iz,-norm[2], quality, nn );
+                AddXYInt(x,y,iz,-norm[2], quality, nn, clip);
             }
         }
 
@@ -821,7 +1064,7 @@ bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
             {
                 double iy = ( dist - double(x)*norm[0] - double(z)*norm[2] ) / norm[1];
                 //assert(iy>=fbox.min[1] && iy<=fbox.max[1]);
-                AddXZInt(x,z,iy,-norm[1], quality,nn  );
+                AddXZInt(x,z,iy,-norm[1], quality,nn, clip);
             }
         }
 
@@ -840,20 +1083,103 @@ bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
             {
                 double ix = ( dist - double(y)*norm[1] - double(z)*norm[2] ) / norm[0];
                 //assert(ix>=fbox.min[0] && ix<=fbox.max[0]);
-                AddYZInt(y,z,ix,-norm[0], quality, nn );
+                AddYZInt(y,z,ix,-norm[0], quality, nn, clip);
             }
         }
         return true;
 }
+/*
+ * Block parallel rasterization of all the faces of a (compact) mesh whose vertices have been interized.
+ * Each face is binned to the BLOCKSIDE()^3 blocks it could write into; then the blocks are processed concurrently,
+ * each one by a single thread that scans its own faces, clipped to the block, in the original order.
+ * Every voxel receives the same sequence of updates of the serial scan, so the result is identical
+ * to calling ScanFace(...,quality[i],N()) on each face (faces with zero quality are skipped).
+ */
+template <class MeshType>
+bool ScanMeshParallel(MeshType &m, const std::vector<double> &quality)
+{
+  assert(quality.size()==m.face.size());
+  const int fn=int(m.face.size());
+  const int bs=BLOCKSIDE();
+  const int pad=std::max(-WN,WP)+1; // how far from the face bbox an intercept can write
+
+  // 1) range of blocks touched by each face
+  std::vector<Box3i> fb(fn);
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<fn;++i)
+  {
+    fb[i].SetNull();
+    if(m.face[i].IsD() || quality[i]==0) continue;
+    Box3x fbox;
+    fbox.Set(m.face[i].V(0)->P());
+    fbox.Add(m.face[i].V(1)->P());
+    fbox.Add(m.face[i].V(2)->P());
+    Box3i rb;
+    for(int k=0;k<3;++k)
+    {
+      int lo = std::max(int(floor(fbox.min[k]))-pad, SubPartSafe.min[k]);
+      int hi = std::min(int(floor(fbox.max[k]))+pad, SubPartSafe.max[k]-1);
+      if(lo>hi) break;
+      rb.min[k]=(lo-SubPartSafe.min[k])/bs;
+      rb.max[k]=(hi-SubPartSafe.min[k])/bs;
+      if(k==2) fb[i]=rb;
+    }
+  }
+
+  // 2) per block lists of faces (CSR) preserving the face order
+  std::vector<int> start(rv.size()+1,0);
+  for(int i=0;i<fn;++i) if(!fb[i].IsNull())
+    for(int rz=fb[i].min[2];rz<=fb[i].max[2];++rz)
+      for(int ry=fb[i].min[1];ry<=fb[i].max[1];++ry)
+        for(int rx=fb[i].min[0];rx<=fb[i].max[0];++rx)
+          start[rz*asz[0]*asz[1]+ry*asz[0]+rx+1]++;
+  std::vector<int> blockVec;
+  for(size_t b=0;b<rv.size();++b)
+  {
+    if(start[b+1]>0) blockVec.push_back(int(b));
+    start[b+1]+=start[b];
+  }
+  std::vector<int> faceList(start.back());
+  std::vector<int> fill(start.begin(),start.end()-1);
+  for(int i=0;i<fn;++i) if(!fb[i].IsNull())
+    for(int rz=fb[i].min[2];rz<=fb[i].max[2];++rz)
+      for(int ry=fb[i].min[1];ry<=fb[i].max[1];++ry)
+        for(int rx=fb[i].min[0];rx<=fb[i].max[0];++rx)
+          faceList[fill[rz*asz[0]*asz[1]+ry*asz[0]+rx]++]=i;
+
+  // 3) rasterization; each thread allocates and writes only the voxels of its own block.
+  //    Out of core volumes are scanned serially, still block by block.
+  const int blockNum=int(blockVec.size());
+  int scanned=0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:scanned) if(MaxResidentBlocks==0)
+  for(int bi=0;bi<blockNum;++bi)
+  {
+    const int rpos=blockVec[bi];
+    Point3i r(rpos%asz[0], (rpos/asz[0])%asz[1], rpos/(asz[0]*asz[1]));
+    Box3i clip;
+    clip.min=SubPartSafe.min+r*bs;
+    clip.max=Point3i(std::min(clip.min[0]+bs,SubPartSafe.max[0]),
+                     std::min(clip.min[1]+bs,SubPartSafe.max[1]),
+                     std::min(clip.min[2]+bs,SubPartSafe.max[2]));
+    for(int j=start[rpos];j<start[rpos+1];++j)
+    {
+      const typename MeshType::FaceType &f=m.face[faceList[j]];
+      if(ScanFace(f.cV(0)->cP(),f.cV(1)->cP(),f.cV(2)->cP(),quality[faceList[j]],f.cN(),clip))
+        ++scanned;
+    }
+  }
+  return scanned>0;
+}
+
 // Si sa che la faccia ha una intercetta sull'asse z-dir di coord xy alla posizione z;
 // quindi si setta nei 2 vertici prima e 2 dopo la distanza corrispondente.
 
-void AddXYInt( const int x, const int y, const double z, const double sgn, const double q, const Point3f &n )
+void AddXYInt( const int x, const int y, const double z, const double sgn, const double q, const Point3f &n, const Box3i &clip)
 { double esgn = (sgn<0 ? -1 : 1);//*max(fabs(sgn),0.001);
     double dist=z-floor(z);  // sempre positivo e compreso tra zero e uno
     int  zint = floor(z);
     for(int k=WN;k<=WP;k++)
-        if(zint+k >= SubPartSafe.min[2] && zint+k < SubPartSafe.max[2])
+        if(zint+k >= clip.min[2] && zint+k < clip.max[2])
         {
             VOX_TYPE &VV=V(x,y,zint+k);
             double nvv= esgn*( k-dist);
@@ -862,12 +1188,12 @@ void AddXYInt( const int x, const int y, const double z, const double sgn, const
             }
         }
 }
-void AddYZInt( const int y, const int z, const double x, const double sgn, const double q, const Point3f &n  )
+void AddYZInt( const int y, const int z, const double x, const double sgn, const double q, const Point3f &n, const Box3i &clip)
 { double esgn = (sgn<0 ? -1 : 1);//*max(fabs(sgn),0.001);
     double dist=x-floor(x);  // sempre positivo e compreso tra zero e uno
     int  xint = int(floor(x));
     for(int k=WN;k<=WP;k++)
-        if(xint+k >= SubPartSafe.min[0] && xint+k < SubPartSafe.max[0])
+        if(xint+k >= clip.min[0] && xint+k < clip.max[0])
         {
             VOX_TYPE &VV=V(xint+k,y,z);
             double nvv= esgn*( k-dist);
@@ -876,12 +1202,12 @@ void AddYZInt( const int y, const int z, const double x, const double sgn, const
             }
         }
 }
-void AddXZInt( const int x, const int z, const double y, const double sgn, const double q, const Point3f &n  )
+void AddXZInt( const int x, const int z, const double y, const double sgn, const double q, const Point3f &n, const Box3i &clip)
 { double esgn = (sgn<0 ? -1 : 1);//*max(fabs(sgn),0.001);
     double dist=y-scalar(floor(y));  // sempre positivo e compreso tra zero e uno
     int  yint = floor(y);
     for(int k=WN;k<=WP;k++)
-        if(yint+k >= SubPartSafe.min[1] && yint+k < SubPartSafe.max[1])
+        if(yint+k >= clip.min[1] && yint+k < clip.max[1])
         {
             VOX_TYPE &VV=V(x,yint+k,z);
             double nvv= esgn*( k-dist);
@@ -914,10 +1240,10 @@ void AddXZInt( const int x, const int z, const double y, const double sgn, const
      fprintf(fp,"\n");
  }
 
-    int Allocated()
+    int Allocated() const
     {int cnt=0;
         for(size_t i=0;i<rv.size();++i)
-            if(!rv[i].empty()) cnt++;
+            if(!rv[i].empty() || (MaxResidentBlocks>0 && spillPos[i]>=0)) cnt++;
             return cnt;
     }
 
@@ -1286,37 +1612,37 @@ class VolumeIterator
     {
 
         //Dump();
-        typename std::vector<std::vector<typename VOL::voxel_type> >::iterator rvi=V.rv.begin()+rpos;
+        // blocks are accessed through Block() so that spilled blocks of out of core volumes are loaded
+        const int rnum=int(V.rv.size());
         do
         {
-            if((*rvi).empty())
+            if(V.Block(rpos).empty())
             {
-                while(rvi!=V.rv.end() && (*rvi).empty()) ++rvi;
-                if(rvi==V.rv.end())
+                while(rpos<rnum && V.Block(rpos).empty()) ++rpos;
+                if(rpos==rnum)
                 {
                     rpos=-1;
                     return false;
                 }
-                rpos= rvi-V.rv.begin();
                 lpos=0;
             }
-            typename std::vector<typename VOL::voxel_type>::iterator lvi= (*rvi).begin()+lpos;
+            std::vector<typename VOL::voxel_type> &rb=V.Block(rpos);
+            typename std::vector<typename VOL::voxel_type>::iterator lvi= rb.begin()+lpos;
             // un voxel e' non vuoto se ha b!=0;
-            while(lvi!=(*rvi).end() && !((*lvi).B() || (*lvi).Cnt()>0)) {
+            while(lvi!=rb.end() && !((*lvi).B() || (*lvi).Cnt()>0)) {
                 ++lvi;
             }
-            if(lvi!=(*rvi).end())
+            if(lvi!=rb.end())
             {
-                lpos= lvi-(*rvi).begin();
+                lpos= lvi-rb.begin();
                 //V.IPos(p[0],p[1],p[2],rpos,lpos);
                 //Dump();
                 return true;
             }
             else lpos=0;
-            ++rvi;
-            rpos= rvi-V.rv.begin();
+            ++rpos;
 
-        } while (rvi!=V.rv.end());
+        } while (rpos<rnum);
         rpos=-1;
         return false;
     }
@@ -1324,7 +1650,7 @@ class VolumeIterator
     typename VOL::voxel_type &operator *()
         {
           assert(rpos>=0 && lpos >=0);
-            return V.rv[rpos][lpos];
+            return V.Block(rpos)[lpos];
         }
     bool Next()
     {
@@ -61,6 +61,48 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
   typedef typename OldMeshType::FaceType OldFaceType;
   typedef typename OldMeshType::ScalarType OldScalarType;
 
+  class Walker;
+
+  /** Distance field sampled on the nodes of the grid, stored only in the narrow band around the surface.
+    The nodes are grouped in bricks of BrickSide^3; only the bricks with at least one node in the band
+    are allocated, the other nodes have no value.
+  */
+  class SparseField
+  {
+  public:
+    typedef typename  std::pair<bool,float> field_value;
+    enum { BrickSide = 8, BrickVol = BrickSide*BrickSide*BrickSide };
+
+    /// Remove all the bricks and set the number of nodes per side.
+    void Init(const Point3i &nodeNum)
+    {
+      nsz=nodeNum;
+      bsz=(nodeNum+Point3i(BrickSide-1,BrickSide-1,BrickSide-1))/int(BrickSide);
+      brickIdx.assign(size_t(bsz[0])*bsz[1]*bsz[2],-1);
+      data.clear();
+    }
+
+    const Point3i &NodeNum() const { return nsz; }
+    int BrickNum() const { return int(data.size()/BrickVol); }
+
+    field_value Get(int i,int j,int k) const
+    {
+      const int b=brickIdx[BrickIndex(i/BrickSide,j/BrickSide,k/BrickSide)];
+      if(b<0) return field_value(false,0);
+      return data[size_t(b)*BrickVol+NodeIndex(i%BrickSide,j%BrickSide,k%BrickSide)];
+    }
+
+  protected:
+    friend class Walker;
+    Point3i nsz;                    // nodes per side
+    Point3i bsz;                    // bricks per side
+    std::vector<int> brickIdx;      // position of each brick in data (-1 if not allocated)
+    std::vector<field_value> data;  // the values of the allocated bricks, BrickVol each
+
+    int BrickIndex(int bi,int bj,int bk) const { return (bj*bsz[2]+bk)*bsz[0]+bi; }
+    static int NodeIndex(int li,int lj,int lk) { return (lj*BrickSide+lk)*BrickSide+li; }
+  };
+
   class Walker : BasicGrid<typename NewMeshType::ScalarType>
   {
   private:
@@ -90,6 +132,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     NewMeshType	*_newM;
     OldMeshType	*_oldM;
     GridType _g;
+    const SparseField *_field; // if not null the values are read from this precomputed field
 
   public:
     NewScalarType max_dim; // the limit value of the search (that takes into account of the offset)
@@ -118,11 +161,28 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
 
       _v_cs= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
       _v_ns= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
-
+      _field=NULL;
     };
 
     ~Walker()
-    {}
+    {
+      delete [] _x_cs; delete [] _y_cs; delete [] _z_cs;
+      delete [] _x_ns; delete [] _z_ns;
+      delete [] _v_cs; delete [] _v_ns;
+    }
+
+  private:
+    // the slice buffers are owned by the walker, so it cannot be copied
+    Walker(const Walker &);
+    Walker &operator=(const Walker &);
+
+  public:
+    /// Use a field computed by ComputeField() instead of computing the distances during the extraction.
+    void SetField(const SparseField *field)
+    {
+      assert(field==NULL || field->NodeNum()==this->siz+Point3i(1,1,1));
+      _field=field;
+    }
 
 
     NewScalarType V(const Point3i &p)
@@ -152,6 +212,13 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     }
     ///return true if the distance form the mesh is less than maxdim and return distance
     field_value DistanceFromMesh(OldCoordType &pp)
+    {
+      return DistanceFromMesh(pp,markerFunctor);
+    }
+
+    /// Same as above, using the given marker for the grid query (e.g. a FaceLocalTmark for each thread).
+    template <class MARKER>
+    field_value DistanceFromMesh(OldCoordType &pp, MARKER &marker)
     {
       OldScalarType dist;
       const NewScalarType max_dist = max_dim;
@@ -160,7 +227,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
 
       OldCoordType closestPt;
       DISTFUNCTOR PDistFunct;
-      OldFaceType *f = _g.GetClosest(PDistFunct,markerFunctor,testPt,max_dist,dist,closestPt);
+      OldFaceType *f = _g.GetClosest(PDistFunct,marker,testPt,max_dist,dist,closestPt);
       if (f==NULL) return field_value(false,0);
       if(AbsDistFlag) return field_value(true,dist);
       assert(!f->IsD());
@@ -204,6 +271,12 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     }
 
     field_value MultiDistanceFromMesh(OldCoordType &pp)
+    {
+      return MultiDistanceFromMesh(pp,markerFunctor);
+    }
+
+    template <class MARKER>
+    field_value MultiDistanceFromMesh(OldCoordType &pp, MARKER &marker)
     {
       float distSum=0;
       int positiveCnt=0; // positive results counter
@@ -219,7 +292,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
       for(int qq=0;qq<MultiSample;++qq)
       {
         OldCoordType pp2=pp+delta[qq];
-        field_value ff= DistanceFromMesh(pp2);
+        field_value ff= DistanceFromMesh(pp2,marker);
         if(ff.first==false) return field_value(false,0);
         distSum += fabs(ff.second);
         if(ff.second>0) positiveCnt ++;
@@ -232,6 +305,16 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     /// the distance of the bb
     void ComputeSliceValues(int slice,field_value *slice_values)
     {
+      if(_field)
+      {
+        if(slice<=this->siz.Y())
+          for (int i=0; i<=this->siz.X(); i++)
+            for (int k=0; k<=this->siz.Z(); k++)
+              slice_values[GetSliceIndex(i,k)]=_field->Get(i,slice,k);
+        else
+          std::fill(slice_values,slice_values+SliceSize,field_value(false,0));
+        return;
+      }
       for (int i=0; i<=this->siz.X(); i++)
       {
         for (int k=0; k<=this->siz.Z(); k++)
@@ -318,10 +401,9 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     }
 
 
-    template<class EXTRACTOR_TYPE>
-    void BuildMesh(OldMeshType &old_mesh,NewMeshType &new_mesh,EXTRACTOR_TYPE &extractor,vcg::CallBackPos *cb)
+    /// Prepare the mesh and the search grid used to compute the distances.
+    void Init(OldMeshType &old_mesh)
     {
-      _newM=&new_mesh;
       _oldM=&old_mesh;
 
       // the following two steps are required to be sure that the point-face distance without precomputed data works well.
@@ -331,7 +413,115 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
 
       _g.Set(_oldM->face.begin(),_oldM->face.end(),_size);
       markerFunctor.SetMesh(&old_mesh);
+    }
+
+    /** Compute in parallel the field on the nodes of the grid near the surface (Init() must have been called).
+      Only the nodes inside the narrow band (the bbox of a face enlarged by max_dim) are queried and stored:
+      the other ones are farther than max_dim from the surface and get no value, as in ComputeSliceValues.
+      The bricks of the field are processed concurrently, each one with its own marker for the grid queries.
+    */
+    void ComputeField(SparseField &field, vcg::CallBackPos *cb=0)
+    {
+      const int BS=SparseField::BrickSide;
+      field.Init(this->siz+Point3i(1,1,1));
+
+      // integer box of the nodes that can be closer than max_dim to each face
+      // (one more node on each side to account for the multi sample displacements)
+      const int fn=int(_oldM->face.size());
+      std::vector<Box3i> faceBox(fn);
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<fn;++i)
+      {
+        faceBox[i].SetNull();
+        const OldFaceType &f=_oldM->face[i];
+        if(f.IsD()) continue;
+        Box3<OldScalarType> fb;
+        fb.Set(f.cP(0)); fb.Add(f.cP(1)); fb.Add(f.cP(2));
+        fb.Offset(max_dim);
+        Box3i ib;
+        for(int k=0;k<3;++k)
+        {
+          ib.min[k]=std::max(0,           int(floor((fb.min[k]-this->bbox.min[k])/this->voxel[k]))-1);
+          ib.max[k]=std::min(this->siz[k],int(ceil ((fb.max[k]-this->bbox.min[k])/this->voxel[k]))+1);
+        }
+        if(!ib.IsNull()) faceBox[i]=ib;
+      }
 
+      // count the faces whose band spans each brick (in brickIdx, that is later replaced by the brick position),
+      // allocate the spanned bricks and list their faces
+      std::vector<int> &brickIdx=field.brickIdx;
+      for(int i=0;i<fn;++i) if(!faceBox[i].IsNull())
+      {
+        const Box3i &ib=faceBox[i];
+        for(int bj=ib.min[1]/BS;bj<=ib.max[1]/BS;++bj)
+          for(int bk=ib.min[2]/BS;bk<=ib.max[2]/BS;++bk)
+            for(int bi=ib.min[0]/BS;bi<=ib.max[0]/BS;++bi)
+              brickIdx[field.BrickIndex(bi,bj,bk)]--;
+      }
+      std::vector<int> brickPos; // index in brickIdx of each allocated brick
+      std::vector<int> start(1,0);
+      for(size_t b=0;b<brickIdx.size();++b)
+        if(brickIdx[b]<-1)
+        {
+          start.push_back(start.back()-1-brickIdx[b]);
+          brickIdx[b]=int(brickPos.size());
+          brickPos.push_back(int(b));
+        }
+      const int brickNum=int(brickPos.size());
+      std::vector<int> brickFace(start.back());
+      std::vector<int> fill(start.begin(),start.end()-1);
+      for(int i=0;i<fn;++i) if(!faceBox[i].IsNull())
+      {
+        const Box3i &ib=faceBox[i];
+        for(int bj=ib.min[1]/BS;bj<=ib.max[1]/BS;++bj)
+          for(int bk=ib.min[2]/BS;bk<=ib.max[2]/BS;++bk)
+            for(int bi=ib.min[0]/BS;bi<=ib.max[0]/BS;++bi)
+              brickFace[fill[brickIdx[field.BrickIndex(bi,bj,bk)]]++]=i;
+      }
+      field.data.assign(size_t(brickNum)*SparseField::BrickVol,field_value(false,0));
+
+      if(cb) cb(0,"Computing distance field");
+#pragma omp parallel for schedule(dynamic, 1)
+      for(int b=0;b<brickNum;++b)
+      {
+        const int bi=brickPos[b]%field.bsz[0];
+        const int bk=(brickPos[b]/field.bsz[0])%field.bsz[2];
+        const int bj=brickPos[b]/(field.bsz[0]*field.bsz[2]);
+        const Point3i o(bi*BS,bj*BS,bk*BS);
+        std::vector<char> band(SparseField::BrickVol,0);
+        for(int t=start[b];t<start[b+1];++t)
+        {
+          const Box3i &ib=faceBox[brickFace[t]];
+          for(int j=std::max(ib.min[1],o[1]);j<=std::min(ib.max[1],o[1]+BS-1);++j)
+            for(int k=std::max(ib.min[2],o[2]);k<=std::min(ib.max[2],o[2]+BS-1);++k)
+              for(int i=std::max(ib.min[0],o[0]);i<=std::min(ib.max[0],o[0]+BS-1);++i)
+                band[SparseField::NodeIndex(i-o[0],j-o[1],k-o[2])]=1;
+        }
+        tri::FaceLocalTmark<OldMeshType> marker;
+        field_value *brick_values=&field.data[size_t(b)*SparseField::BrickVol];
+        for(int n=0;n<SparseField::BrickVol;++n)
+        {
+          if(!band[n]) continue;
+          OldCoordType pp(o[0]+n%BS,o[1]+n/(BS*BS),o[2]+(n/BS)%BS);
+          if(this->MultiSampleFlag) brick_values[n] = MultiDistanceFromMesh(pp,marker);
+          else	brick_values[n] = DistanceFromMesh(pp,marker);
+        }
+      }
+      if(cb) cb(100,"Computing distance field");
+    }
+
+    template<class EXTRACTOR_TYPE>
+    void BuildMesh(OldMeshType &old_mesh,NewMeshType &new_mesh,EXTRACTOR_TYPE &extractor,vcg::CallBackPos *cb)
+    {
+      Init(old_mesh);
+      BuildMesh(new_mesh,extractor,cb);
+    }
+
+    /// Extract the surface from the field set with SetField() (or computing it slice by slice if Init() has been called)
+    template<class EXTRACTOR_TYPE>
+    void BuildMesh(NewMeshType &new_mesh,EXTRACTOR_TYPE &extractor,vcg::CallBackPos *cb)
+    {
+      _newM=&new_mesh;
       _newM->Clear();
 
       Begin();
@@ -614,6 +804,43 @@ public:
     walker.BuildMesh(old_mesh,new_mesh,mc,cb);
   }
 
+  /// Distance field sampled on the nodes of the grid (a node has no value if farther than max_dist from the mesh).
+  /// Only the bricks of nodes near the surface are stored, so its size grows with the area of the mesh, not with the volume.
+  typedef SparseField FieldType;
+
+  /// Compute in parallel the signed distance field of old_mesh up to max_dist, over the same grid used by Resample.
+  /// The field can be used to extract many iso-surfaces with ResampleField() (offsets up to max_dist in absolute value).
+  static void ComputeDistanceField(OldMeshType &old_mesh, FieldType &field, NewBoxType volumeBox, vcg::Point3<int> accuracy, float max_dist, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0 )
+  {
+    vcg::tri::UpdateBounding<OldMeshType>::Box(old_mesh);
+
+    MyWalker	walker(volumeBox,accuracy);
+    walker.max_dim=max_dist;
+    walker.MultiSampleFlag = MultiSampleFlag;
+    walker.AbsDistFlag = AbsDistFlag;
+    walker.Init(old_mesh);
+    walker.ComputeField(field,cb);
+  }
+
+  /// Extract the iso-surface at value thr of a field computed by ComputeDistanceField() with the same volumeBox and accuracy.
+  static void ResampleField(const FieldType &field, NewMeshType &new_mesh, NewBoxType volumeBox, vcg::Point3<int> accuracy, float thr=0, bool DiscretizeFlag=false, vcg::CallBackPos *cb=0 )
+  {
+    MyWalker	walker(volumeBox,accuracy);
+    walker.offset = - thr;
+    walker.DiscretizeFlag = DiscretizeFlag;
+    walker.SetField(&field);
+    MyMarchingCubes mc(new_mesh, walker);
+    walker.BuildMesh(new_mesh,mc,cb);
+  }
+
+  /// Same as Resample but the distance field is computed in parallel before the extraction.
+  static void ResampleParallel(OldMeshType &old_mesh, NewMeshType &new_mesh,  NewBoxType volumeBox, vcg::Point3<int> accuracy,float max_dist, float thr=0, bool DiscretizeFlag=false, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0 )
+  {
+    FieldType field;
+    ComputeDistanceField(old_mesh,field,volumeBox,accuracy,max_dist+fabs(thr),MultiSampleFlag,AbsDistFlag,cb);
+    ResampleField(field,new_mesh,volumeBox,accuracy,thr,DiscretizeFlag,cb);
+  }
+
 
 };//end class resampler
 
@@ -648,6 +648,370 @@ It is just a simple wrapper of the basic Compute()
 
 
 };// end class
+
+/*! \brief Parallel multi-source geodesic distance with a reusable workspace.
+
+It computes the same approximated geodesic distance of Geodesic::Visit() (the same DistanceFunctor and the same
+triangle based update) using a bucketed label correcting wavefront (delta stepping): all the vertices whose tentative
+distance falls in the current bucket [dmin, dmin+Delta) are relaxed together, repeatedly, until no one of them changes.
+Each relaxation round pulls the new distance of every candidate vertex from its neighbors, so the rounds run in parallel
+without write conflicts and the result does not depend on the number of threads. It is not the same of the serial
+Visit(), that processes the vertices in a different order: the two differ by a fraction of the edge length (less than
+half the average edge length on a sphere, see apps/test/geodesic), that is smaller than the approximation error of both.
+
+The vertex-vertex adjacency and all the per vertex arrays are built once in Init() and reused by the following calls,
+so it is meant to be kept alive when the distance has to be computed many times on the same mesh (e.g. Voronoi relaxation).
+Init() must be called again if the mesh changes. It does not need VF adjacency.
+When only a few seeds change between two calls, Update() recomputes just the regions around the changed seeds.
+
+\code
+ParallelGeodesic<MyMesh> pg(m);
+pg.Compute(seedVec,df,maxDist,0,&sources);   // distance stored in the vertex quality
+// ... move some seeds ...
+pg.Update(seedVec,df,&sources);
+\endcode
+*/
+template <class MeshType>
+class ParallelGeodesic
+{
+public:
+  typedef typename MeshType::VertexType VertexType;
+  typedef typename MeshType::VertexPointer VertexPointer;
+  typedef typename MeshType::FaceIterator FaceIterator;
+  typedef typename MeshType::ScalarType  ScalarType;
+  typedef typename Geodesic<MeshType>::VertDist VertDist;
+  typedef typename MeshType::template PerVertexAttributeHandle<VertexPointer> VertexHandle;
+
+  /// Width of the buckets; zero means twice the average edge length (set by Init()).
+  ScalarType Delta;
+
+  ParallelGeodesic(MeshType &m) : Delta(0), _m(m) { Init(); }
+
+  /// Build the adjacency and allocate the workspace.
+  void Init()
+  {
+    const int vn=int(_m.vert.size());
+    _vertNum=vn;
+    _faceNum=_m.face.size();
+    _start.assign(vn+1,0);
+    for(FaceIterator fi=_m.face.begin();fi!=_m.face.end();++fi) if(!(*fi).IsD())
+      for(int j=0;j<3;++j) _start[tri::Index(_m,(*fi).V(j))+1]+=2;
+    for(int i=0;i<vn;++i) _start[i+1]+=_start[i];
+    _curr.resize(_start[vn]);
+    _opp.resize(_start[vn]);
+    std::vector<int> pos(_start.begin(),_start.end()-1);
+    double edgeSum=0; int edgeCnt=0;
+    for(FaceIterator fi=_m.face.begin();fi!=_m.face.end();++fi) if(!(*fi).IsD())
+      for(int j=0;j<3;++j)
+      {
+        const int v=tri::Index(_m,(*fi).V0(j));
+        const int v1=tri::Index(_m,(*fi).V1(j));
+        const int v2=tri::Index(_m,(*fi).V2(j));
+        _curr[pos[v]]=v1; _opp[pos[v]++]=v2;
+        _curr[pos[v]]=v2; _opp[pos[v]++]=v1;
+        edgeSum+=Distance((*fi).cP0(j),(*fi).cP1(j)); ++edgeCnt;
+      }
+    _autoDelta=(edgeCnt>0) ? ScalarType(2.0*edgeSum/edgeCnt) : ScalarType(1);
+    _d.resize(vn);
+    _src.resize(vn);
+    _par.resize(vn);
+    _settled.resize(vn);
+    _inOpen.resize(vn);
+    _inCand.assign(vn,0);
+    _isSeed.assign(vn,0);
+    _clear.resize(vn);
+    _ready=false;
+  }
+
+  /// Distances computed by the last call, indexed as the vertex vector.
+  const std::vector<ScalarType> &Dist() const { return _d; }
+
+  bool Compute(const std::vector<VertexPointer> &seedVec)
+  {
+    EuclideanDistance<MeshType> dd;
+    return Compute(seedVec,dd);
+  }
+
+  /// Same parameters of Geodesic::Compute().
+  template <class DistanceFunctor>
+  bool Compute(const std::vector<VertexPointer> &seedVec,
+               DistanceFunctor &distFunc,
+               ScalarType maxDistanceThr  = std::numeric_limits<ScalarType>::max(),
+               std::vector<VertexPointer> *withinDistanceVec=NULL,
+               VertexHandle *sourceSeed = NULL,
+               VertexHandle *parentSeed = NULL)
+  {
+    if(seedVec.empty()) return false;
+    std::vector<VertDist> vdSeedVec;
+    for(size_t i=0;i<seedVec.size();++i)
+      vdSeedVec.push_back(VertDist(seedVec[i],0.0));
+    Visit(vdSeedVec, distFunc, maxDistanceThr, sourceSeed, parentSeed, withinDistanceVec);
+    return true;
+  }
+
+  /// Same parameters and result of Geodesic::Visit(): the distance is stored in the vertex quality
+  /// and the farthest reached vertex is returned.
+  template <class DistanceFunctor>
+  VertexPointer Visit(std::vector<VertDist> &seedVec,
+                      DistanceFunctor &distFunc,
+                      ScalarType distance_threshold = std::numeric_limits<ScalarType>::max(),
+                      VertexHandle *vertSource = NULL,
+                      VertexHandle *vertParent = NULL,
+                      std::vector<VertexPointer> *InInterval=NULL)
+  {
+    tri::RequirePerVertexQuality(_m);
+    assert(!seedVec.empty());
+    if(_vertNum!=int(_m.vert.size()) || _faceNum!=_m.face.size()) Init();
+
+    const int vn=_vertNum;
+    const ScalarType inf=std::numeric_limits<ScalarType>::max();
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      _d[i]=inf; _src[i]=-1; _par[i]=-1;
+      _settled[i]=0; _inOpen[i]=0; _isSeed[i]=0;
+    }
+    _open.clear();
+    for(size_t i=0;i<seedVec.size();++i)
+    {
+      const int v=tri::Index(_m,seedVec[i].v);
+      _d[v]=seedVec[i].d; _src[v]=v; _par[v]=v; _isSeed[v]=1;
+      if(!_inOpen[v]) { _inOpen[v]=1; _open.push_back(v); }
+    }
+
+    VertexPointer farthest=Propagate(distFunc,distance_threshold,vertSource,vertParent,InInterval);
+    _ready = (distance_threshold==std::numeric_limits<ScalarType>::max());
+    for(size_t i=0;i<seedVec.size();++i)
+      if(seedVec[i].d!=0) _ready=false;
+
+    if (InInterval==NULL)
+    {
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<vn;++i)
+        if(!_m.vert[i].IsD()) _m.vert[i].Q()=_d[i];
+    }
+    else
+    {
+      for(size_t i=0;i<InInterval->size();i++)
+        (*InInterval)[i]->Q()=_d[tri::Index(_m,(*InInterval)[i])];
+    }
+    return farthest;
+  }
+
+  /// \brief Incremental update of the distance after a change of the seed set.
+  ///
+  /// It must follow a Compute()/Visit()/Update() on the same mesh with the same functor and no distance threshold.
+  /// The regions of the seeds that are no more in seedVec and the regions where the new seeds fall are cleared,
+  /// and the wavefront restarts from the seeds and from the border of the cleared area.
+  /// The other regions keep their distances as long as they keep all their vertices: if a new source takes some vertices
+  /// of one of them, the distances near the new border are stale, so that region is cleared too and the update repeated.
+  /// As Compute(), it stores the distance in the vertex quality and, if required, the source and the parent of each vertex.
+  template <class DistanceFunctor>
+  void Update(const std::vector<VertexPointer> &seedVec,
+              DistanceFunctor &distFunc,
+              VertexHandle *vertSource = NULL,
+              VertexHandle *vertParent = NULL)
+  {
+    if(!_ready || _vertNum!=int(_m.vert.size()) || _faceNum!=_m.face.size())
+    {
+      Compute(seedVec,distFunc,std::numeric_limits<ScalarType>::max(),0,vertSource,vertParent);
+      return;
+    }
+    const int vn=_vertNum;
+
+    // the regions to be cleared are flagged on their seed; _inCand is used as the 'new seed' flag
+    for(size_t i=0;i<seedVec.size();++i) _inCand[tri::Index(_m,seedVec[i])]=1;
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+      _clear[i] = (_isSeed[i] && !_inCand[i]) ? 1 : 0;
+    for(size_t i=0;i<seedVec.size();++i)
+    {
+      const int v=tri::Index(_m,seedVec[i]);
+      if(!_isSeed[v] && _src[v]>=0) _clear[_src[v]]=1;
+    }
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+      _isSeed[i]=_inCand[i];
+    for(size_t i=0;i<seedVec.size();++i) _inCand[tri::Index(_m,seedVec[i])]=0;
+    _oldD=_d; _oldSrc=_src; _oldPar=_par;
+    for(;;)
+    {
+      Recompute(seedVec,distFunc);
+      // a region that lost some vertices is recomputed too
+      bool again=false;
+      for(int i=0;i<vn;++i)
+      {
+        const int s=_oldSrc[i];
+        if(s>=0 && !_clear[s] && _src[i]!=s) { _clear[s]=1; again=true; }
+      }
+      if(!again) break;
+    }
+
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      VertexPointer vp=&_m.vert[i];
+      if(vp->IsD()) continue;
+      vp->Q()=_d[i];
+      if(_src[i]<0) continue;
+      if(vertSource!=NULL) (*vertSource)[vp]=&_m.vert[_src[i]];
+      if(vertParent!=NULL) (*vertParent)[vp]=&_m.vert[_par[i]];
+    }
+  }
+
+protected:
+  MeshType &_m;
+  bool _ready; // a complete distance field is available for Update()
+  int _vertNum;
+  size_t _faceNum;
+  ScalarType _autoDelta;
+  // for each vertex w the pairs (curr,opp) of the other two vertices of its faces
+  std::vector<int> _start, _curr, _opp;
+  std::vector<ScalarType> _d, _nd;
+  std::vector<int> _src, _par, _ns, _np;
+  std::vector<char> _settled, _inOpen, _inCand, _isSeed;
+  std::vector<int> _open, _cand;
+  // Update() workspace: flag of the regions to recompute (on their seed) and the field it starts from
+  std::vector<char> _clear;
+  std::vector<ScalarType> _oldD;
+  std::vector<int> _oldSrc, _oldPar;
+
+  // Restart the field saved in _oldD/_oldSrc/_oldPar with the _clear regions emptied and propagate it from
+  // the seeds and from the vertices around the emptied area.
+  template <class DistanceFunctor>
+  void Recompute(const std::vector<VertexPointer> &seedVec, DistanceFunctor &distFunc)
+  {
+    const int vn=_vertNum;
+    const ScalarType inf=std::numeric_limits<ScalarType>::max();
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      const int s=_oldSrc[i];
+      if(s<0 || _clear[s]) { _d[i]=inf; _src[i]=-1; _par[i]=-1; }
+      else { _d[i]=_oldD[i]; _src[i]=s; _par[i]=_oldPar[i]; }
+      _settled[i]=0; _inOpen[i]=0;
+    }
+    _open.clear();
+    for(int i=0;i<vn;++i)
+      if(_src[i]<0)
+        for(int k=_start[i];k<_start[i+1];++k)
+        {
+          const int w=_curr[k];
+          if(_d[w]<inf && !_inOpen[w]) { _inOpen[w]=1; _open.push_back(w); }
+        }
+    for(size_t i=0;i<seedVec.size();++i)
+    {
+      const int v=tri::Index(_m,seedVec[i]);
+      if(_src[v]!=v)
+      {
+        _d[v]=0; _src[v]=v; _par[v]=v;
+        if(!_inOpen[v]) { _inOpen[v]=1; _open.push_back(v); }
+      }
+    }
+    Propagate(distFunc,inf,NULL,NULL,NULL);
+  }
+
+  // Bucketed relaxation of the wavefront starting from the _open vertices; vertices not yet settled can still improve.
+  template <class DistanceFunctor>
+  VertexPointer Propagate(DistanceFunctor &distFunc, ScalarType distance_threshold,
+                          VertexHandle *vertSource, VertexHandle *vertParent, std::vector<VertexPointer> *InInterval)
+  {
+    const ScalarType inf=std::numeric_limits<ScalarType>::max();
+    const ScalarType delta=(Delta>0) ? Delta : _autoDelta;
+    VertexPointer farthest=0;
+    ScalarType max_distance=0;
+    std::vector<int> changed;
+    while(!_open.empty())
+    {
+      ScalarType dmin=inf;
+      for(size_t i=0;i<_open.size();++i) dmin=std::min(dmin,_d[_open[i]]);
+      if(dmin>=distance_threshold) break;
+      const ScalarType T=dmin+delta;
+
+      changed.clear();
+      for(size_t i=0;i<_open.size();++i)
+        if(_d[_open[i]]<T) changed.push_back(_open[i]);
+
+      // relax the bucket until it is stable
+      while(!changed.empty())
+      {
+        _cand.clear();
+        for(size_t i=0;i<changed.size();++i)
+          for(int k=_start[changed[i]];k<_start[changed[i]+1];++k)
+          {
+            const int w=_curr[k];
+            if(!_settled[w] && !_inCand[w]) { _inCand[w]=1; _cand.push_back(w); }
+          }
+        const int cn=int(_cand.size());
+        _nd.resize(cn); _ns.resize(cn); _np.resize(cn);
+#pragma omp parallel for schedule(dynamic,64) if(cn>256)
+        for(int i=0;i<cn;++i)
+          Pull(distFunc,_cand[i],T,_nd[i],_ns[i],_np[i]);
+
+        changed.clear();
+        for(int i=0;i<cn;++i)
+        {
+          const int w=_cand[i];
+          _inCand[w]=0;
+          if(_nd[i] < _d[w] - std::numeric_limits<ScalarType>::epsilon()*16*_nd[i])
+          {
+            _d[w]=_nd[i]; _src[w]=_ns[i]; _par[w]=_np[i];
+            if(_d[w]<T) changed.push_back(w);
+            if(!_inOpen[w]) { _inOpen[w]=1; _open.push_back(w); }
+          }
+        }
+      }
+
+      // settle the bucket
+      size_t kept=0;
+      for(size_t i=0;i<_open.size();++i)
+      {
+        const int v=_open[i];
+        if(_d[v]<T)
+        {
+          _settled[v]=1; _inOpen[v]=0;
+          VertexPointer vp=&_m.vert[v];
+          if(InInterval!=NULL) InInterval->push_back(vp);
+          if(vertSource!=NULL) (*vertSource)[vp]=&_m.vert[_src[v]];
+          if(vertParent!=NULL) (*vertParent)[vp]=&_m.vert[_par[v]];
+          if(_d[v]>max_distance || farthest==0) { max_distance=_d[v]; farthest=vp; }
+        }
+        else _open[kept++]=v;
+      }
+      _open.resize(kept);
+    }
+    return farthest;
+  }
+
+  // Best distance of w that can be obtained from its neighbors whose distance is below T (same update of Geodesic::Visit).
+  template <class DistanceFunctor>
+  void Pull(DistanceFunctor &distFunc, int w, ScalarType T, ScalarType &bestD, int &bestS, int &bestP)
+  {
+    bestD=_d[w]; bestS=_src[w]; bestP=_par[w];
+    VertexPointer pw=&_m.vert[w];
+    for(int k=_start[w];k<_start[w+1];++k)
+    {
+      const int c=_curr[k], c1=_opp[k];
+      const ScalarType d_curr=_d[c];
+      if(!(d_curr<T)) continue;
+      VertexPointer curr=&_m.vert[c];
+      VertexPointer pw1=&_m.vert[c1];
+      const ScalarType d_pw1=_d[c1];
+      ScalarType curr_d;
+      const ScalarType inter = distFunc(curr,pw1);
+      const ScalarType tol = (inter + d_curr + d_pw1)*.0001f;
+      if ( (_src[c1] != _src[c]) ||
+           (inter + d_curr < d_pw1  +tol ) ||
+           (inter + d_pw1  < d_curr +tol ) ||
+           (d_curr + d_pw1 < inter  +tol ) )
+        curr_d = d_curr + distFunc(pw,curr);
+      else
+        curr_d = Geodesic<MeshType>::Distance(distFunc,pw,pw1,curr,d_pw1,d_curr);
+      if(curr_d<bestD) { bestD=curr_d; bestS=_src[c]; bestP=c; }
+    }
+  }
+};
+
 }// end namespace tri
 }// end namespace vcg
 #endif
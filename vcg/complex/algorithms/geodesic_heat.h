@@ -0,0 +1,212 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_GEODESIC_HEAT
+#define __VCGLIB_GEODESIC_HEAT
+
+#include <eigenlib/Eigen/Sparse>
+#include <vcg/complex/algorithms/mesh_to_matrix.h>
+
+namespace vcg{
+namespace tri{
+
+/*! \brief Geodesic distance with the heat method (Crane et al. 2013).
+
+The distance from a set of sources is obtained by integrating the heat flow for a short time t,
+normalizing the gradient of the resulting function and recovering the function whose gradient is closest
+to it by solving a Poisson equation. The two sparse systems depend only on the mesh, so they are factorized
+once in Init() and every Compute() costs just two back substitutions plus a couple of linear passes on the mesh.
+It is convenient when the distance has to be computed many times on the same mesh;
+for a single query Geodesic::Compute() is faster.
+
+The cotangent Laplacian and the lumped mass matrix are the ones of MeshToMatrix::GetLaplacianMatrix() and
+MeshToMatrix::MassMatrixEntry(). The mesh must be compact and with FF adjacency; Init() must be called again if it changes.
+
+\code
+HeatGeodesic<MyMesh> hg(m);
+for(...)
+  hg.Compute(seedVec);    // distance stored in the vertex quality
+\endcode
+*/
+template <class MeshType>
+class HeatGeodesic
+{
+public:
+  typedef typename MeshType::VertexPointer VertexPointer;
+  typedef typename MeshType::FaceType FaceType;
+  typedef typename MeshType::CoordType CoordType;
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef Eigen::SparseMatrix<double> SpMat;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1> VecX;
+  typedef Point3<double> Point3x;
+
+  /// The heat is integrated for a time of TimeFactor*h^2, with h the average edge length.
+  HeatGeodesic(MeshType &m, ScalarType timeFactor=1) : _m(m), _valid(false) { Init(timeFactor); }
+
+  /// Build and factorize the heat and the Poisson systems. Returns false if the factorization fails.
+  bool Init(ScalarType timeFactor=1)
+  {
+    tri::RequireCompactness(_m);
+    tri::RequireFFAdjacency(_m);
+    const int vn=_m.vn;
+    const int fn=_m.fn;
+
+    std::vector<std::pair<int,int> > index;
+    std::vector<ScalarType> entry;
+    MeshToMatrix<MeshType>::GetLaplacianMatrix(_m,index,entry,true,1,false);
+    // each edge gets the cotangent weight once for each incident face: border edges have only one, so add it twice
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j)
+        if(face::IsBorder(_m.face[i],j))
+        {
+          const int v0=int(tri::Index(_m,_m.face[i].V0(j))), v1=int(tri::Index(_m,_m.face[i].V1(j)));
+          const ScalarType w=Harmonic<MeshType>::template CotangentWeight<ScalarType>(_m.face[i],j);
+          index.push_back(std::make_pair(v0,v0)); entry.push_back(w);
+          index.push_back(std::make_pair(v0,v1)); entry.push_back(-w);
+          index.push_back(std::make_pair(v1,v1)); entry.push_back(w);
+          index.push_back(std::make_pair(v1,v0)); entry.push_back(-w);
+        }
+    SpMat L=ToSparse(index,entry,vn,0.5);
+
+    // MassMatrixEntry normalizes the sum of the double areas of the faces around each vertex by its maximum
+    double maxA=0;
+    std::vector<double> a(vn,0);
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j) a[tri::Index(_m,_m.face[i].V(j))]+=DoubleArea(_m.face[i]);
+    for(int i=0;i<vn;++i) maxA=std::max(maxA,a[i]);
+    index.clear(); entry.clear();
+    MeshToMatrix<MeshType>::MassMatrixEntry(_m,index,entry,false);
+    SpMat M=ToSparse(index,entry,vn,maxA/6.0);
+
+    double edgeSum=0;
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j) edgeSum+=Distance(_m.face[i].cP0(j),_m.face[i].cP1(j));
+    const double h=(fn>0) ? edgeSum/(3*fn) : 1;
+    const double t=timeFactor*h*h;
+
+    SpMat A=M+t*L;
+    _heatSolver.compute(A);
+    // a tiny mass term makes the Poisson system definite (one constant per connected component)
+    SpMat B=L+(1e-8/(h*h))*M;
+    _poissonSolver.compute(B);
+    _valid = (_heatSolver.info()==Eigen::Success && _poissonSolver.info()==Eigen::Success);
+
+    // per face gradient operator (N x e_i)/2A and cotangents of the corners
+    _grad.resize(fn*3);
+    _cot.resize(fn*3);
+    for(int i=0;i<fn;++i)
+    {
+      const FaceType &f=_m.face[i];
+      Point3x p[3];
+      for(int j=0;j<3;++j) p[j].Import(f.cP(j));
+      Point3x n=(p[1]-p[0])^(p[2]-p[0]);
+      const double dblA=n.Norm();
+      if(dblA>0) n/=dblA;
+      for(int j=0;j<3;++j)
+      {
+        const Point3x e=p[(j+2)%3]-p[(j+1)%3]; // edge opposite to vertex j
+        _grad[i*3+j]= (dblA>0) ? (n^e)/dblA : Point3x(0,0,0);
+        const Point3x u=p[(j+1)%3]-p[j], v=p[(j+2)%3]-p[j];
+        const double s=(u^v).Norm();
+        _cot[i*3+j]= (s>0) ? (u*v)/s : 0;
+      }
+    }
+    _d.resize(vn);
+    return _valid;
+  }
+
+  /// Distances computed by the last call, indexed as the vertex vector.
+  const std::vector<ScalarType> &Dist() const { return _d; }
+
+  /// Compute the distance from the given sources and store it in the vertex quality.
+  bool Compute(const std::vector<VertexPointer> &seedVec)
+  {
+    tri::RequirePerVertexQuality(_m);
+    if(!_valid || seedVec.empty()) return false;
+    const int vn=_m.vn;
+    const int fn=_m.fn;
+
+    VecX u0=VecX::Zero(vn);
+    for(size_t i=0;i<seedVec.size();++i) u0[tri::Index(_m,seedVec[i])]=1;
+    const VecX u=_heatSolver.solve(u0);
+
+    // normalized gradient field X=-grad(u)/|grad(u)| and its divergence contribution to the face vertices
+    std::vector<double> div(fn*3);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+    {
+      const FaceType &f=_m.face[i];
+      int vi[3];
+      for(int j=0;j<3;++j) vi[j]=int(tri::Index(_m,f.cV(j)));
+      Point3x g(0,0,0);
+      for(int j=0;j<3;++j) g+=_grad[i*3+j]*u[vi[j]];
+      const double gn=g.Norm();
+      const Point3x X= (gn>0) ? -g/gn : Point3x(0,0,0);
+      Point3x p[3];
+      for(int j=0;j<3;++j) p[j].Import(f.cP(j));
+      for(int j=0;j<3;++j)
+      {
+        const Point3x e1=p[(j+1)%3]-p[j], e2=p[(j+2)%3]-p[j];
+        div[i*3+j]=0.5*(_cot[i*3+(j+2)%3]*(e1*X) + _cot[i*3+(j+1)%3]*(e2*X));
+      }
+    }
+    VecX b=VecX::Zero(vn);
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j)
+        b[tri::Index(_m,_m.face[i].V(j))]-=div[i*3+j];
+
+    const VecX phi=_poissonSolver.solve(b);
+    double minSrc=std::numeric_limits<double>::max();
+    for(size_t i=0;i<seedVec.size();++i) minSrc=std::min(minSrc,phi[tri::Index(_m,seedVec[i])]);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      _d[i]=ScalarType(std::max(0.0,phi[i]-minSrc));
+      _m.vert[i].Q()=_d[i];
+    }
+    return true;
+  }
+
+protected:
+  MeshType &_m;
+  bool _valid;
+  Eigen::SimplicialLDLT<SpMat> _heatSolver;
+  Eigen::SimplicialLDLT<SpMat> _poissonSolver;
+  std::vector<Point3x> _grad;
+  std::vector<double> _cot;
+  std::vector<ScalarType> _d;
+
+  static SpMat ToSparse(const std::vector<std::pair<int,int> > &index, const std::vector<ScalarType> &entry, int n, double scale)
+  {
+    std::vector<Eigen::Triplet<double> > IJV;
+    IJV.reserve(index.size());
+    for(size_t i=0;i<index.size();++i)
+      IJV.push_back(Eigen::Triplet<double>(index[i].first,index[i].second,scale*entry[i]));
+    SpMat X(n,n);
+    X.setFromTriplets(IJV.begin(),IJV.end());
+    return X;
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCGLIB_GEODESIC_HEAT
@@ -69,9 +69,20 @@ public:
   typedef typename MESH::ScalarType    ScalarType;
   typedef typename MESH::CoordType     CoordType;
   
+  /// State shared by all the ears of a hole. It is owned by the hole filling function:
+  /// ears of different holes use different contexts so that independent holes can be filled concurrently.
+  class HoleContext
+  {
+  public:
+    HoleContext(int bit=0) : nonManifoldBit(bit) {}
+    int nonManifoldBit;                     // marks the boundary vertices traversed more than once
+    std::vector<FacePointer> adjacencyRing; // faces around the hole (used by SelfIntersectionEar)
+  };
+
   PosType e0;
   PosType e1;
   CoordType n; // the normal of the face defined by the ear
+  HoleContext *ctx;
   
   const char * Dump() {return 0;}
   // The following members are useful to consider the Ear as a generic <triangle>
@@ -89,8 +100,8 @@ public:
 
   ScalarType quality;
   ScalarType angleRad;
-  TrivialEar(){}
-  TrivialEar(const PosType & ep)
+  TrivialEar():ctx(0){}
+  TrivialEar(const PosType & ep):ctx(0)
   {
     e0=ep;
     assert(e0.IsBorder());
@@ -130,19 +141,17 @@ public:
   /** NonManifoldBit
    * To handle non manifoldness situations we keep track 
    * of the vertices of the hole boundary that are traversed by more than a single boundary.
-   * 
+   * The user bit is stored in the context of the hole.
    */
-  static int &NonManifoldBit() { static int _NonManifoldBit=0; return _NonManifoldBit; }
-  static int InitNonManifoldBitOnHoleBoundary(const PosType &p)       
+  int NonManifoldBit() const { return ctx->nonManifoldBit; }
+  static int InitNonManifoldBitOnHoleBoundary(const PosType &p, int nonManifoldBit)
   {
-    if(NonManifoldBit()==0) 
-      NonManifoldBit() = VertexType::NewBitFlag(); 
     int holeSize=0;
     
     //First loop around the hole to mark non manifold vertices.
     PosType ip = p;   // Pos iterator
     do{
-      ip.V()->ClearUserBit(NonManifoldBit());
+      ip.V()->ClearUserBit(nonManifoldBit);
       ip.V()->ClearV();
       ip.NextB();
       holeSize++;
@@ -153,7 +162,7 @@ public:
       if(!ip.V()->IsV())
         ip.V()->SetV();  
       else  // All the vertexes that are visited more than once are non manifold
-        ip.V()->SetUserBit(NonManifoldBit());
+        ip.V()->SetUserBit(nonManifoldBit);
       ip.NextB();
     } while(ip!=p);
     return holeSize;
@@ -340,12 +349,6 @@ public:
   typedef typename MESH::ScalarType ScalarType;
   typedef typename MESH::CoordType CoordType;
 
-  static std::vector<FacePointer> &AdjacencyRing()
-  {
-    static std::vector<FacePointer> ar;
-    return ar;
-  }
-
   SelfIntersectionEar(){}
   SelfIntersectionEar(const PosType & ep):MinimumWeightEar<MESH>(ep){}
 
@@ -366,7 +369,8 @@ public:
     face::FFSetBorder(f,2);
 
     typename std::vector< FacePointer >::iterator it;
-    for(it = this->AdjacencyRing().begin();it!= this->AdjacencyRing().end();++it)
+    std::vector<FacePointer> &adjacencyRing = this->ctx->adjacencyRing;
+    for(it = adjacencyRing.begin();it!= adjacencyRing.end();++it)
     {
       if(!(*it)->IsD())
       {
@@ -385,7 +389,7 @@ public:
       }
     }
     bool ret=TrivialEar<MESH>::Close(np0,np1,f);
-    if(ret) AdjacencyRing().push_back(f);
+    if(ret) adjacencyRing.push_back(f);
     return ret;
   }
 }; // end class SelfIntersectionEar
@@ -473,17 +477,41 @@ template<class EAR>
                             const PosType &p, // the particular hole to be filled
                             std::vector<FacePointer *> &facePointersToBeUpdated)
     {
-      
       assert(tri::IsValidPointer(m,p.f));
       assert(p.IsBorder());
-      int holeSize = EAR::InitNonManifoldBitOnHoleBoundary(p);
+      int holeSize = 0;
+      PosType ip = p;
+      do { ++holeSize; ip.NextB(); } while(ip!=p);
+      typename EAR::HoleContext ctx(VertexType::NewBitFlag());
       FaceIterator f = tri::Allocator<MESH>::AddFaces(m, holeSize-2, facePointersToBeUpdated);
+      f = FillHoleEarRange<EAR>(p,f,ctx);
+
+      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
+      // so we delete the remaining ones. 
+      while(f!=m.face.end()){
+        tri::Allocator<MESH>::DeleteFace(m,*f);
+        f++;
+      }
+      VertexType::DeleteBitFlag(ctx.nonManifoldBit);
+    }
+
+/** FillHoleEarRange
+ * Fill a hole using the already allocated faces starting from f (at least holesize-2 faces).
+ * It touches only the faces and the vertices of the hole boundary and the given context,
+ * so holes that do not share vertices can be filled concurrently.
+ * Returns the iterator to the first unused face.
+ */
+template<class EAR>
+    static FaceIterator FillHoleEarRange(const PosType &p, FaceIterator f, typename EAR::HoleContext &ctx)
+    {
+      int holeSize = EAR::InitNonManifoldBitOnHoleBoundary(p,ctx.nonManifoldBit);
 
       std::priority_queue< EAR > EarHeap;
       PosType fp = p;
       do{
         EAR appEar = EAR(fp);
-        if(!fp.v->IsUserBit(EAR::NonManifoldBit()))
+        appEar.ctx = &ctx;
+        if(!fp.v->IsUserBit(ctx.nonManifoldBit))
            EarHeap.push( appEar );
         //printf("Adding ear %s ",app.Dump());
         fp.NextB();
@@ -503,25 +531,23 @@ template<class EAR>
           if(BestEar.Close(ep0,ep1,&*f))
           {
             if(!ep0.IsNull()){
-              assert(!ep0.v->IsUserBit(EAR::NonManifoldBit()));
-              EarHeap.push(EAR(ep0));
+              assert(!ep0.v->IsUserBit(ctx.nonManifoldBit));
+              EAR newEar(ep0);
+              newEar.ctx = &ctx;
+              EarHeap.push(newEar);
             }
             if(!ep1.IsNull()){
-              assert(!ep1.v->IsUserBit(EAR::NonManifoldBit()));
-              EarHeap.push(EAR(ep1));
+              assert(!ep1.v->IsUserBit(ctx.nonManifoldBit));
+              EAR newEar(ep1);
+              newEar.ctx = &ctx;
+              EarHeap.push(newEar);
             }
             --holeSize;
             ++f;
           }
         }//is update()
       } 
-      
-      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
-      // so we delete the remaining ones. 
-      while(f!=m.face.end()){
-        tri::Allocator<MESH>::DeleteFace(m,*f);
-        f++;
-      }
+      return f;
     }
 
     template<class EAR>
@@ -529,24 +555,7 @@ template<class EAR>
     {
       std::vector< Info > vinfo;
       GetInfo(m, Selected,vinfo);
-
-      typename std::vector<Info >::iterator ith;
-      int indCb=0;
-      int holeCnt=0;
-      std::vector<FacePointer *> facePtrToBeUpdated;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-        facePtrToBeUpdated.push_back( &(*ith).p.f );
-
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-      {
-        indCb++;
-        if(cb) (*cb)(indCb*10/vinfo.size(),"Closing Holes");
-        if((*ith).size < sizeHole){
-          holeCnt++;
-          FillHoleEar< EAR >(m, (*ith).p,facePtrToBeUpdated);
-        }
-      }
-      return holeCnt;
+      return FillHolesEar<EAR>(m,vinfo,sizeHole,false,cb);
     }
 
 /// Main Hole Filling function.
@@ -558,47 +567,88 @@ template<class EAR>
     {
       std::vector<Info > vinfo;
       GetInfo(m, Selected,vinfo);
-      typename std::vector<Info>::iterator ith;
+      return FillHolesEar<EAR>(m,vinfo,maxSizeHole,true,cb);
+    }
 
-      // collect the face pointer that has to be updated by the various addfaces
-      std::vector<FacePointer *> vfpOrig;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-        vfpOrig.push_back( &(*ith).p.f );
+/** FillHolesEar
+ * Fill all the holes smaller than maxSizeHole.
+ * The faces for all the holes are allocated with a single AddFaces, each hole gets its own range of them.
+ * Holes that do not share any vertex with other holes are filled concurrently, the others serially.
+ * If adjacencyRing is true the faces around each hole are collected in its context (for SelfIntersectionEar).
+ * Returns the number of filled holes.
+ */
+template<class EAR>
+    static int FillHolesEar(MESH &m, std::vector<Info> &vinfo, const int maxSizeHole, bool adjacencyRing, CallBackPos *cb=0)
+    {
+      std::vector<int> hole;
+      std::vector<int> firstFace(1,0);
+      std::vector<FacePointer *> facePtrToBeUpdated;
+      for(size_t i=0;i<vinfo.size();++i)
+        if(vinfo[i].size < maxSizeHole)
+        {
+          hole.push_back(int(i));
+          firstFace.push_back(firstFace.back()+std::max(0,vinfo[i].size-2));
+          facePtrToBeUpdated.push_back(&vinfo[i].p.f);
+        }
+      const int hn = int(hole.size());
+      if(hn==0 || firstFace.back()==0) return hn;
+      if(cb) (*cb)(0,"Closing Holes");
+
+      // holes sharing a boundary vertex cannot be filled at the same time
+      std::vector<int> owner(m.vert.size(),-1);
+      std::vector<char> shared(hn,0);
+      for(int i=0;i<hn;++i)
+      {
+        PosType ip = vinfo[hole[i]].p;
+        do {
+          int &o = owner[tri::Index(m,ip.v)];
+          if(o!=-1 && o!=i) { shared[i]=1; shared[o]=1; }
+          o = i;
+          ip.NextB();
+        } while(ip!=vinfo[hole[i]].p);
+      }
 
-      int indCb=0;
-      int holeCnt=0;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
+      const size_t base = m.face.size();
+      tri::Allocator<MESH>::AddFaces(m, firstFace.back(), facePtrToBeUpdated);
+      const int nmBit = VertexType::NewBitFlag();
+      std::vector<int> usedFace(hn,0);
+      for(int pass=0;pass<2;++pass)
       {
-        indCb++;
-        if(cb) (*cb)(indCb*10/vinfo.size(),"Closing Holes");
-        if((*ith).size < maxSizeHole){
-          std::vector<FacePointer *> facePtrToBeUpdated;
-          holeCnt++;
-          facePtrToBeUpdated=vfpOrig;
-          EAR::AdjacencyRing().clear();
-          //Loops around the hole to collect the faces that have to be tested for intersection.
-          PosType ip = (*ith).p;
-          do
+#pragma omp parallel for schedule(dynamic,16) if(pass==0)
+        for(int i=0;i<hn;++i)
+        {
+          if(shared[i]!=pass) continue;
+          const PosType &p = vinfo[hole[i]].p;
+          typename EAR::HoleContext ctx(nmBit);
+          if(adjacencyRing)
           {
-            PosType inp = ip;
+            //Loops around the hole to collect the faces that have to be tested for intersection.
+            PosType ip = p;
             do
             {
-              inp.FlipE();
-              inp.FlipF();
-              EAR::AdjacencyRing().push_back(inp.f);
-            } while(!inp.IsBorder());
-            ip.NextB();
-          }while(ip != (*ith).p);
-
-          typename std::vector<FacePointer>::iterator fpi;
-          for(fpi=EAR::AdjacencyRing().begin();fpi!=EAR::AdjacencyRing().end();++fpi)
-            facePtrToBeUpdated.push_back( &*fpi );
-
-          FillHoleEar<EAR >(m, ith->p,facePtrToBeUpdated);
-          EAR::AdjacencyRing().clear();
+              PosType inp = ip;
+              do
+              {
+                inp.FlipE();
+                inp.FlipF();
+                ctx.adjacencyRing.push_back(inp.f);
+              } while(!inp.IsBorder());
+              ip.NextB();
+            }while(ip != p);
+          }
+          FaceIterator f = m.face.begin()+base+firstFace[i];
+          usedFace[i] = int(FillHoleEarRange<EAR>(p,f,ctx)-f);
         }
       }
-      return holeCnt;
+      VertexType::DeleteBitFlag(nmBit);
+
+      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ),
+      // so we delete the remaining ones.
+      for(int i=0;i<hn;++i)
+        for(int j=firstFace[i]+usedFace[i];j<firstFace[i+1];++j)
+          tri::Allocator<MESH>::DeleteFace(m,m.face[base+j]);
+      if(cb) (*cb)(100,"Closing Holes");
+      return hn;
     }
 
 
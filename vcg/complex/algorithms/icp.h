@@ -0,0 +1,363 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_ICP
+#define __VCGLIB_ICP
+
+#include <vcg/complex/complex.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+#include <vcg/space/point_matching.h>
+#include <vcg/math/random_generator.h>
+#include <chrono>
+
+namespace vcg{
+namespace tri{
+
+/*! \brief Iterative Closest Point fine registration.
+
+The fix point set (with its normals when the point to plane metric is used) is copied and indexed
+with a KdTree once in Init(); the index is then shared by all the following Align() calls, so many moving
+meshes (or many starting poses) can be registered against the same fix mesh without rebuilding it.
+
+Each iteration:
+ - transforms the moving samples with the current matrix and looks for their closest fix points in parallel;
+ - discards the pairs farther than Param::maxDistance and keeps only the Param::trimRatio fraction of the closest ones (trimmed ICP);
+ - weights the kept pairs with the Huber function of their distance (if Param::robustScale > 0);
+ - solves for the increment with ComputeWeightedRigidMatchMatrix() or ComputeRigidMatchMatrixPointToPlane().
+
+It stops when the increment moves the samples less than Param::minTrStep and rotates them less than Param::minRotStep,
+or after Param::maxIterNum iterations. Every iteration is recorded in Stat, with its timings.
+
+\code
+ICP<MyMesh> icp;
+icp.Init(fixMesh);
+Matrix44f tr=initialGuess;     // brings movMesh onto fixMesh
+ICP<MyMesh>::Stat st;
+icp.Align(movMesh,tr,st);
+st.Dump(stdout);
+\endcode
+*/
+template <class MeshType>
+class ICP
+{
+public:
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef typename MeshType::CoordType CoordType;
+  typedef typename MeshType::VertexIterator VertexIterator;
+  typedef Matrix44<ScalarType> Matrix44x;
+
+  class Param
+  {
+  public:
+    int maxIterNum;         ///< maximum number of iterations
+    int sampleNum;          ///< number of vertices of the moving mesh used as samples (0 means all)
+    ScalarType maxDistance; ///< pairs farther than this are discarded (0 means no limit)
+    bool pointToPlane;      ///< use the point to plane metric (the fix normals are required)
+    ScalarType trimRatio;   ///< fraction of the closest pairs kept at each iteration
+    ScalarType robustScale; ///< Huber threshold, as a multiple of the median pair distance (0 disables the weighting)
+    ScalarType minRotStep;  ///< convergence threshold on the rotation of the increment (radians)
+    ScalarType minTrStep;   ///< convergence threshold on the displacement of the samples barycenter (0 means 1e-5 of the fix bbox diagonal)
+    int minPairNum;         ///< an iteration with less pairs than this fails
+    unsigned int randSeed;  ///< seed used to choose the samples
+
+    Param()
+    {
+      maxIterNum=50;
+      sampleNum=5000;
+      maxDistance=0;
+      pointToPlane=false;
+      trimRatio=0.9;
+      robustScale=0;
+      minRotStep=1e-5;
+      minTrStep=0;
+      minPairNum=6;
+      randSeed=0;
+    }
+  };
+
+  class IterStat
+  {
+  public:
+    int pairNum;          ///< pairs found within maxDistance
+    int keptNum;          ///< pairs used for the solution (after the trimming)
+    ScalarType rms;       ///< weighted root mean square distance of the kept pairs, before the increment
+    ScalarType rotStep;   ///< rotation angle of the increment
+    ScalarType trStep;    ///< displacement of the samples barycenter due to the increment
+    double searchTime;    ///< milliseconds spent in the closest point search
+    double solveTime;     ///< milliseconds spent in the trimming, weighting and solution
+  };
+
+  class Stat
+  {
+  public:
+    std::vector<IterStat> iter;
+    bool converged;
+    int sampleNum;
+    double totalTime;
+
+    Stat() { clear(); }
+    void clear() { iter.clear(); converged=false; sampleNum=0; totalTime=0; }
+    int iterNum() const { return int(iter.size()); }
+    ScalarType lastRms() const { return iter.empty() ? 0 : iter.back().rms; }
+    int lastKeptNum() const { return iter.empty() ? 0 : iter.back().keptNum; }
+
+    void Dump(FILE *fp) const
+    {
+      fprintf(fp,"ICP %s after %i iterations (%i samples) in %6.1f ms\n",converged?"converged":"stopped",iterNum(),sampleNum,totalTime);
+      for(size_t i=0;i<iter.size();++i)
+        fprintf(fp,"%3i pairs %6i kept %6i rms %9.6f rot %9.6f tr %9.6f search %6.2f ms solve %6.2f ms\n",int(i),
+                iter[i].pairNum,iter[i].keptNum,iter[i].rms,iter[i].rotStep,iter[i].trStep,iter[i].searchTime,iter[i].solveTime);
+    }
+  };
+
+  Param par;
+
+  ICP() : _tree(0), _fixDiag(0) {}
+  ~ICP() { delete _tree; }
+
+  /// Copy and index the vertices of the fix mesh. Its normals are copied too if it has them.
+  void Init(MeshType &fix)
+  {
+    std::vector<CoordType> posVec,norVec;
+    posVec.reserve(fix.vn);
+    if(HasPerVertexNormal(fix)) norVec.reserve(fix.vn);
+    for(VertexIterator vi=fix.vert.begin();vi!=fix.vert.end();++vi)
+      if(!vi->IsD())
+      {
+        posVec.push_back(vi->cP());
+        if(HasPerVertexNormal(fix)) norVec.push_back(vi->cN());
+      }
+    Init(posVec,norVec);
+  }
+
+  /// Index a fix point set; the normals can be empty if the point to plane metric is not used.
+  void Init(const std::vector<CoordType> &posVec, const std::vector<CoordType> &norVec)
+  {
+    assert(norVec.empty() || norVec.size()==posVec.size());
+    _fixPos=posVec;
+    _fixNor=norVec;
+    Box3<ScalarType> bb;
+    for(size_t i=0;i<_fixPos.size();++i) bb.Add(_fixPos[i]);
+    _fixDiag = _fixPos.empty() ? 0 : bb.Diag();
+    delete _tree;
+    _tree=0;
+    if(!_fixPos.empty())
+    {
+      VectorConstDataWrapper<std::vector<CoordType> > ww(_fixPos);
+      _tree = new KdTree<ScalarType>(ww);
+    }
+  }
+
+  int FixNum() const { return int(_fixPos.size()); }
+  const CoordType &FixP(int i) const { return _fixPos[i]; }
+  const CoordType &FixN(int i) const { return _fixNor[i]; }
+  bool HasFixNormal() const { return !_fixNor.empty() && _fixNor.size()==_fixPos.size(); }
+
+  /// Closest fix point to p (thread safe); returns its distance, its index is stored in ind.
+  ScalarType Closest(const CoordType &p, int &ind) const
+  {
+    assert(_tree);
+    unsigned int ui;
+    ScalarType sqDist;
+    _tree->doQueryClosest(p,ui,sqDist);
+    ind=int(ui);
+    return std::sqrt(sqDist);
+  }
+
+  /// Choose Param::sampleNum random vertices of a mesh (all of them if they are less).
+  void SampleMesh(MeshType &m, std::vector<CoordType> &sampleVec) const
+  {
+    std::vector<CoordType> posVec;
+    posVec.reserve(m.vn);
+    for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+      if(!vi->IsD()) posVec.push_back(vi->cP());
+    SamplePoints(posVec,sampleVec);
+  }
+
+  void SamplePoints(const std::vector<CoordType> &posVec, std::vector<CoordType> &sampleVec) const
+  {
+    std::vector<int> ind;
+    SampleIndices(int(posVec.size()),par.sampleNum,par.randSeed,ind);
+    sampleVec.resize(ind.size());
+    for(size_t i=0;i<ind.size();++i) sampleVec[i]=posVec[ind[i]];
+  }
+
+  /// Choose sampleNum distinct random indexes in [0,n), sorted (all of them if sampleNum is 0 or not less than n).
+  static void SampleIndices(int n, int sampleNum, unsigned int seed, std::vector<int> &ind)
+  {
+    ind.resize(n);
+    for(int i=0;i<n;++i) ind[i]=i;
+    if(sampleNum<=0 || sampleNum>=n) return;
+    math::MarsenneTwisterRNG rnd(seed);
+    // partial Fisher-Yates shuffle
+    for(int i=0;i<sampleNum;++i)
+      std::swap(ind[i],ind[i+int(rnd.generate(n-i))]);
+    ind.resize(sampleNum);
+    std::sort(ind.begin(),ind.end());
+  }
+
+  /// Register a mesh onto the fix one. On input tr is the starting pose, on output the final one.
+  /// Returns false if too few pairs are found.
+  bool Align(MeshType &mov, Matrix44x &tr, Stat &st)
+  {
+    std::vector<CoordType> sampleVec;
+    SampleMesh(mov,sampleVec);
+    return Align(sampleVec,tr,st);
+  }
+
+  /// Register a set of points onto the fix one (all the points are used, no subsampling is done).
+  bool Align(const std::vector<CoordType> &movVec, Matrix44x &tr, Stat &st)
+  {
+    assert(_tree);
+    assert(!par.pointToPlane || _fixNor.size()==_fixPos.size());
+    st.clear();
+    const double startTime=Now();
+    const int n=int(movVec.size());
+    st.sampleNum=n;
+    const ScalarType maxSqDist = (par.maxDistance>0) ? par.maxDistance*par.maxDistance : std::numeric_limits<ScalarType>::max();
+    const ScalarType minTrStep = (par.minTrStep>0) ? par.minTrStep : _fixDiag*ScalarType(1e-5);
+
+    std::vector<CoordType> curVec(n);
+    std::vector<int> closestVec(n);
+    std::vector<ScalarType> sqDistVec(n);
+    std::vector<CoordType> fixVec,norVec,movPairVec;
+    std::vector<ScalarType> distVec,weightVec,sortedVec;
+    bool ok=true;
+    for(int it=0;it<par.maxIterNum;++it)
+    {
+      IterStat is;
+      double t0=Now();
+#pragma omp parallel for schedule(dynamic,256)
+      for(int i=0;i<n;++i)
+      {
+        curVec[i]=tr*movVec[i];
+        unsigned int ind;
+        ScalarType sqDist;
+        _tree->doQueryClosest(curVec[i],ind,sqDist);
+        closestVec[i] = (sqDist<=maxSqDist) ? int(ind) : -1;
+        sqDistVec[i]=sqDist;
+      }
+      double t1=Now();
+      is.searchTime=t1-t0;
+
+      fixVec.clear(); norVec.clear(); movPairVec.clear(); distVec.clear();
+      for(int i=0;i<n;++i)
+        if(closestVec[i]>=0)
+        {
+          movPairVec.push_back(curVec[i]);
+          fixVec.push_back(_fixPos[closestVec[i]]);
+          if(par.pointToPlane) norVec.push_back(_fixNor[closestVec[i]]);
+          distVec.push_back(std::sqrt(sqDistVec[i]));
+        }
+      is.pairNum=int(distVec.size());
+      ComputeWeights(distVec,sortedVec,weightVec);
+      is.keptNum=0;
+      double wSum=0,errSum=0;
+      for(size_t i=0;i<weightVec.size();++i)
+        if(weightVec[i]>0)
+        {
+          ++is.keptNum;
+          wSum+=weightVec[i];
+          errSum+=weightVec[i]*distVec[i]*distVec[i];
+        }
+      is.rms = (wSum>0) ? ScalarType(std::sqrt(errSum/wSum)) : 0;
+
+      Matrix44x inc;
+      inc.SetIdentity();
+      if(is.keptNum<par.minPairNum) ok=false;
+      else if(!par.pointToPlane || !ComputeRigidMatchMatrixPointToPlane(fixVec,norVec,movPairVec,weightVec,inc))
+        ComputeWeightedRigidMatchMatrix(fixVec,movPairVec,weightVec,inc);
+      tr=inc*tr;
+
+      // size of the step: rotation angle and motion of the barycenter of the kept samples.
+      // The angle is taken from both its sine and cosine, so small rotations are not lost to rounding.
+      const double cosAngle=(double(inc[0][0])+inc[1][1]+inc[2][2]-1)/2;
+      const double sinAngle=std::sqrt(math::Sqr(double(inc[2][1])-inc[1][2])+math::Sqr(double(inc[0][2])-inc[2][0])+math::Sqr(double(inc[1][0])-inc[0][1]))/2;
+      is.rotStep=ScalarType(std::atan2(sinAngle,cosAngle));
+      CoordType bary(0,0,0);
+      for(size_t i=0;i<movPairVec.size();++i)
+        if(weightVec[i]>0) bary+=movPairVec[i];
+      if(is.keptNum>0) bary/=ScalarType(is.keptNum);
+      is.trStep=Distance(inc*bary,bary);
+      is.solveTime=Now()-t1;
+      st.iter.push_back(is);
+
+      if(!ok) break;
+      if(is.rotStep<=par.minRotStep && is.trStep<=minTrStep)
+      {
+        st.converged=true;
+        break;
+      }
+    }
+    st.totalTime=Now()-startTime;
+    return ok;
+  }
+
+protected:
+  std::vector<CoordType> _fixPos;
+  std::vector<CoordType> _fixNor;
+  KdTree<ScalarType> *_tree;
+  ScalarType _fixDiag;
+
+  /// Trimming and robust weighting of the pairs: weight 0 for the discarded ones, Huber weight for the others.
+  void ComputeWeights(const std::vector<ScalarType> &distVec, std::vector<ScalarType> &sortedVec, std::vector<ScalarType> &weightVec) const
+  {
+    const int n=int(distVec.size());
+    weightVec.assign(n,1);
+    if(n==0) return;
+    ScalarType trimThr=std::numeric_limits<ScalarType>::max();
+    int keepNum=n;
+    if(par.trimRatio<1)
+    {
+      keepNum=std::max(1,int(n*par.trimRatio));
+      sortedVec=distVec;
+      std::nth_element(sortedVec.begin(),sortedVec.begin()+keepNum-1,sortedVec.end());
+      trimThr=sortedVec[keepNum-1];
+    }
+    ScalarType huberThr=std::numeric_limits<ScalarType>::max();
+    if(par.robustScale>0)
+    {
+      sortedVec=distVec;
+      std::nth_element(sortedVec.begin(),sortedVec.begin()+n/2,sortedVec.end());
+      huberThr=std::max(par.robustScale*sortedVec[n/2],std::numeric_limits<ScalarType>::min());
+    }
+    // pairs at the trim threshold are kept in order until keepNum pairs are taken
+    int tieNum=keepNum;
+    for(int i=0;i<n;++i)
+      if(distVec[i]<trimThr) --tieNum;
+    for(int i=0;i<n;++i)
+    {
+      if(distVec[i]>trimThr || (distVec[i]==trimThr && tieNum--<=0)) { weightVec[i]=0; continue; }
+      if(distVec[i]>huberThr) weightVec[i]=huberThr/distVec[i];
+    }
+  }
+
+  static double Now()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count()/1000.0;
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCGLIB_ICP
@@ -92,6 +92,194 @@ namespace vcg {
 			}
 
 		}; // end class
+
+		/** \brief Inside/outside classification with the generalized winding number.
+
+		The winding number of a point is the sum of the solid angles of the faces seen from the point divided by 4pi:
+		it is 1 inside and 0 outside a closed oriented mesh and degrades smoothly in presence of holes, non manifold
+		or self intersecting parts, so thresholding it at 0.5 gives a robust inside test (Jacobson et al. 2013).
+
+		It is evaluated with the hierarchical approximation of Barill et al. 2018: the faces are stored in a bounding
+		volume hierarchy and each node caches its center, the area weighted sum of the normals (a dipole) and their
+		first moment. The nodes far enough from the query (distance > Beta * radius) are approximated by a second order
+		expansion, the others are opened and their faces summed exactly, so each query costs O(log n). The triangles are copied in the tree,
+		so the mesh is not needed after the construction. Vectors of points are processed in parallel.
+
+		\code
+		WindingNumber<MyMesh> wn(m);
+		wn.IsInside(pointVec,insideVec);
+		\endcode
+		*/
+		template <class MeshType>
+		class WindingNumber
+		{
+		public:
+			typedef typename MeshType::CoordType CoordType;
+			typedef typename MeshType::ScalarType ScalarType;
+			typedef Point3<double> Point3x;
+
+			/// Beta controls the accuracy: a node is approximated when its distance is larger than Beta times its radius.
+			WindingNumber(MeshType &m, double beta=2) : Beta(beta) { Init(m); }
+
+			double Beta;
+
+			/// Build the hierarchy on the faces of the mesh.
+			void Init(MeshType &m)
+			{
+				_tri.clear();
+				_node.clear();
+				std::vector<int> ind;
+				std::vector<Point3x> bar;
+				for(size_t i=0;i<m.face.size();++i)
+					if(!m.face[i].IsD())
+					{
+						ind.push_back(int(ind.size()));
+						for(int j=0;j<3;++j) _tri.push_back(Point3x::Construct(m.face[i].cP(j)));
+						bar.push_back((_tri[_tri.size()-3]+_tri[_tri.size()-2]+_tri[_tri.size()-1])/3.0);
+					}
+				if(ind.empty()) return;
+				_node.reserve(4*ind.size()/LeafSize+2);
+				_node.resize(1);
+				Build(ind,bar,0,0,int(ind.size()));
+				// store the triangles in the order of the leaves
+				std::vector<Point3x> sorted(_tri.size());
+				for(size_t i=0;i<ind.size();++i)
+					for(int j=0;j<3;++j) sorted[i*3+j]=_tri[ind[i]*3+j];
+				_tri.swap(sorted);
+			}
+
+			/// Winding number of a point.
+			double Compute(const CoordType &q) const
+			{
+				if(_node.empty()) return 0;
+				const Point3x p=Point3x::Construct(q);
+				double w=0;
+				int stack[128];
+				int top=0;
+				stack[top++]=0;
+				while(top>0)
+				{
+					const Node &n=_node[stack[--top]];
+					const Point3x d=n.center-p;
+					const double dist2=d.SquaredNorm();
+					if(dist2 > Beta*Beta*n.radius*n.radius)
+					{
+						// first and second order terms of the expansion of the solid angle around the center
+						const double inv3=1.0/(dist2*sqrt(dist2));
+						double dMd=0;
+						for(int j=0;j<3;++j)
+							for(int k=0;k<3;++k) dMd+=d[j]*n.moment[j*3+k]*d[k];
+						w+=(d*n.dipole)*inv3 + (n.moment[0]+n.moment[4]+n.moment[8])*inv3 - 3.0*dMd*inv3/dist2;
+					}
+					else if(n.child<0 || top+2>128)
+						for(int i=n.first;i<n.last;++i)
+							w+=SolidAngle(_tri[i*3]-p,_tri[i*3+1]-p,_tri[i*3+2]-p);
+					else
+					{
+						stack[top++]=n.child;
+						stack[top++]=n.child+1;
+					}
+				}
+				return w/(4.0*M_PI);
+			}
+
+			bool IsInside(const CoordType &q) const { return Compute(q)>0.5; }
+
+			/// Winding numbers of a vector of points (in parallel).
+			void Compute(const std::vector<CoordType> &q, std::vector<double> &w) const
+			{
+				w.resize(q.size());
+#pragma omp parallel for schedule(dynamic,256)
+				for(int i=0;i<int(q.size());++i)
+					w[i]=Compute(q[i]);
+			}
+
+			/// Inside flags (1 inside, 0 outside) of a vector of points (in parallel).
+			void IsInside(const std::vector<CoordType> &q, std::vector<char> &inside) const
+			{
+				inside.resize(q.size());
+#pragma omp parallel for schedule(dynamic,256)
+				for(int i=0;i<int(q.size());++i)
+					inside[i]=(Compute(q[i])>0.5) ? 1 : 0;
+			}
+
+		protected:
+			static const int LeafSize=8;
+			class Node
+			{
+			public:
+				Point3x center;  // area weighted barycenter of the faces
+				Point3x dipole;  // sum of the area weighted normals
+				double moment[9];// sum of the area weighted normals times the offset of the faces from center (n (x-center)^T)
+				double radius;   // radius of the sphere around center containing the faces
+				int first,last;  // range of the faces
+				int child;       // index of the first of the two children, -1 for leaves
+			};
+			std::vector<Point3x> _tri;
+			std::vector<Node> _node;
+
+			class Compare
+			{
+			public:
+				Compare(const std::vector<Point3x> &_bar, int _axis):bar(_bar),axis(_axis){}
+				bool operator()(int a, int b) const { return bar[a][axis]<bar[b][axis]; }
+				const std::vector<Point3x> &bar;
+				int axis;
+			};
+
+			// fill the node ni with the faces ind[first..last) and build its subtree; the two children are stored consecutively
+			void Build(std::vector<int> &ind, const std::vector<Point3x> &bar, int ni, int first, int last)
+			{
+				Node n;
+				n.first=first; n.last=last; n.child=-1;
+				n.center=Point3x(0,0,0); n.dipole=Point3x(0,0,0); n.radius=0;
+				double area=0;
+				Box3<double> box;
+				for(int i=first;i<last;++i)
+				{
+					const Point3x *t=&_tri[ind[i]*3];
+					const Point3x an=((t[1]-t[0])^(t[2]-t[0]))*0.5;
+					const double a=an.Norm();
+					n.dipole+=an;
+					n.center+=bar[ind[i]]*a;
+					area+=a;
+					box.Add(bar[ind[i]]);
+				}
+				n.center = (area>0) ? n.center/area : box.Center();
+				std::fill(n.moment,n.moment+9,0.0);
+				for(int i=first;i<last;++i)
+				{
+					const Point3x *t=&_tri[ind[i]*3];
+					const Point3x an=((t[1]-t[0])^(t[2]-t[0]))*0.5;
+					const Point3x off=bar[ind[i]]-n.center;
+					for(int j=0;j<3;++j)
+					{
+						for(int k=0;k<3;++k) n.moment[j*3+k]+=an[j]*off[k];
+						n.radius=std::max(n.radius,Distance(n.center,t[j]));
+					}
+				}
+				if(last-first>LeafSize)
+				{
+					const int mid=(first+last)/2;
+					std::nth_element(ind.begin()+first,ind.begin()+mid,ind.begin()+last,Compare(bar,box.MaxDim()));
+					n.child=int(_node.size());
+					_node.resize(_node.size()+2);
+					_node[ni]=n;
+					Build(ind,bar,n.child,first,mid);
+					Build(ind,bar,n.child+1,mid,last);
+				}
+				else _node[ni]=n;
+			}
+
+			// signed solid angle of the triangle abc (relative to the query point), Van Oosterom and Strackee
+			static double SolidAngle(const Point3x &a, const Point3x &b, const Point3x &c)
+			{
+				const double la=a.Norm(), lb=b.Norm(), lc=c.Norm();
+				const double det=a*(b^c);
+				const double div=la*lb*lc + (a*b)*lc + (b*c)*la + (c*a)*lb;
+				return 2.0*atan2(det,div);
+			}
+		};
 	}
 }
 
@@ -28,6 +28,8 @@
 #include<vcg/complex/algorithms/closest.h>
 #include<vcg/complex/algorithms/update/quality.h>
 #include<vcg/complex/algorithms/update/selection.h>
+#include<vcg/space/index/aabb_binary_tree/base.h>
+#include<wrap/utils.h>
 
 
 #ifndef __VCGLIB_INTERSECTION_TRI_MESH
@@ -200,6 +202,335 @@ bool IntersectionPlaneMesh(TriMeshType & m,
   return true;
 }
 
+/** \addtogroup complex */
+/*@{*/
+/** \brief Slice a trimesh with a set of parallel planes building an edge mesh.
+ *
+ * The k-th plane is made of the points p with dir*p == offsets[k]; the offsets must be sorted in increasing order.
+ * Instead of intersecting all the faces with each plane, the faces are sorted once by their minimum height
+ * and the planes are swept keeping the set of the faces that span the current plane, so that the cost is
+ * O(F log F + output). The planes are split in ranges of consecutive planes that are swept in parallel.
+ *
+ * The segments of the k-th plane are the edges [layerStart[k], layerStart[k+1]) of em. As in IntersectionPlaneMesh()
+ * each segment has its own two vertices, but the crossing point of a mesh edge is computed in the same way
+ * by its two faces, so Clean::RemoveDuplicateVertex() joins the segments of each layer into polylines.
+ * The output does not depend on the number of threads.
+ */
+template < typename  TriMeshType, typename EdgeMeshType, class ScalarType >
+bool IntersectionPlanesMesh(TriMeshType & m,
+                            const Point3<ScalarType> & dir,
+                            const std::vector<ScalarType> & offsets,
+                            EdgeMeshType & em,
+                            std::vector<int> & layerStart)
+{
+  typedef typename TriMeshType::VertexType VertexType;
+  typedef typename TriMeshType::FaceType FaceType;
+  typedef Point3<ScalarType> PointType;
+  class LayerPoint
+  {
+  public:
+    PointType p,n;
+  };
+
+  const int planeNum=int(offsets.size());
+  em.Clear();
+  layerStart.assign(planeNum+1,0);
+  if(planeNum==0) return false;
+  for(int k=1;k<planeNum;++k) assert(offsets[k-1]<=offsets[k]);
+  const bool hasNormal=HasPerVertexNormal(m) && HasPerVertexNormal(em);
+
+  std::vector<ScalarType> h(m.vert.size());
+  for(size_t i=0;i<m.vert.size();++i)
+    if(!m.vert[i].IsD()) h[i]=dir*PointType::Construct(m.vert[i].cP());
+
+  // faces sorted by min height (ties by index, to keep the order deterministic)
+  std::vector<std::pair<ScalarType,int> > sorted;
+  std::vector<ScalarType> fMax(m.face.size());
+  sorted.reserve(m.fn);
+  for(size_t i=0;i<m.face.size();++i)
+    if(!m.face[i].IsD())
+    {
+      ScalarType lo=h[tri::Index(m,m.face[i].cV(0))];
+      fMax[i]=lo;
+      for(int j=1;j<3;++j)
+      {
+        const ScalarType hj=h[tri::Index(m,m.face[i].cV(j))];
+        lo=std::min(lo,hj); fMax[i]=std::max(fMax[i],hj);
+      }
+      sorted.push_back(std::make_pair(lo,int(i)));
+    }
+  std::sort(sorted.begin(),sorted.end());
+  const int sortedNum=int(sorted.size());
+
+  // the planes are split in ranges; a first serial sweep finds the active set at the first plane of each range
+  const int rangeSize=std::max(1,planeNum/64);
+  const int rangeNum=(planeNum+rangeSize-1)/rangeSize;
+  std::vector<std::vector<int> > rangeActive(rangeNum);
+  std::vector<int> rangeNext(rangeNum);
+  {
+    std::vector<int> active;
+    int next=0;
+    for(int r=0;r<rangeNum;++r)
+    {
+      const ScalarType o=offsets[r*rangeSize];
+      while(next<sortedNum && sorted[next].first<=o) active.push_back(sorted[next++].second);
+      size_t cnt=0;
+      for(size_t i=0;i<active.size();++i)
+        if(fMax[active[i]]>=o) active[cnt++]=active[i];
+      active.resize(cnt);
+      rangeActive[r]=active;
+      rangeNext[r]=next;
+    }
+  }
+
+  std::vector<std::vector<LayerPoint> > layerPts(planeNum);
+#pragma omp parallel for schedule(dynamic,1)
+  for(int r=0;r<rangeNum;++r)
+  {
+    std::vector<int> &active=rangeActive[r];
+    int next=rangeNext[r];
+    const int last=std::min(planeNum,(r+1)*rangeSize);
+    for(int k=r*rangeSize;k<last;++k)
+    {
+      const ScalarType o=offsets[k];
+      while(next<sortedNum && sorted[next].first<=o) active.push_back(sorted[next++].second);
+      size_t cnt=0;
+      for(size_t i=0;i<active.size();++i)
+        if(fMax[active[i]]>=o) active[cnt++]=active[i];
+      active.resize(cnt);
+
+      std::vector<LayerPoint> &pts=layerPts[k];
+      for(size_t i=0;i<active.size();++i)
+      {
+        const FaceType &f=m.face[active[i]];
+        LayerPoint lp[2];
+        int ptNum=0;
+        for(int j=0;j<3 && ptNum<2;++j)
+        {
+          // the edge is always taken in the same direction, so both its faces get the same point
+          const VertexType *v0=f.cV0(j), *v1=f.cV1(j);
+          if(v1<v0) std::swap(v0,v1);
+          const ScalarType q0=h[tri::Index(m,v0)]-o;
+          const ScalarType q1=h[tri::Index(m,v1)]-o;
+          if(q0*q1<0)
+          {
+            const PointType p0=PointType::Construct(v0->cP()), p1=PointType::Construct(v1->cP());
+            lp[ptNum].p=p0+(p1-p0)*(q0/(q0-q1));
+            if(hasNormal)
+              lp[ptNum].n=(PointType::Construct(v0->cN())*math::Abs(q1)+PointType::Construct(v1->cN())*math::Abs(q0))/math::Abs(q0-q1);
+            ++ptNum;
+          }
+          if(ptNum<2 && h[tri::Index(m,f.cV(j))]==o)
+          {
+            lp[ptNum].p=PointType::Construct(f.cV(j)->cP());
+            if(hasNormal) lp[ptNum].n=PointType::Construct(f.cV(j)->cN());
+            ++ptNum;
+          }
+        }
+        if(ptNum==2)
+        {
+          pts.push_back(lp[0]);
+          pts.push_back(lp[1]);
+        }
+      }
+    }
+  }
+
+  for(int k=0;k<planeNum;++k)
+    layerStart[k+1]=layerStart[k]+int(layerPts[k].size()/2);
+  const int edgeNum=layerStart[planeNum];
+  if(edgeNum==0) return true;
+  tri::Allocator<EdgeMeshType>::AddVertices(em,edgeNum*2);
+  tri::Allocator<EdgeMeshType>::AddEdges(em,edgeNum);
+#pragma omp parallel for schedule(dynamic,16)
+  for(int k=0;k<planeNum;++k)
+  {
+    for(int i=0;i<int(layerPts[k].size());++i)
+    {
+      const int vi=layerStart[k]*2+i;
+      em.vert[vi].P().Import(layerPts[k][i].p);
+      if(hasNormal) em.vert[vi].N().Import(layerPts[k][i].n);
+      em.edge[layerStart[k]+i/2].V(i%2)=&em.vert[vi];
+    }
+    std::vector<LayerPoint>().swap(layerPts[k]);
+  }
+  return true;
+}
+
+/** \brief Helper of IntersectionMeshMesh(): simultaneous traversal of the AABB trees of two meshes.
+ *
+ * The pairs of nodes with overlapping boxes are refined, always splitting the node with the larger box,
+ * until both are leaves; then the triangles of the two leaves are intersected.
+ * The first levels of the traversal are expanded serially into a list of independent node pairs,
+ * that are processed in parallel, each one collecting its segments in its own buffer.
+ */
+template < typename TriMeshType >
+class MeshMeshIntersection
+{
+public:
+  typedef typename TriMeshType::FaceType FaceType;
+  typedef typename TriMeshType::FacePointer FacePointer;
+  typedef typename TriMeshType::ScalarType ScalarType;
+  typedef typename TriMeshType::CoordType CoordType;
+  typedef AABBBinaryTree<FaceType, ScalarType, EmptyClass> TreeType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef std::pair<const NodeType *, const NodeType *> NodePair;
+
+  class IntersectionSegment
+  {
+  public:
+    CoordType p0,p1;
+    FacePointer f0,f1;
+  };
+
+  static void Build(TriMeshType &m, TreeType &tree)
+  {
+    std::vector<FacePointer> faceVec;
+    faceVec.reserve(m.fn);
+    for(size_t i=0;i<m.face.size();++i)
+      if(!m.face[i].IsD()) faceVec.push_back(&m.face[i]);
+    GetPointerFunctor getPtr;
+    GetBox3Functor getBox;
+    GetBarycenter3Functor getBarycenter;
+    // at most 10 faces per leaf, as in AABBBinaryTreeIndex::Set()
+    tree.Set(faceVec.begin(),faceVec.end(),getPtr,getBox,getBarycenter,10);
+  }
+
+  static bool Overlap(const NodeType *n0, const NodeType *n1)
+  {
+    for(int k=0;k<3;++k)
+      if(math::Abs(n0->boxCenter[k]-n1->boxCenter[k]) > n0->boxHalfDims[k]+n1->boxHalfDims[k]) return false;
+    return true;
+  }
+
+  /// Push the overlapping pairs obtained splitting the larger (non leaf) node of the pair. Returns false if both are leaves.
+  static bool Split(const NodePair &np, std::vector<NodePair> &out)
+  {
+    const NodeType *n0=np.first, *n1=np.second;
+    if(n0->IsLeaf() && n1->IsLeaf()) return false;
+    if(n1->IsLeaf() || (!n0->IsLeaf() && n0->boxHalfDims.SquaredNorm() >= n1->boxHalfDims.SquaredNorm()))
+    {
+      for(int c=0;c<2;++c)
+        if(n0->children[c]!=0 && Overlap(n0->children[c],n1)) out.push_back(NodePair(n0->children[c],n1));
+    }
+    else
+    {
+      for(int c=0;c<2;++c)
+        if(n1->children[c]!=0 && Overlap(n0,n1->children[c])) out.push_back(NodePair(n0,n1->children[c]));
+    }
+    return true;
+  }
+
+  static void IntersectLeaves(const NodeType *n0, const NodeType *n1, std::vector<IntersectionSegment> &segVec)
+  {
+    for(typename TreeType::ObjPtrVectorConstIterator fi0=n0->oBegin; fi0!=n0->oEnd; ++fi0)
+    {
+      const FaceType &f0=**fi0;
+      Box3<ScalarType> b0;
+      b0.Add(f0.cP(0)); b0.Add(f0.cP(1)); b0.Add(f0.cP(2));
+      for(typename TreeType::ObjPtrVectorConstIterator fi1=n1->oBegin; fi1!=n1->oEnd; ++fi1)
+      {
+        const FaceType &f1=**fi1;
+        Box3<ScalarType> b1;
+        b1.Add(f1.cP(0)); b1.Add(f1.cP(1)); b1.Add(f1.cP(2));
+        if(!b0.Collide(b1)) continue;
+        bool coplanar=false;
+        IntersectionSegment s;
+        if(tri_tri_intersect_with_isectline(f0.cP(0),f0.cP(1),f0.cP(2),f1.cP(0),f1.cP(1),f1.cP(2),coplanar,s.p0,s.p1) && !coplanar)
+        {
+          s.f0=*fi0; s.f1=*fi1;
+          segVec.push_back(s);
+        }
+      }
+    }
+  }
+
+  static void Traverse(const NodePair &np, std::vector<NodePair> &stack, std::vector<IntersectionSegment> &segVec)
+  {
+    stack.clear();
+    stack.push_back(np);
+    while(!stack.empty())
+    {
+      const NodePair cur=stack.back();
+      stack.pop_back();
+      if(!Split(cur,stack))
+        IntersectLeaves(cur.first,cur.second,segVec);
+    }
+  }
+
+  /// All the intersection segments between the faces of the two indexed meshes, in a order that does not depend on the number of threads.
+  static void Compute(const TreeType &tree0, const TreeType &tree1, std::vector<IntersectionSegment> &segVec, int minTaskNum=256)
+  {
+    segVec.clear();
+    const NodeType *r0=tree0.pRoot, *r1=tree1.pRoot;
+    if(r0==0 || r1==0 || !Overlap(r0,r1)) return;
+
+    // breadth first expansion of the top of the traversal; the pairs of leaves are kept as they are
+    std::vector<NodePair> taskVec(1,NodePair(r0,r1)), next;
+    bool refined=true;
+    while(refined && int(taskVec.size())<minTaskNum)
+    {
+      refined=false;
+      next.clear();
+      for(size_t i=0;i<taskVec.size();++i)
+      {
+        if(Split(taskVec[i],next)) refined=true;
+        else next.push_back(taskVec[i]);
+      }
+      taskVec.swap(next);
+    }
+
+    const int taskNum=int(taskVec.size());
+    std::vector<std::vector<IntersectionSegment> > taskSeg(taskNum);
+#pragma omp parallel
+    {
+      std::vector<NodePair> stack;
+#pragma omp for schedule(dynamic,1)
+      for(int i=0;i<taskNum;++i)
+        Traverse(taskVec[i],stack,taskSeg[i]);
+    }
+    for(int i=0;i<taskNum;++i)
+      segVec.insert(segVec.end(),taskSeg[i].begin(),taskSeg[i].end());
+  }
+};
+
+/** \brief Compute the intersection curve between two trimeshes building an edge mesh.
+ *
+ * The faces of the two meshes are indexed with two AABBBinaryTree that are traversed together
+ * (see MeshMeshIntersection) to find, in parallel, all the pairs of intersecting triangles.
+ * As in IntersectionPlaneMesh() each intersecting pair gives a segment with its own two vertices
+ * (use Clean::RemoveDuplicateVertex() to join them); pairs of coplanar triangles are skipped.
+ * If facePairs is not null, for each edge it gets the indexes of the two faces, so that the faces
+ * crossed by the curve can be used as a pre-pass of boolean operations.
+ * The output does not depend on the number of threads.
+ */
+template < typename  TriMeshType, typename EdgeMeshType >
+bool IntersectionMeshMesh(TriMeshType & m0,
+                          TriMeshType & m1,
+                          EdgeMeshType & em,
+                          std::vector<std::pair<int,int> > *facePairs=0)
+{
+  typedef MeshMeshIntersection<TriMeshType> MMI;
+  typename MMI::TreeType tree0,tree1;
+  MMI::Build(m0,tree0);
+  MMI::Build(m1,tree1);
+  std::vector<typename MMI::IntersectionSegment> segVec;
+  MMI::Compute(tree0,tree1,segVec);
+
+  em.Clear();
+  if(facePairs) facePairs->resize(segVec.size());
+  if(segVec.empty()) return false;
+  typename EdgeMeshType::VertexIterator vi=tri::Allocator<EdgeMeshType>::AddVertices(em,segVec.size()*2);
+  typename EdgeMeshType::EdgeIterator ei=tri::Allocator<EdgeMeshType>::AddEdges(em,segVec.size());
+  for(size_t i=0;i<segVec.size();++i,++ei)
+  {
+    (*vi).P().Import(segVec[i].p0); (*ei).V(0)=&*vi; ++vi;
+    (*vi).P().Import(segVec[i].p1); (*ei).V(1)=&*vi; ++vi;
+    if(facePairs) (*facePairs)[i]=std::make_pair(int(tri::Index(m0,segVec[i].f0)),int(tri::Index(m1,segVec[i].f1)));
+  }
+  return true;
+}
+
 
 /** \addtogroup complex */
 /*@{*/
@@ -403,13 +734,24 @@ void IntersectionBallMesh( IndexingType * grid,	 TriMeshType & m, const vcg::Sph
 
 	if(tol == 0) tol = M_PI * ball.Radius() * ball.Radius() / 100000;
 
-	vcg::tri::GetInSphereFaceBase(m,*grid, ball.Center(), ball.Radius(),closestsF,distances,witnesses);
+	// the query does not use the mesh marks, so many balls can be intersected concurrently
+	tri::FaceLocalTmark<TriMeshType> mf;
+	vcg::face::PointDistanceBaseFunctor<ScalarType> fn;
+	grid->GetInSphere(fn,mf, ball.Center(), ball.Radius(),closestsF,distances,witnesses);
 	for(cfi =closestsF.begin(); cfi != closestsF.end(); ++cfi)
 	if(!(**cfi).IsD() && IntersectionSphereTriangle<ScalarType>(ball  ,(**cfi), witness , &info))
 		closests.push_back(&(**cfi));
+	std::sort(closests.begin(),closests.end()); // same face order of the mesh, as the version without grid
 
 	res.Clear();
-	SubSet(res,closests);
+	v0 = vcg::tri::Allocator<TriMeshType>::AddVertices(res,closests.size()*3);
+	fi = vcg::tri::Allocator<TriMeshType>::AddFaces(res,closests.size());
+	for(cfi =closests.begin(); cfi != closests.end(); ++cfi,++fi)
+		for(int k=0;k<3;++k,++v0)
+		{
+			(*v0).P() = (**cfi).P(k);
+			(*fi).V(k) = &(*v0);
+		}
 	int i =0;
 	while(i<res.fn){
 		 bool allIn = ( ball.IsIn(res.face[i].P(0)) && ball.IsIn(res.face[i].P(1))&&ball.IsIn(res.face[i].P(2)));
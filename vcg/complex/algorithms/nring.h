@@ -25,6 +25,7 @@
 
 #include <vcg/simplex/face/jumping_pos.h>
 #include <vcg/complex/algorithms/update/flag.h>
+#include <unordered_set>
 
 namespace vcg
 {
@@ -150,5 +151,93 @@ public:
     }
 };
 
+/** Same of Nring but it does not use the V flags of the mesh: visited elements are kept in a private set,
+ so that rings of different vertices can be expanded concurrently on the same mesh.
+ */
+template <class MeshType>
+class NringLocal
+{
+public:
+
+    typedef typename MeshType::FaceType   FaceType;
+    typedef typename MeshType::VertexType VertexType;
+
+    std::vector<VertexType*> allV;
+    std::vector<FaceType*> allF;
+
+    std::vector<VertexType*> lastV;
+    std::vector<FaceType*> lastF;
+
+    std::unordered_set<const void*> visited;
+
+    NringLocal(VertexType* v, MeshType* /*m*/ = 0)
+    {
+        insertAndFlag(v);
+    }
+
+    void insertAndFlag1Ring(VertexType* v)
+    {
+        insertAndFlag(v);
+
+        typename face::Pos<FaceType> p(v->VFp(),v);
+        assert(p.V() == v);
+
+        face::Pos<FaceType> ori = p;
+        do
+        {
+            insertAndFlag(p.F());
+            p.FlipF();
+            p.FlipE();
+        } while (ori != p);
+    }
+
+    void insertAndFlag(FaceType* f)
+    {
+        if (visited.insert(f).second)
+        {
+            allF.push_back(f);
+            lastF.push_back(f);
+            insertAndFlag(f->V(0));
+            insertAndFlag(f->V(1));
+            insertAndFlag(f->V(2));
+        }
+    }
+
+    void insertAndFlag(VertexType* v)
+    {
+        if (visited.insert(v).second)
+        {
+            allV.push_back(v);
+            lastV.push_back(v);
+        }
+    }
+
+    void clear()
+    {
+        allV.clear();
+        allF.clear();
+        visited.clear();
+    }
+
+    void expand()
+    {
+      std::vector<VertexType*> lastVtemp = lastV;
+
+        lastV.clear();
+        lastF.clear();
+
+        for(typename std::vector<VertexType*>::iterator it = lastVtemp.begin(); it != lastVtemp.end(); ++it)
+        {
+            insertAndFlag1Ring(*it);
+        }
+    }
+
+    void expand(int k)
+    {
+        for(int i=0;i<k;++i)
+            expand();
+    }
+};
+
 }} // end namespace NAMESPACE
 #endif // RINGWALKER_H
@@ -30,8 +30,6 @@
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/complex/algorithms/point_sampling.h>
 
-#include <qdatetime.h>
-
 using namespace std;
 using namespace vcg;
 
@@ -43,6 +41,12 @@ using namespace vcg;
  * and at the same time points' normals match quite well (i.e the angle between them is less then
  *  \c consensusNormalsAngle). The test to compute the overlap is perfomed on a given number of points
  * (2500 is the default) sampled in a normal equalized way (default) or uniformly.
+ *
+ * The grid on \c mFix is built once by Init() and kept until a different fix mesh is set, and the samples of \c mMov
+ * are drawn once (with the \c randSeed generator, so the results are reproducible) and reused by every Check(); this way
+ * many transformations can be scored against the same pair of meshes paying only the consensus test, either one at a time
+ * (the samples are tested in parallel) or with CheckBatch() (the transformations are tested in parallel).
+ * Call Resample() to draw a new set of samples.
  * \author Francesco Tonarelli
  */
 template<class MESH_TYPE> class OverlapEstimation
@@ -60,23 +64,6 @@ template<class MESH_TYPE> class OverlapEstimation
     typedef GridStaticPtr<VertexType, ScalarType > MeshGrid;
     typedef tri::EmptyTMark<MeshType> MarkerVertex;
 
-    private:
-    /** Private simple class needed to perform sampling of pointers to vertexes. */
-    class VertexPointerSampler
-    {
-        public:
-
-        MeshType* m;  //this is needed for advanced sampling (i.e poisson sampling)
-
-        VertexPointerSampler(){ m = new MeshType(); m->Tr.SetIdentity(); m->sfn=0; }
-        ~VertexPointerSampler(){ if(m) delete m; }
-        vector<VertexType*> sampleVec;
-
-        void AddVert(VertexType &p){ sampleVec.push_back(&p); } //this function is the only we really need
-        void AddFace(const FaceType &f, const CoordType &p){}
-        void AddTextureSample(const FaceType &, const CoordType &, const Point2i &){}
-    };
-
     public:
     /** \brief Public class to hold parameters. Used to avoid endless list of parameters inside functions.
       * \author Francesco Tonarelli
@@ -91,6 +78,7 @@ template<class MESH_TYPE> class OverlapEstimation
         float threshold;                                ///< Consensus percentage requested to win consensus. Used to paint \c mMov. If the overlap overcames the \c threshold (and \c bestScore), \c mMov is painted.
         bool normalEqualization;                        ///< Allows to use normal equalization sampling in consensus. If set to \c false uniform sampling is used instead. Uniform sampling is faster but less accurate.
         bool paint;                                     ///< Allows painting of \c mMov according to consensus. See Paint() for details.
+        unsigned int randSeed;                          ///< Seed of the generator used to choose the samples.
         void (*log)(int level, const char * f, ... );   ///< Pointer to a log function.
 
         /** Constructor with default values. */
@@ -103,6 +91,7 @@ template<class MESH_TYPE> class OverlapEstimation
             threshold = 0.0f;
             normalEqualization = true;
             paint = false;
+            randSeed = 0;
             log = NULL;
         }
     };
@@ -110,22 +99,33 @@ template<class MESH_TYPE> class OverlapEstimation
     private:
     MeshType* mFix;                             /** Pointer to mesh \c mFix. */
     MeshType* mMov;                             /** Pointer to mesh \c mMov. */
+    Matrix44<ScalarType> fixTr;                 /** Placement of \c mFix. */
+    Matrix44<ScalarType> movTr;                 /** Placement of \c mMov. */
     vector<vector<int> >* normBuckets;          //structure to hold normals bucketing. Needed for normal equalized sampling during consensus
     MeshGrid* gridFix;                          //variable to manage uniform grid
+    MeshType* gridMesh;                         //mesh indexed by gridFix
     MarkerVertex markerFunctorFix;              //variable to manage uniform grid
+    math::SubtractiveRingRNG rnd;               //generator used for sampling
+    vector<VertexPointer> queryVert;            //cached samples of mMov, used as query points
+    vector<CoordType> queryPnt;                 //their positions and normals
+    vector<CoordType> queryNrm;
 
     public:
     /** Default constructor. */
-    OverlapEstimation() : normBuckets(NULL), gridFix(NULL){}
+    OverlapEstimation() : mFix(NULL), mMov(NULL), normBuckets(NULL), gridFix(NULL), gridMesh(NULL){ fixTr.SetIdentity(); movTr.SetIdentity(); }
     /** Default destructor. Deallocates structures. */
     ~OverlapEstimation(){
         if(normBuckets) delete normBuckets;
         if(gridFix) delete gridFix;
     }
-    /** Set the fix mesh \c mFix. */
-    void SetFix(MeshType& m){ mFix = &m; }
-    /** Set the move mesh \c mMov. */
-    void SetMove(MeshType& m){ mMov = &m; }
+    /** Set the fix mesh \c mFix and its placement. The grid is rebuilt by the next Init() only if the mesh changes. */
+    void SetFix(MeshType& m, const Matrix44<ScalarType>& tr=Matrix44<ScalarType>::Identity()){ mFix = &m; fixTr = tr; }
+    /** Set the move mesh \c mMov and its placement. */
+    void SetMove(MeshType& m, const Matrix44<ScalarType>& tr=Matrix44<ScalarType>::Identity()){ mMov = &m; movTr = tr; queryVert.clear(); }
+    /** Change the placement of \c mMov (the samples are kept). */
+    void SetMoveTr(const Matrix44<ScalarType>& tr){ movTr = tr; }
+    /** Discard the grid on \c mFix (e.g. because its vertices have been changed); it is rebuilt by the next Init(). */
+    void ClearFixGrid(){ if(gridFix) delete gridFix; gridFix = NULL; gridMesh = NULL; }
 
     /** Paint \c mMov according to the overlap estimation result. Works only if \c Compute() or \c Check() have
      *  been previously called with \c Parameters.paint=true .<br>Legend: \arg \e red: points overlaps correctly.
@@ -147,20 +147,47 @@ template<class MESH_TYPE> class OverlapEstimation
      *  \return \c true if everything goes right.
      */
     bool Init(Parameters& param){
-        //builds the uniform grid with mFix vertices
-        gridFix = new MeshGrid();
-        SetupGrid();
+        //builds the uniform grid with mFix vertices, unless it is already there
+        if(gridFix==NULL || gridMesh!=mFix){
+            ClearFixGrid();
+            gridFix = new MeshGrid();
+            SetupGrid();
+        }
 
         //if requested, group normals of mMov into 30 buckets. Buckets are used for Vertex Normal Equalization
         //in consensus. Bucketing is done here once for all to speed up consensus.
-        if(normBuckets) {normBuckets->clear(); delete normBuckets; }
+        if(normBuckets) {normBuckets->clear(); delete normBuckets; normBuckets = NULL; }
         if(param.normalEqualization){
             normBuckets = BucketVertexNormal(mMov->vert, 30);
             assert(normBuckets);
         }
+        Resample(param);
         return true;
     }
 
+    /** Draw a new set of samples of \c mMov, used as query points by the following calls of Check(). */
+    void Resample(Parameters& param)
+    {
+        rnd.initialize(param.randSeed);
+        queryVert.clear();
+        //if no buckets are provided get a vector of vertex pointers sampled uniformly
+        //else, get a vector of vertex pointers sampled in a normal equalized manner
+        if(param.normalEqualization){
+            assert(normBuckets);
+            for(unsigned int i=0; i<mMov->vert.size(); i++) queryVert.push_back(&(mMov->vert[i]));//do a copy of pointers to vertexes
+            SampleVertNormalEqualized(queryVert, param.samples);
+        }
+        else{
+            SampleVertUniform(*mMov, queryVert, param.samples);
+        }
+        queryPnt.resize(queryVert.size());
+        queryNrm.resize(queryVert.size());
+        for(size_t i=0; i<queryVert.size(); i++){
+            queryPnt[i] = queryVert[i]->cP();
+            queryNrm[i] = queryVert[i]->cN();
+        }
+    }
+
     /** Compute the overlap estimation between \c mFix and \c mMov.
      *  @param param A reference to a \c Parameter class containing all the desidered options to estimate overlap.
      *  \return The percentage of overlap in the range \c [0..1] .
@@ -177,73 +204,93 @@ template<class MESH_TYPE> class OverlapEstimation
     //IMPORTANT: per vertex normals of mMov and mFix MUST BE PROVIDED YET NORMALIZED!!!
     int Check(Parameters& param)
     {
-        //pointer to a function to compute distance beetween points
-        vertex::PointDistanceFunctor<ScalarType> PDistFunct;
+        return Check(param, movTr);
+    }
 
-        //if no buckets are provided get a vector of vertex pointers sampled uniformly
-        //else, get a vector of vertex pointers sampled in a normal equalized manner; used as query points
-        vector<VertexPointer> queryVert;
-        if(param.normalEqualization){
-            assert(normBuckets);
-            for(unsigned int i=0; i<mMov->vert.size(); i++) queryVert.push_back(&(mMov->vert[i]));//do a copy of pointers to vertexes
-            SampleVertNormalEqualized(queryVert, param.samples);
-        }
-        else{
-            SampleVertUniform(*mMov, queryVert, param.samples);
+    /** As Check(Parameters&), but \c mMov is placed with the matrix \c tr instead of the one given to SetMove() .
+     *  The samples are tested in parallel.
+     */
+    int Check(Parameters& param, const Matrix44<ScalarType>& tr)
+    {
+        if(queryVert.empty() || (int(queryVert.size())!=param.samples && int(queryVert.size())<mMov->vn-1)) Resample(param);
+        assert(queryVert.size()!=0);
+
+        int cons_succ = int(param.threshold*(param.samples/100.0f));      //score needed to pass consensus
+        int consensus = CountConsensus(param, tr, param.paint);
+
+        //Paint the mesh only if required and if consensus is the best ever found. Colors have been stores as numbers into quality attribute
+        if(param.paint){
+            if(consensus>=param.bestScore && consensus>=cons_succ) Paint();
         }
+
+        return consensus;
+    }
+
+    /** Score many placements of \c mMov at once: \c scoreVec[i] is the result of Check() with the matrix \c trVec[i] .
+     *  The transformations are tested in parallel, all with the same samples; \c mMov is not painted.
+     */
+    void CheckBatch(Parameters& param, const vector<Matrix44<ScalarType> >& trVec, vector<int>& scoreVec)
+    {
+        if(queryVert.empty() || (int(queryVert.size())!=param.samples && int(queryVert.size())<mMov->vn-1)) Resample(param);
         assert(queryVert.size()!=0);
+        scoreVec.resize(trVec.size());
+        const int trNum = int(trVec.size());
+        #pragma omp parallel for schedule(dynamic,1)
+        for(int i=0; i<trNum; i++)
+            scoreVec[i] = CountConsensus(param, trVec[i], false, false);
+    }
+
+    private:
+    /** Count the samples in consensus with \c mMov placed by \c tr ; if \c paint the consensus class of each sample
+     *  is stored in its quality. If \c parallel the samples are tested concurrently.
+     */
+    int CountConsensus(const Parameters& param, const Matrix44<ScalarType>& tr, bool paint, bool parallel=true)
+    {
+        //pointer to a function to compute distance beetween points
+        vertex::PointDistanceFunctor<ScalarType> PDistFunct;
 
         //init variables for consensus
         float consDist = param.consensusDist*(mMov->bbox.Diag()/100.0f);  //consensus distance
-        int cons_succ = int(param.threshold*(param.samples/100.0f));      //score needed to pass consensus
+        Matrix44<ScalarType> mat = Inverse(fixTr) * tr;                   //matrix to bring mMov coords in mFix coords space
+        Matrix33<ScalarType> inv33_matMov(tr,3);                          //3x3 matrix needed to transform normals
+        Matrix33<ScalarType> inv33_matFix(Inverse(fixTr),3);              //3x3 matrix needed to transform normals
+        Matrix33<ScalarType> mat33 = inv33_matFix * inv33_matMov;
+        const int sampleNum = int(queryPnt.size());
         int consensus = 0;                  //counts vertices in consensus
-        float dist;                         //holds the distance of the closest vertex found
-        VertexType* closestVertex = NULL;   //pointer to the closest vertex
-        Point3<ScalarType> queryNrm;        //the query point normal for consensus
-        CoordType queryPnt;                 //the query point for consensus
-        CoordType closestPnt;               //the closest point found in consensus
-        Matrix33<ScalarType> inv33_matMov(mMov->Tr,3);          //3x3 matrix needed to transform normals
-        Matrix33<ScalarType> inv33_matFix(Inverse(mFix->Tr),3); //3x3 matrix needed to transform normals
 
         //consensus loop
-        VertexPointerIterator vi; int i;
-        for(i=0, vi=queryVert.begin(); vi!=queryVert.end(); vi++, i++)
+        #pragma omp parallel for reduction(+:consensus) schedule(dynamic,64) if(parallel)
+        for(int i=0; i<sampleNum; i++)
         {
-            dist = -1.0f;
+            float dist = -1.0f;                 //holds the distance of the closest vertex found
+            VertexType* closestVertex = NULL;   //pointer to the closest vertex
+            CoordType closestPnt;               //the closest point found in consensus
             //set query point; vertex coord is transformed properly in fix mesh coordinates space; the same for normals
-            queryPnt = Inverse(mFix->Tr) * (mMov->Tr * (*vi)->P());
-            queryNrm = inv33_matFix * (inv33_matMov * (*vi)->N());
+            CoordType qPnt = mat * queryPnt[i];
+            Point3<ScalarType> qNrm = mat33 * queryNrm[i];
             //if query point is bbox, the look for a vertex in cDist from the query point
-            if(mFix->bbox.IsIn(queryPnt)) closestVertex = gridFix->GetClosest(PDistFunct,markerFunctorFix,queryPnt,consDist,dist,closestPnt);
-            else closestVertex=NULL;  //out of bbox, we consider the point not in consensus...
+            if(mFix->bbox.IsIn(qPnt)) closestVertex = gridFix->GetClosest(PDistFunct,markerFunctorFix,qPnt,consDist,dist,closestPnt);
 
             if(closestVertex!=NULL && dist < consDist){
                 assert(closestVertex->P()==closestPnt); //coord and vertex pointer returned by getClosest must be the same
 
                 //point is in consensus distance, now we check if normals are near
-                if(queryNrm.dot(closestVertex->N())>param.consensusNormalsAngle)  //15 degrees
+                if(qNrm.dot(closestVertex->N())>param.consensusNormalsAngle)  //15 degrees
                 {
                     consensus++;  //got consensus
-                    if(param.paint) (*vi)->Q() = 0.0f;  //store 0 as quality
+                    if(paint) queryVert[i]->Q() = 0.0f;  //store 0 as quality
                 }
                 else{
-                    if(param.paint) (*vi)->Q() = 1.0f;  //store 1 as quality
+                    if(paint) queryVert[i]->Q() = 1.0f;  //store 1 as quality
                 }
             }
             else{
-                if(param.paint) (*vi)->Q() = 2.0f;  //store 2 as quality
+                if(paint) queryVert[i]->Q() = 2.0f;  //store 2 as quality
             }
         }
-
-        //Paint the mesh only if required and if consensus is the best ever found. Colors have been stores as numbers into quality attribute
-        if(param.paint){
-            if(consensus>=param.bestScore && consensus>=cons_succ) Paint();
-        }
-
         return consensus;
     }
 
-    private:
     /** Fill the vector \c vert with \c sampleNum pointers to vertexes sampled uniformly from mesh \c m .
       * @param m Source mesh.
       * @param vert Destination vector.
@@ -251,9 +298,15 @@ template<class MESH_TYPE> class OverlapEstimation
       */
     void SampleVertUniform(MESH_TYPE& m, vector<typename MESH_TYPE::VertexPointer>& vert, int sampleNum)
     {
-        VertexPointerSampler sampler;
-        tri::SurfaceSampling<MeshType, VertexPointerSampler>::VertexUniform(m, sampler, sampleNum);
-        for(unsigned int i=0; i<sampler.sampleVec.size(); i++) vert.push_back(sampler.sampleVec[i]);
+        vector<VertexPointer> all;
+        for(VertexIterator vi=m.vert.begin(); vi!=m.vert.end(); vi++)
+            if(!(*vi).IsD()) all.push_back(&*vi);
+        if(sampleNum > int(all.size())) sampleNum = int(all.size());
+        //partial shuffle with the generator of this instance, so that the samples depend only on the seed
+        for(int i=0; i<sampleNum; i++){
+            swap(all[i], all[i+LocRnd(int(all.size())-i)]);
+            vert.push_back(all[i]);
+        }
     }
     /** Buckets normals of the vertexes contained in \c vert .
       * \return A vector of vectors containing indexes to \c vert .
@@ -261,7 +314,7 @@ template<class MESH_TYPE> class OverlapEstimation
     vector<vector<int> >* BucketVertexNormal(typename MESH_TYPE::VertContainer& vert, int bucketDim = 30)
     {
         static vector<Point3f> NV;
-        if(NV.size()==0) GenNormal<float>::Uniform(bucketDim,NV);
+        if(NV.size()==0) GenNormal<float>::Fibonacci(bucketDim,NV);
 
         vector<vector<int> >* BKT = new vector<vector<int> >(NV.size()); //NV size is greater then bucketDim, so don't change this!
 
@@ -302,24 +355,18 @@ template<class MESH_TYPE> class OverlapEstimation
         vert.resize(SampleNum);
         return true;
     }
-    /** Function to retrieve a static random number generator object.
-      * \return A \c SubtractiveRingRNG object.
-      */
-    static math::SubtractiveRingRNG &LocRnd(){
-        static math::SubtractiveRingRNG myrnd(time(NULL));
-        return myrnd;
-    }
-    /** Gets a random number in the interval \c [0..n] . Number is
-      * produced by a \c SubtractiveRingRNG object initialized once for all.
-      * \return A random number in the interval \c [0..n] .
+    /** Gets a random number in the interval \c [0..n) . Number is
+      * produced by the \c SubtractiveRingRNG object of this instance, seeded by Resample().
+      * \return A random number in the interval \c [0..n) .
       */
-    static int LocRnd(int n){
-        return LocRnd().generate(n);
+    int LocRnd(int n){
+        return rnd.generate(n);
     }
     /** Put \c mFix into a grid. */
     inline void SetupGrid()
     {
         gridFix->Set(mFix->vert.begin(),mFix->vert.end());
+        gridMesh = mFix;
         markerFunctorFix.SetMesh(mFix);
     }
 };
@@ -110,6 +110,181 @@ public:
     }
     //std::push_heap(heap.begin(),heap.end());
   }
+  /*! \brief Build, in parallel, the kNN graph of the mesh vertices.
+
+    The neighbours of vertex i farther than maxDist are discarded, the others are stored in knn[i*nn .. i*nn+nn)
+    (unused slots are set to -1). The KdTree query is thread-safe so the tree is shared among the threads.
+   */
+  static void ComputeKNNGraph(MeshType &m, int nn, ScalarType maxDist, KdTree<ScalarType> &tree, std::vector<int> &knn)
+  {
+    const ScalarType maxDistSquared = maxDist*maxDist;
+    const int vn=int(m.vert.size());
+    knn.assign(size_t(vn)*nn,-1);
+#pragma omp parallel for schedule(dynamic, 256)
+    for(int i=0;i<vn;++i)
+    {
+      typename KdTree<ScalarType>::PriorityQueue nq;
+      tree.doQueryK(m.vert[i].cP(),nn,nq);
+      int c=0;
+      for(int j=0;j<nq.getNofElements();++j)
+        if(nq.getWeight(j)<maxDistSquared)
+          knn[size_t(i)*nn+c++]=nq.getIndex(j);
+    }
+  }
+
+  /*! \brief Parallel version of ComputeUndirectedNormal working on a precomputed kNN graph.
+
+    The 3x3 symmetric eigenproblem of each vertex is solved with the closed form solver of Eigen.
+   */
+  static void ComputeUndirectedNormalParallel(MeshType &m, int nn, const std::vector<int> &knn)
+  {
+    const int vn=int(m.vert.size());
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      std::vector<CoordType> ptVec;
+      for(int j=0;j<nn && knn[size_t(i)*nn+j]>=0;++j)
+        ptVec.push_back(m.vert[knn[size_t(i)*nn+j]].cP());
+      if(ptVec.empty()) continue;
+      CoordType b;
+      Eigen::Matrix<ScalarType,3,3> covMat;
+      ComputeCovarianceMatrix(ptVec,b,covMat);
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix<ScalarType,3,3> > eig;
+      eig.computeDirect(covMat);
+      Eigen::Matrix<ScalarType,3,1> eval = eig.eigenvalues().cwiseAbs();
+      int minInd;
+      eval.minCoeff(&minInd);
+      m.vert[i].N()=CoordType(eig.eigenvectors()(0,minInd),eig.eigenvectors()(1,minInd),eig.eigenvectors()(2,minInd));
+    }
+  }
+
+  /*! \brief Parallel version of Smooth::VertexNormalPointCloud working on a precomputed kNN graph.
+   */
+  static void SmoothNormalParallel(MeshType &m, int nn, int iterNum, const std::vector<int> &knn)
+  {
+    const int vn=int(m.vert.size());
+    std::vector<CoordType> tmp(m.vert.size());
+    for(int ii=0;ii<iterNum;++ii)
+    {
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<vn;++i)
+      {
+        CoordType n(0,0,0);
+        for(int j=0;j<nn && knn[size_t(i)*nn+j]>=0;++j)
+        {
+          const CoordType &nj = m.vert[knn[size_t(i)*nn+j]].cN();
+          if(nj*m.vert[i].cN()>0) n+=nj;
+          else n-=nj;
+        }
+        tmp[i]=n;
+      }
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<vn;++i)
+        m.vert[i].N()=tmp[i].Normalize();
+    }
+  }
+
+  /*! \brief Consistently orient the normals along a maximum spanning forest of the kNN graph.
+
+    It is the parallel counterpart of the heap based propagation done in Compute():
+    arcs are weighted with |n_i*n_j| (arcs below 0.3 are discarded as in AddNeighboursToHeap) and
+    the maximum spanning forest is built with the Boruvka algorithm, whose edge scan runs in parallel.
+    Normals are then flipped visiting each tree from its lowest index vertex.
+   */
+  static void OrientNormalParallel(MeshType &m, int nn, const std::vector<int> &knn)
+  {
+    const int vn=int(m.vert.size());
+
+    // Symmetric adjacency of the kNN graph (CSR)
+    std::vector<int> start(m.vert.size()+1,0);
+    for(int i=0;i<vn;++i)
+      for(int j=0;j<nn;++j)
+      {
+        int k=knn[size_t(i)*nn+j];
+        if(k>=0 && k!=i) { ++start[i+1]; ++start[k+1]; }
+      }
+    for(int i=0;i<vn;++i) start[i+1]+=start[i];
+    std::vector<int> adj(start.back());
+    std::vector<int> pos(start.begin(),start.end()-1);
+    for(int i=0;i<vn;++i)
+      for(int j=0;j<nn;++j)
+      {
+        int k=knn[size_t(i)*nn+j];
+        if(k>=0 && k!=i) { adj[pos[i]++]=k; adj[pos[k]++]=i; }
+      }
+
+    // Boruvka: each round every component picks its best outgoing arc.
+    // Arcs are totally ordered (weight, then endpoint indexes) so no cycle can be formed.
+    std::vector<int> parent(m.vert.size()),label(m.vert.size());
+    for(int i=0;i<vn;++i) parent[i]=label[i]=i;
+    std::vector<int> bestArc(m.vert.size()),compArc(m.vert.size());
+    std::vector<std::pair<int,int> > treeArc;
+    while(true)
+    {
+#pragma omp parallel for schedule(dynamic, 1024)
+      for(int i=0;i<vn;++i)
+      {
+        bestArc[i]=-1;
+        for(int k=start[i];k<start[i+1];++k)
+          if(label[adj[k]]!=label[i] && ArcWeight(m,i,adj[k])>=0.3f)
+            if(bestArc[i]==-1 || ArcBetter(m,i,adj[k],i,adj[bestArc[i]]))
+              bestArc[i]=k;
+      }
+      std::fill(compArc.begin(),compArc.end(),-1);
+      bool found=false;
+      for(int i=0;i<vn;++i) if(bestArc[i]!=-1)
+      {
+        int &ca=compArc[label[i]];
+        if(ca==-1 || ArcBetter(m,i,adj[bestArc[i]],ArcSource(start,ca),adj[ca]))
+          ca=bestArc[i];
+        found=true;
+      }
+      if(!found) break;
+      for(int c=0;c<vn;++c) if(compArc[c]!=-1)
+      {
+        int a=ArcSource(start,compArc[c]), b=adj[compArc[c]];
+        int ra=FindRoot(parent,a), rb=FindRoot(parent,b);
+        if(ra!=rb)
+        {
+          parent[std::max(ra,rb)]=std::min(ra,rb);
+          treeArc.push_back(std::make_pair(a,b));
+        }
+      }
+      for(int i=0;i<vn;++i) label[i]=FindRoot(parent,i);
+    }
+
+    // Visit the forest and propagate the orientation
+    std::vector<int> tStart(m.vert.size()+1,0);
+    for(size_t i=0;i<treeArc.size();++i) { ++tStart[treeArc[i].first+1]; ++tStart[treeArc[i].second+1]; }
+    for(int i=0;i<vn;++i) tStart[i+1]+=tStart[i];
+    std::vector<int> tAdj(tStart.back());
+    std::copy(tStart.begin(),tStart.end()-1,pos.begin());
+    for(size_t i=0;i<treeArc.size();++i)
+    {
+      tAdj[pos[treeArc[i].first]++]=treeArc[i].second;
+      tAdj[pos[treeArc[i].second]++]=treeArc[i].first;
+    }
+    std::vector<char> visited(m.vert.size(),0);
+    std::vector<int> stack;
+    for(int r=0;r<vn;++r) if(!visited[r])
+    {
+      visited[r]=1;
+      stack.push_back(r);
+      while(!stack.empty())
+      {
+        int i=stack.back(); stack.pop_back();
+        for(int k=tStart[i];k<tStart[i+1];++k)
+          if(!visited[tAdj[k]])
+          {
+            VertexType &t=m.vert[tAdj[k]];
+            visited[tAdj[k]]=1;
+            if(m.vert[i].cN()*t.cN()<0.0f) t.N()=-t.N();
+            stack.push_back(tAdj[k]);
+          }
+      }
+    }
+  }
+
   /*! \brief parameters for the normal generation
    */
   struct Param
@@ -185,6 +360,69 @@ public:
     return;
   }
 
+  /*! \brief Parallel version of Compute().
+
+    The kNN queries, the plane fitting and the normal smoothing run in parallel over the vertices,
+    the kNN graph of the fitting is reused by the smoothing, and the orientation is propagated
+    along a maximum spanning forest computed with OrientNormalParallel().
+    Up to the orientation of each connected component the result is equivalent to Compute().
+   */
+  static void ComputeParallel(MeshType &m, Param p, vcg::CallBackPos * cb=0)
+  {
+    tri::Allocator<MeshType>::CompactVertexVector(m);
+    if(cb) cb(1,"Building KdTree...");
+    VertexConstDataWrapper<MeshType> DW(m);
+    KdTree<ScalarType> tree(DW);
+
+    std::vector<int> knn;
+    if(cb) cb(10,"Fitting planes");
+    ComputeKNNGraph(m, p.fittingAdjNum, std::numeric_limits<ScalarType>::max(), tree, knn);
+    ComputeUndirectedNormalParallel(m, p.fittingAdjNum, knn);
+    SmoothNormalParallel(m, p.fittingAdjNum, p.smoothingIterNum, knn);
+
+    if(p.coherentAdjNum==0) return;
+
+    if(p.useViewPoint)
+    {
+      const int vn=int(m.vert.size());
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<vn;++i)
+        if ( m.vert[i].N().dot(p.viewPoint- m.vert[i].P())<0.0f)
+          m.vert[i].N()=-m.vert[i].N();
+      return;
+    }
+
+    if(cb) cb(50,"Orienting normals");
+    ComputeKNNGraph(m, p.coherentAdjNum, std::numeric_limits<ScalarType>::max(), tree, knn);
+    OrientNormalParallel(m, p.coherentAdjNum, knn);
+  }
+
+private:
+  static float ArcWeight(MeshType &m, int a, int b)
+  {
+    return fabs(m.vert[a].cN()*m.vert[b].cN());
+  }
+
+  // Strict total order on the arcs: heavier first, then on the sorted endpoint indexes.
+  static bool ArcBetter(MeshType &m, int a0, int b0, int a1, int b1)
+  {
+    const float w0=ArcWeight(m,a0,b0), w1=ArcWeight(m,a1,b1);
+    if(w0!=w1) return w0>w1;
+    return std::make_pair(std::min(a0,b0),std::max(a0,b0)) < std::make_pair(std::min(a1,b1),std::max(a1,b1));
+  }
+
+  // Source vertex of the k-th entry of a CSR adjacency
+  static int ArcSource(const std::vector<int> &start, int k)
+  {
+    return int(std::upper_bound(start.begin(),start.end(),k)-start.begin())-1;
+  }
+
+  static int FindRoot(std::vector<int> &parent, int i)
+  {
+    while(parent[i]!=i) { parent[i]=parent[parent[i]]; i=parent[i]; }
+    return i;
+  }
+
 };
 }//end namespace vcg
 }//end namespace vcg
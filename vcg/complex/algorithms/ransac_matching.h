@@ -272,7 +272,11 @@ public:
       minFeatureDistancePerc = 4.0; // the distance between two chosen features must be  at least 4.0 * sampling distance 
       maxMatchingFeatureNum = 100;
       areaThrPerc = 20.0;    // Triplets that make small triangles are discarded 
-      
+      randSeed = 0;
+      iterBatchSize = 32;    // iterations whose triples are searched in parallel
+      hypothesisBatchSize = 256; // hypotheses whose matrices are computed and scored together
+      preemptiveSize = 50;   // number of samples used for the preemptive scoring of the hypotheses
+      preemptiveKeepRatio = 0.25; // fraction of the hypotheses of a batch that survive the preemptive scoring
     }
    
     ScalarType inlierRatioThr;
@@ -282,9 +286,14 @@ public:
     ScalarType samplingRadiusPerc;
     ScalarType samplingRadiusAbs;
     ScalarType areaThrPerc;
+    ScalarType preemptiveKeepRatio;
     int iterMax;
     int evalSize;
     int maxMatchingFeatureNum;
+    int randSeed;
+    int iterBatchSize;
+    int hypothesisBatchSize;
+    int preemptiveSize;
     
     ScalarType inlierSquareThr() const { return pow(samplingRadiusAbs* inlierDistanceThrPerc,2); }
   };
@@ -389,115 +398,211 @@ public:
     
   }
 
-  // The main loop. 
-  // Choose three points on mov that make a scalene triangle 
-  // and search on fix three other points with matchng distances 
-  
-  void Process_SearchEvaluateTriple (vector<Candidate> &cVec, Param &pp)
+  // The state of one iteration of the search: a scalene triangle of mov features, 
+  // the fix features matching each of its vertexes and the position of the enumeration of their triples.
+  class TripleQuery
+  {
+  public:
+    TripleQuery():valid(false),i(0),j(0),k(0) {}
+    bool valid;
+    int movInd[3];
+    ScalarType d01,d02,d12;
+    std::vector<int> fixFeatureVec[3];
+    int i,j,k;
+  };
+
+  // One iteration of the search.
+  // Choose three points on mov that make a scalene triangle and the features of fix matching them.
+  // Each iteration uses its own random stream (seeded by randSeed and by the iteration index) 
+  // so the iterations can be run in any order. 
+  void SearchTriple(int iter, TripleQuery &q, Param &pp)
   {
+    unsigned int key[2] = { (unsigned int)(pp.randSeed), (unsigned int)(iter) };
     math::MarsenneTwisterRNG rnd;
-//    ScalarType congruenceEps = pow(pp.samplingRadiusAbs * pp.congruenceThrPerc,2.0f);
+    rnd.initializeByArray(key,2);
     ScalarType congruenceEps = pp.samplingRadiusAbs * pp.congruenceThrPerc;
     ScalarType minFeatureDistEps = pp.samplingRadiusAbs * pp.minFeatureDistancePerc;
     ScalarType minAreaThr = pp.samplingRadiusAbs * pp.samplingRadiusAbs *pp.areaThrPerc;
+
+    q.valid=false;
+    // Choose a random pair of features from mov 
+    q.movInd[0] = rnd.generate(FS.mfNum());
+    q.movInd[1] = rnd.generate(FS.mfNum());
+    q.d01 = Distance(FS.mf(q.movInd[0]).P(),FS.mf(q.movInd[1]).P());
+    if( q.d01 <= minFeatureDistEps ) return;
+    q.movInd[2] = rnd.generate(FS.mfNum());
+    q.d02=Distance(FS.mf(q.movInd[0]).P(),FS.mf(q.movInd[2]).P());
+    q.d12=Distance(FS.mf(q.movInd[1]).P(),FS.mf(q.movInd[2]).P());
+    ScalarType areaTri = DoubleArea(Triangle3<ScalarType>(FS.mf(q.movInd[0]).P(), FS.mf(q.movInd[1]).P(), FS.mf(q.movInd[2]).P() ));
+    if( !(( q.d02 > minFeatureDistEps ) &&  // Sample are sufficiently distant
+          ( q.d12 > minFeatureDistEps ) && 
+          ( areaTri > minAreaThr) && 
+          ( fabs(q.d01-q.d02) > congruenceEps ) && // and they make a scalene triangle
+          ( fabs(q.d01-q.d12) > congruenceEps ) && 
+          ( fabs(q.d12-q.d02) > congruenceEps ) ) ) return;
+
+    // As a first Step we ask for three vectors of matching features;
+    for(int t=0;t<3;++t)
+      FS.getMatchingFixFeatureVec(FS.mf(q.movInd[t]), q.fixFeatureVec[t],pp.maxMatchingFeatureNum);
+    q.valid=true;
+  }
+
+  // Append to hVec up to maxNum candidates (without matrix) made by the triples of fix features 
+  // with distances matching the ones of the query, resuming the enumeration where the previous call left it. 
+  // Returns false when the triples are exhausted.
+  bool NextCongruentTriples(TripleQuery &q, std::vector<Candidate> &hVec, int maxNum, ScalarType congruenceEps, int &congrNum)
+  {
+    Candidate c;
+    for(int t=0;t<3;++t) c.movInd[t]=q.movInd[t];
+    for(; q.i<int(q.fixFeatureVec[0].size()); ++q.i, q.j=0)
+    { 
+      c.fixInd[0]=q.fixFeatureVec[0][q.i];
+      for(; q.j<int(q.fixFeatureVec[1].size()); ++q.j, q.k=0)
+      {               
+        c.fixInd[1]=q.fixFeatureVec[1][q.j];              
+        if(q.k==0) // the pair has not been checked yet
+        {
+          ScalarType m01 = Distance(FS.ff(c.fixInd[0]).P(),FS.ff(c.fixInd[1]).P());
+          if( !(fabs(m01-q.d01)<congruenceEps) ) continue;
+          ++congrNum;
+        }
+        for(; q.k<int(q.fixFeatureVec[2].size()); ++q.k)
+        { 
+          c.fixInd[2]=q.fixFeatureVec[2][q.k];
+          ScalarType m02=Distance(FS.ff(c.fixInd[0]).P(),FS.ff(c.fixInd[2]).P());
+          ScalarType m12=Distance(FS.ff(c.fixInd[1]).P(),FS.ff(c.fixInd[2]).P());
+          if( (fabs(m02-q.d02)<congruenceEps)  && (fabs(m12-q.d12)<congruenceEps ) )
+          {
+            hVec.push_back(c);
+            if(int(hVec.size())>=maxNum) { ++q.k; return true; }
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  // The main loop. 
+  // The triangles of a batch of iterBatchSize iterations are chosen in parallel (see SearchTriple).
+  // The congruent triples of each iteration are then enumerated in order, in batches of hypothesisBatchSize:
+  // the matrices of a batch are computed and scored in parallel on the first preemptiveSize samples,
+  // and only the best preemptiveKeepRatio fraction is evaluated (in parallel) with EvaluateMatrix. 
+  // The search stops after the batch in which 100 good candidates have been found.
+  // The result does not depend on the number of threads. 
+  
+  void Process_SearchEvaluateTriple (vector<Candidate> &cVec, Param &pp)
+  {
+    ScalarType congruenceEps = pp.samplingRadiusAbs * pp.congruenceThrPerc;
     printf("Starting search congruenceEps = samplingRadiusAbs * 3.0 = %6.2f \n",congruenceEps);
-    int iterCnt=0;
+    const int iterBatchSize = std::max(1,pp.iterBatchSize);
+    const int hypBatchSize = std::max(1,pp.hypothesisBatchSize);
+    const int preSize = std::min(pp.preemptiveSize,int(movConsensusVec.size()));
+    const ScalarType sqThr = pp.inlierSquareThr();
+    int congrNum=0;
+    int hypNum=0;
+    std::vector<Candidate> hVec;
     
-    while ( (iterCnt < pp.iterMax) && (cVec.size()<100) )
+    for(int iterCnt=0; (iterCnt < pp.iterMax) && (cVec.size()<100); iterCnt+=iterBatchSize)
     {
-      Candidate c;
-      // Choose a random pair of features from mov 
-      c.movInd[0] = rnd.generate(FS.mfNum());
-      c.movInd[1] = rnd.generate(FS.mfNum());
-      ScalarType d01 = Distance(FS.mf(c.movInd[0]).P(),FS.mf(c.movInd[1]).P());
-      if( d01 > minFeatureDistEps )
+      const int iterNum = std::min(iterBatchSize,pp.iterMax-iterCnt);
+      std::vector<TripleQuery> queryVec(iterNum);
+#pragma omp parallel for schedule(dynamic,1)
+      for(int i=0;i<iterNum;++i)
+        SearchTriple(iterCnt+i,queryVec[i],pp);
+      
+      for(int qi=0; qi<iterNum && (cVec.size()<100); ++qi)
       {
-        c.movInd[2] = rnd.generate(FS.mfNum());
-        ScalarType d02=Distance(FS.mf(c.movInd[0]).P(),FS.mf(c.movInd[2]).P());
-        ScalarType d12=Distance(FS.mf(c.movInd[1]).P(),FS.mf(c.movInd[2]).P());
-        ScalarType areaTri = DoubleArea(Triangle3<ScalarType>(FS.mf(c.movInd[0]).P(), FS.mf(c.movInd[1]).P(), FS.mf(c.movInd[2]).P() ));
-        if( ( d02 > minFeatureDistEps ) &&  // Sample are sufficiently distant
-            ( d12 > minFeatureDistEps ) && 
-            ( areaTri > minAreaThr) && 
-            ( fabs(d01-d02) > congruenceEps ) && // and they make a scalene triangle
-            ( fabs(d01-d12) > congruenceEps ) && 
-            ( fabs(d12-d02) > congruenceEps ) )
+        TripleQuery &q = queryVec[qi];
+        bool more = q.valid;
+        while(more && (cVec.size()<100))
         {
-          // Find a congruent triple on mov 
-          printf("Starting search of a [%i] congruent triple for %4i %4i %4i - %6.2f %6.2f %6.2f\n",
-                 iterCnt,c.movInd[0],c.movInd[1],c.movInd[2],d01,d02,d12);
-          // As a first Step we ask for three vectors of matching features;
+          hVec.clear();
+          more = NextCongruentTriples(q,hVec,hypBatchSize,congruenceEps,congrNum);
+          const int hNum = int(hVec.size());
+          if(hNum==0) break;
+          hypNum+=hNum;
           
-          std::vector<int> fixFeatureVec0; 
-          FS.getMatchingFixFeatureVec(FS.mf(c.movInd[0]), fixFeatureVec0,pp.maxMatchingFeatureNum);
-          std::vector<int> fixFeatureVec1; 
-          FS.getMatchingFixFeatureVec(FS.mf(c.movInd[1]), fixFeatureVec1,pp.maxMatchingFeatureNum);
-          std::vector<int> fixFeatureVec2; 
-          FS.getMatchingFixFeatureVec(FS.mf(c.movInd[2]), fixFeatureVec2,pp.maxMatchingFeatureNum);
+          // preemptive scoring; ties are broken by the index to keep the selection deterministic
+          std::vector<std::pair<int,int> > preScore(hNum);
+#pragma omp parallel for schedule(dynamic,16)
+          for(int i=0;i<hNum;++i)
+          {
+            hVec[i].Tr = GenerateMatchingMatrix(hVec[i],pp);
+            preScore[i] = std::make_pair(-CountInlier(hVec[i].Tr,0,preSize,sqThr),i);
+          }
+          std::sort(preScore.begin(),preScore.end());
+          const int keepNum = std::max(1,int(ceil(hNum*pp.preemptiveKeepRatio)));
+          std::vector<int> keepVec(keepNum);
+          for(int i=0;i<keepNum;++i)
+            keepVec[i]=preScore[i].second;
+          std::sort(keepVec.begin(),keepVec.end());
           
-          int congrNum=0;
-          int congrGoodNum=0;
-          for(int i=0;i<fixFeatureVec0.size();++i)
-          { 
-            if(cVec.size()>100) break;
-            c.fixInd[0]=fixFeatureVec0[i];
-            for(int j=0;j<fixFeatureVec1.size();++j)
-            {               
-              if(cVec.size()>100) break;             
-              c.fixInd[1]=fixFeatureVec1[j];              
-              ScalarType m01 = Distance(FS.ff(c.fixInd[0]).P(),FS.ff(c.fixInd[1]).P());
-              if( (fabs(m01-d01)<congruenceEps) )
-              {
-//                printf("- Found a congruent pair %i %i %6.2f\n", c.movInd[0],c.movInd[1], m01);                
-                ++congrNum;
-                for(int k=0;k<fixFeatureVec2.size();++k)
-                { 
-                  if(cVec.size()>100) break;                  
-                  c.fixInd[2]=fixFeatureVec2[k];
-                  ScalarType m02=Distance(FS.ff(c.fixInd[0]).P(),FS.ff(c.fixInd[2]).P());
-                  ScalarType m12=Distance(FS.ff(c.fixInd[1]).P(),FS.ff(c.fixInd[2]).P());
-                  if( (fabs(m02-d02)<congruenceEps)  && (fabs(m12-d12)<congruenceEps ) )
-                  {
-                    c.Tr = GenerateMatchingMatrix(c,pp);
-                    
-                    EvaluateMatrix(c,pp);
-                    if(c.err() > pp.inlierRatioThr ){
-                      printf("- - Found  %lu th good congruent triple %i %i %i -- %f / %i \n", cVec.size(), c.movInd[0],c.movInd[1],c.movInd[2],c.err(),pp.evalSize);
-//                      printf("      - %4.3f %4.3f %4.3f - %4.3f %4.3f %4.3f \n",
-//                             FS.ff(c.fixInd[0]).nd[0], FS.ff(c.fixInd[0]).nd[1], FS.ff(c.fixInd[0]).nd[2],
-//                             FS.mf(c.movInd[0]).nd[0], FS.mf(c.movInd[0]).nd[1],FS.mf(c.movInd[0]).nd[2]);
-                      
-                      ++congrGoodNum;                      
-                      cVec.push_back(c);
-                    }
-                  }
-                }
-              }                
+#pragma omp parallel for schedule(dynamic,1)
+          for(int i=0;i<keepNum;++i)
+            EvaluateMatrix(hVec[keepVec[i]],pp);
+          for(int i=0;i<keepNum;++i)
+          {
+            const Candidate &c = hVec[keepVec[i]];
+            if(c.err() > pp.inlierRatioThr ){
+              printf("- - Found  %lu th good congruent triple %i %i %i -- %f / %i \n", cVec.size(), c.movInd[0],c.movInd[1],c.movInd[2],c.err(),pp.evalSize);
+              cVec.push_back(c);
             }
           }
-          printf("Completed Search of congruent triple (found %i / %i good/congruent)\n",congrGoodNum,congrNum);
-        }               
+        }
       }
-      ++iterCnt;
-    } // end While
+    } // end for
 
-    printf("Found %lu candidates \n",cVec.size());
+    printf("Found %lu candidates (%i hypotheses from %i congruent pairs)\n",cVec.size(),hypNum,congrNum);
+    if(cVec.empty()) return;
     sort(cVec.begin(),cVec.end());
     printf("best candidate %f \n",cVec[0].err());
     
     pp.evalSize = FS.mfNum();
     
-    for(int i=0;i<cVec.size();++i)
+#pragma omp parallel for schedule(dynamic,1)
+    for(int i=0;i<int(cVec.size());++i)
       EvaluateMatrix(cVec[i],pp);
     
     sort(cVec.begin(),cVec.end());
     
     printf("After re-evaluation best is %f",cVec[0].err());
-        
-      
-    
   } // end Process
   
+  /**
+   * @brief CountInlier
+   * 
+   * Number of the (shuffled) mov samples in [first,last) that, transformed by Tr, 
+   * are closer than sqrt(sqThr) to a fix sample. 
+   * The samples are transformed in blocks with the affine part of Tr (the matrices are rigid) 
+   * by a plain loop that the compiler can vectorize, and then looked up in the kd-tree. 
+   */
+  int CountInlier(const Matrix44Type &Tr, int first, int last, ScalarType sqThr) const
+  {
+    const int BlockSize = 64;
+    ScalarType tx[BlockSize],ty[BlockSize],tz[BlockSize];
+    const ScalarType *m = Tr.V();
+    int inlierNum=0;
+    for(int b=first;b<last;b+=BlockSize)
+    {
+      const int n = std::min(BlockSize,last-b);
+      const Point3f *p = &movConsensusVec[b];
+      for(int i=0;i<n;++i)
+      {
+        tx[i] = m[0]*p[i][0] + m[1]*p[i][1] + m[2]*p[i][2] + m[3];
+        ty[i] = m[4]*p[i][0] + m[5]*p[i][1] + m[6]*p[i][2] + m[7];
+        tz[i] = m[8]*p[i][0] + m[9]*p[i][1] + m[10]*p[i][2] + m[11];
+      }
+      for(int i=0;i<n;++i)
+      {
+        unsigned int ind;
+        ScalarType squareDist;
+        consensusTree->doQueryClosest(CoordType(tx[i],ty[i],tz[i]),ind,squareDist);
+        if(squareDist < sqThr)
+          ++inlierNum;
+      }
+    }
+    return inlierNum;
+  }
   
   /**
    * @brief EvaluateMatrix
@@ -511,32 +616,17 @@ public:
    */
   void EvaluateMatrix(Candidate &c, Param &pp)
   {
-    c.inlierNum=0;
     c.evalSize=pp.evalSize;    
-    
     ScalarType sqThr = pp.inlierSquareThr();
     int mid = pp.evalSize/2;
-    uint ind;
-    ScalarType squareDist;
-    std::vector<Point3f>::iterator pi=movConsensusVec.begin();
-    
-    for(int j=0;j<2;++j)
+    c.inlierNum = CountInlier(c.Tr,0,mid,sqThr);
+    // Early bailout if after 1/2 of the test we have a very low consensus reject
+    if(c.inlierNum < mid/10)  
     {
-      for(int i=0;i<mid;++i)
-      {
-        Point3f qp = c.Tr*(*pi);
-        consensusTree->doQueryClosest(qp,ind,squareDist);
-        if(squareDist < sqThr)
-          ++c.inlierNum;
-        ++pi;
-      }
-      // Early bailout if after 1/2 of the test we have a very low consensus reject
-      if((j==0) && (c.inlierNum < mid/10))  
-      {
-        c.inlierNum *=2;
-        return;
-      }        
-    }
+      c.inlierNum *=2;
+      return;
+    }        
+    c.inlierNum += CountInlier(c.Tr,mid,2*mid,sqThr);
   }
   
   void DumpInlier(MeshType &m, Candidate &c, Param &pp)
@@ -402,6 +402,172 @@ static void VertexCoordTaubin(MeshType &m, int step, float lambda, float mu, boo
 }
 
 
+/// Sparse (CSR) form of the laplacian accumulated by AccumulateLaplacianInfo.
+/// For each vertex i the accumulated sum is \sum weight[k]*P[col[k]] for k in [start[i],start[i+1])
+/// and the accumulated count is cnt[i]. Vertices with an empty row are not moved.
+class LaplacianCSR
+{
+public:
+  std::vector<int> start;
+  std::vector<int> col;
+  std::vector<ScalarType> weight;
+  std::vector<ScalarType> cnt;
+};
+
+// Build the CSR laplacian with the same neighbourhood and weights used by AccumulateLaplacianInfo
+// (border vertices are averaged only with themselves and their border neighbours).
+// If hcFlag is true it builds instead the operator used by the HC smoothing, where every edge has unit weight
+// and border edges are counted twice.
+// Cotangent weights are computed once on the current geometry and then kept fixed.
+static void BuildLaplacianCSR(MeshType &m, LaplacianCSR &L, bool cotangentFlag=false, bool hcFlag=false)
+{
+  const int vn=int(m.vert.size());
+  std::vector<char> border(m.vert.size(),0);
+  if(!hcFlag)
+    for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
+      for(int j=0;j<3;++j) if((*fi).IsB(j))
+      {
+        border[tri::Index(m,(*fi).V0(j))]=1;
+        border[tri::Index(m,(*fi).V1(j))]=1;
+      }
+
+  // First pass count the entries of each row, second pass fill them.
+  std::vector<int> pos(m.vert.size()+1,0);
+  for(int pass=0;pass<2;++pass)
+  {
+    for(int i=0;i<vn;++i) if(border[i])
+    {
+      if(pass==1) { L.col[pos[i]]=i; L.weight[pos[i]]=1; }
+      ++pos[i];
+    }
+    for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
+      for(int j=0;j<3;++j)
+      {
+        const int a=int(tri::Index(m,(*fi).V0(j)));
+        const int b=int(tri::Index(m,(*fi).V1(j)));
+        ScalarType w=1;
+        if(hcFlag) { if((*fi).IsB(j)) w=2; }
+        else if(cotangentFlag && !(*fi).IsB(j))
+        {
+          ScalarType angle = Angle(fi->P1(j)-fi->P2(j),fi->P0(j)-fi->P2(j));
+          w = tan((M_PI*0.5) - angle);
+        }
+        const bool addA = hcFlag || (*fi).IsB(j) || !border[a];
+        const bool addB = hcFlag || (*fi).IsB(j) || !border[b];
+        if(addA) { if(pass==1) { L.col[pos[a]]=b; L.weight[pos[a]]=w; } ++pos[a]; }
+        if(addB) { if(pass==1) { L.col[pos[b]]=a; L.weight[pos[b]]=w; } ++pos[b]; }
+      }
+    if(pass==0)
+    {
+      L.start.assign(m.vert.size()+1,0);
+      for(int i=0;i<vn;++i) L.start[i+1]=L.start[i]+pos[i];
+      L.col.resize(L.start.back());
+      L.weight.resize(L.start.back());
+      std::copy(L.start.begin(),L.start.end(),pos.begin());
+    }
+  }
+
+  // Merge the duplicated entries (each interior edge is seen by two faces) so that the rows are shorter to stream.
+  std::vector<int> rowSize(m.vert.size());
+  L.cnt.assign(m.vert.size(),0);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for(int i=0;i<vn;++i)
+  {
+    std::vector<std::pair<int,ScalarType> > row;
+    for(int k=L.start[i];k<L.start[i+1];++k)
+      row.push_back(std::make_pair(L.col[k],L.weight[k]));
+    std::sort(row.begin(),row.end());
+    int k=L.start[i];
+    for(size_t r=0;r<row.size();++r)
+    {
+      if(r>0 && row[r].first==row[r-1].first) L.weight[k-1]+=row[r].second;
+      else { L.col[k]=row[r].first; L.weight[k]=row[r].second; ++k; }
+      L.cnt[i]+=row[r].second;
+    }
+    rowSize[i]=k-L.start[i];
+  }
+  std::vector<int> newStart(m.vert.size()+1,0);
+  for(int i=0;i<vn;++i) newStart[i+1]=newStart[i]+rowSize[i];
+  std::vector<int> newCol(newStart.back());
+  std::vector<ScalarType> newWeight(newStart.back());
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<vn;++i)
+  {
+    std::copy(L.col.begin()+L.start[i],L.col.begin()+L.start[i]+rowSize[i],newCol.begin()+newStart[i]);
+    std::copy(L.weight.begin()+L.start[i],L.weight.begin()+L.start[i]+rowSize[i],newWeight.begin()+newStart[i]);
+  }
+  L.start.swap(newStart);
+  L.col.swap(newCol);
+  L.weight.swap(newWeight);
+}
+
+// Sparse matrix-vector product: sum[i] = \sum_k weight[k]*src[col[k]]
+static void LaplacianCSRApply(const LaplacianCSR &L, const std::vector<CoordType> &src, std::vector<CoordType> &sum)
+{
+  const int vn=int(src.size());
+  sum.resize(src.size());
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<vn;++i)
+  {
+    CoordType s(0,0,0);
+    for(int k=L.start[i];k<L.start[i+1];++k)
+      s+=src[L.col[k]]*L.weight[k];
+    sum[i]=s;
+  }
+}
+
+// Parallel version of VertexCoordLaplacian.
+// The laplacian is built once as a CSR matrix and each step is a parallel sparse matrix-vector
+// product between two position buffers (Jacobi style, as the serial one).
+// With cotangentWeight the weights are computed only on the initial positions.
+static void VertexCoordLaplacianParallel(MeshType &m, int step, bool SmoothSelected=false, bool cotangentWeight=false, vcg::CallBackPos * cb=0)
+{
+  LaplacianCSR L;
+  BuildLaplacianCSR(m,L,cotangentWeight);
+  const int vn=int(m.vert.size());
+  std::vector<CoordType> pos(m.vert.size()),sum;
+  for(int i=0;i<vn;++i) pos[i]=m.vert[i].cP();
+  for(int s=0;s<step;++s)
+  {
+    if(cb)cb(100*s/step, "Classic Laplacian Smoothing");
+    LaplacianCSRApply(L,pos,sum);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+      if(L.cnt[i]>0 && (!SmoothSelected || m.vert[i].IsS()))
+        pos[i] = (pos[i] + sum[i])/(L.cnt[i]+1);
+  }
+  for(int i=0;i<vn;++i)
+    if(!m.vert[i].IsD()) m.vert[i].P()=pos[i];
+}
+
+// Parallel version of VertexCoordTaubin, see VertexCoordLaplacianParallel.
+static void VertexCoordTaubinParallel(MeshType &m, int step, float lambda, float mu, bool SmoothSelected=false, vcg::CallBackPos * cb=0)
+{
+  LaplacianCSR L;
+  BuildLaplacianCSR(m,L);
+  const int vn=int(m.vert.size());
+  std::vector<CoordType> pos(m.vert.size()),sum;
+  for(int i=0;i<vn;++i) pos[i]=m.vert[i].cP();
+  for(int s=0;s<step;++s)
+  {
+    if(cb) cb(100*s/step, "Taubin Smoothing");
+    for(int pass=0;pass<2;++pass)
+    {
+      const ScalarType k = (pass==0)?lambda:mu;
+      LaplacianCSRApply(L,pos,sum);
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<vn;++i)
+        if(L.cnt[i]>0 && (!SmoothSelected || m.vert[i].IsS()))
+        {
+          CoordType Delta = sum[i]/L.cnt[i] - pos[i];
+          pos[i] = pos[i] + Delta*k;
+        }
+    }
+  }
+  for(int i=0;i<vn;++i)
+    if(!m.vert[i].IsD()) m.vert[i].P()=pos[i];
+}
+
 static void VertexCoordLaplacianQuality(MeshType &m, int step, bool SmoothSelected=false)
 {
   LaplacianInfo lpz;
@@ -493,6 +659,38 @@ static void VertexCoordLaplacianHC(MeshType &m, int step, bool SmoothSelected=fa
         } // end for step
 };
 
+// Parallel version of VertexCoordLaplacianHC, built on the same CSR laplacian of VertexCoordLaplacianParallel.
+static void VertexCoordLaplacianHCParallel(MeshType &m, int step, bool SmoothSelected=false )
+{
+  const ScalarType beta=0.5;
+  LaplacianCSR L;
+  BuildLaplacianCSR(m,L,false,true);
+  const int vn=int(m.vert.size());
+  std::vector<CoordType> pos(m.vert.size()),avg,dif,tmp(m.vert.size());
+  for(int i=0;i<vn;++i) pos[i]=m.vert[i].cP();
+  for(int s=0;s<step;++s)
+  {
+    // First product compute the laplacian, second one the average difference
+    LaplacianCSRApply(L,pos,avg);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      if(L.cnt[i]>0) avg[i]/=L.cnt[i];
+      tmp[i]=avg[i]-pos[i];
+    }
+    LaplacianCSRApply(L,tmp,dif);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<vn;++i)
+      if(L.cnt[i]>0 && (!SmoothSelected || m.vert[i].IsS()))
+      {
+        dif[i]/=L.cnt[i];
+        pos[i]= avg[i] - (avg[i] - pos[i])*beta  + dif[i]*(1.f-beta);
+      }
+  }
+  for(int i=0;i<vn;++i)
+    if(!m.vert[i].IsD()) m.vert[i].P()=pos[i];
+}
+
 // Laplacian smooth of the quality.
 
 
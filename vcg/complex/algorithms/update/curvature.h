@@ -95,165 +95,184 @@ public:
     vcg::tri::UpdateNormal<MeshType>::PerVertexAngleWeighted(m);
     vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
-    for (VertexIterator vi =m.vert.begin(); vi !=m.vert.end(); ++vi) {
-      if ( ! (*vi).IsD() && (*vi).VFp() != NULL) {
+    for (VertexIterator vi =m.vert.begin(); vi !=m.vert.end(); ++vi)
+      if ( ! (*vi).IsD() && (*vi).VFp() != NULL)
+        PrincipalDirectionsSingleVertex(&*vi);
+  }
 
-        VertexType * central_vertex = &(*vi);
+  /// \brief Parallel version of PrincipalDirections().
+  /**
+   The estimation of each vertex only reads its one ring (through VF adjacency, no flags are used)
+   and writes its own curvature, so vertices are processed concurrently.
+   */
+  static void PrincipalDirectionsParallel(MeshType &m)
+  {
+    tri::RequireVFAdjacency(m);
+    vcg::tri::UpdateNormal<MeshType>::PerVertexAngleWeightedParallel(m);
+    vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
-        std::vector<float> weights;
-        std::vector<AdjVertex> vertices;
+    const int vn=int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i=0; i<vn; ++i)
+      if ( ! m.vert[i].IsD() && m.vert[i].VFp() != NULL)
+        PrincipalDirectionsSingleVertex(&m.vert[i]);
+  }
 
-        vcg::face::JumpingPos<FaceType> pos((*vi).VFp(), central_vertex);
+  /// \brief Compute the principal directions of a single vertex, see PrincipalDirections().
+  static void PrincipalDirectionsSingleVertex(VertexType *central_vertex)
+  {
+    std::vector<float> weights;
+    std::vector<AdjVertex> vertices;
 
-        // firstV is the first vertex of the 1ring neighboorhood
-        VertexType* firstV = pos.VFlip();
-        VertexType* tempV;
-        float totalDoubleAreaSize = 0.0f;
+    vcg::face::JumpingPos<FaceType> pos(central_vertex->VFp(), central_vertex);
 
-        // compute the area of each triangle around the central vertex as well as their total area
-        do
-        {
-          // this bring the pos to the next triangle  counterclock-wise
-          pos.FlipF();
-          pos.FlipE();
+    // firstV is the first vertex of the 1ring neighboorhood
+    VertexType* firstV = pos.VFlip();
+    VertexType* tempV;
+    float totalDoubleAreaSize = 0.0f;
 
-          // tempV takes the next vertex in the 1ring neighborhood
-          tempV = pos.VFlip();
-          assert(tempV!=central_vertex);
-          AdjVertex v;
+    // compute the area of each triangle around the central vertex as well as their total area
+    do
+    {
+      // this bring the pos to the next triangle  counterclock-wise
+      pos.FlipF();
+      pos.FlipE();
 
-          v.isBorder = pos.IsBorder();
-          v.vert = tempV;
-          v.doubleArea = vcg::DoubleArea(*pos.F());
-          totalDoubleAreaSize += v.doubleArea;
+      // tempV takes the next vertex in the 1ring neighborhood
+      tempV = pos.VFlip();
+      assert(tempV!=central_vertex);
+      AdjVertex v;
 
-          vertices.push_back(v);
-        }
-        while(tempV != firstV);
-
-        // compute the weights for the formula computing matrix M
-        for (size_t i = 0; i < vertices.size(); ++i) {
-          if (vertices[i].isBorder) {
-            weights.push_back(vertices[i].doubleArea / totalDoubleAreaSize);
-          } else {
-            weights.push_back(0.5f * (vertices[i].doubleArea + vertices[(i-1)%vertices.size()].doubleArea) / totalDoubleAreaSize);
-          }
-          assert(weights.back() < 1.0f);
-        }
+      v.isBorder = pos.IsBorder();
+      v.vert = tempV;
+      v.doubleArea = vcg::DoubleArea(*pos.F());
+      totalDoubleAreaSize += v.doubleArea;
 
-        // compute I-NN^t to be used for computing the T_i's
-        Matrix33<ScalarType> Tp;
-        for (int i = 0; i < 3; ++i)
-          Tp[i][i] = 1.0f - powf(central_vertex->cN()[i],2);
-        Tp[0][1] = Tp[1][0] = -1.0f * (central_vertex->N()[0] * central_vertex->cN()[1]);
-        Tp[1][2] = Tp[2][1] = -1.0f * (central_vertex->cN()[1] * central_vertex->cN()[2]);
-        Tp[0][2] = Tp[2][0] = -1.0f * (central_vertex->cN()[0] * central_vertex->cN()[2]);
-
-        // for all neighbors vi compute the directional curvatures k_i and the T_i
-        // compute M by summing all w_i k_i T_i T_i^t
-        Matrix33<ScalarType> tempMatrix;
-        Matrix33<ScalarType> M;
-        M.SetZero();
-        for (size_t i = 0; i < vertices.size(); ++i) {
-          CoordType edge = (central_vertex->cP() - vertices[i].vert->cP());
-          float curvature = (2.0f * (central_vertex->cN().dot(edge)) ) / edge.SquaredNorm();
-          CoordType T = (Tp*edge).normalized();
-          tempMatrix.ExternalProduct(T,T);
-          M += tempMatrix * weights[i] * curvature ;
-        }
+      vertices.push_back(v);
+    }
+    while(tempV != firstV);
+
+    // compute the weights for the formula computing matrix M
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      if (vertices[i].isBorder) {
+        weights.push_back(vertices[i].doubleArea / totalDoubleAreaSize);
+      } else {
+        weights.push_back(0.5f * (vertices[i].doubleArea + vertices[(i-1)%vertices.size()].doubleArea) / totalDoubleAreaSize);
+      }
+      assert(weights.back() < 1.0f);
+    }
 
-        // compute vector W for the Householder matrix
-        CoordType W;
-        CoordType e1(1.0f,0.0f,0.0f);
-        if ((e1 - central_vertex->cN()).SquaredNorm() > (e1 + central_vertex->cN()).SquaredNorm())
-          W = e1 - central_vertex->cN();
-        else
-          W = e1 + central_vertex->cN();
-        W.Normalize();
+    // compute I-NN^t to be used for computing the T_i's
+    Matrix33<ScalarType> Tp;
+    for (int i = 0; i < 3; ++i)
+      Tp[i][i] = 1.0f - powf(central_vertex->cN()[i],2);
+    Tp[0][1] = Tp[1][0] = -1.0f * (central_vertex->N()[0] * central_vertex->cN()[1]);
+    Tp[1][2] = Tp[2][1] = -1.0f * (central_vertex->cN()[1] * central_vertex->cN()[2]);
+    Tp[0][2] = Tp[2][0] = -1.0f * (central_vertex->cN()[0] * central_vertex->cN()[2]);
+
+    // for all neighbors vi compute the directional curvatures k_i and the T_i
+    // compute M by summing all w_i k_i T_i T_i^t
+    Matrix33<ScalarType> tempMatrix;
+    Matrix33<ScalarType> M;
+    M.SetZero();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      CoordType edge = (central_vertex->cP() - vertices[i].vert->cP());
+      float curvature = (2.0f * (central_vertex->cN().dot(edge)) ) / edge.SquaredNorm();
+      CoordType T = (Tp*edge).normalized();
+      tempMatrix.ExternalProduct(T,T);
+      M += tempMatrix * weights[i] * curvature ;
+    }
+
+    // compute vector W for the Householder matrix
+    CoordType W;
+    CoordType e1(1.0f,0.0f,0.0f);
+    if ((e1 - central_vertex->cN()).SquaredNorm() > (e1 + central_vertex->cN()).SquaredNorm())
+      W = e1 - central_vertex->cN();
+    else
+      W = e1 + central_vertex->cN();
+    W.Normalize();
 
-        // compute the Householder matrix I - 2WW^t
-        Matrix33<ScalarType> Q;
-        Q.SetIdentity();
-        tempMatrix.ExternalProduct(W,W);
-        Q -= tempMatrix * 2.0f;
+    // compute the Householder matrix I - 2WW^t
+    Matrix33<ScalarType> Q;
+    Q.SetIdentity();
+    tempMatrix.ExternalProduct(W,W);
+    Q -= tempMatrix * 2.0f;
 
-        // compute matrix Q^t M Q
-        Matrix33<ScalarType> QtMQ = (Q.transpose() * M * Q);
+    // compute matrix Q^t M Q
+    Matrix33<ScalarType> QtMQ = (Q.transpose() * M * Q);
 
 //        CoordType bl = Q.GetColumn(0);
-        CoordType T1 = Q.GetColumn(1);
-        CoordType T2 = Q.GetColumn(2);
-
-        // find sin and cos for the Givens rotation
-        float s,c;
-        // Gabriel Taubin hint and Valentino Fiorin impementation
-        float alpha = QtMQ[1][1]-QtMQ[2][2];
-        float beta  = QtMQ[2][1];
-
-        float h[2];
-        float delta = sqrtf(4.0f*powf(alpha, 2) +16.0f*powf(beta, 2));
-        h[0] = (2.0f*alpha + delta) / (2.0f*beta);
-        h[1] = (2.0f*alpha - delta) / (2.0f*beta);
-
-        float t[2];
-        float best_c, best_s;
-        float min_error = std::numeric_limits<ScalarType>::infinity();
-        for (int i=0; i<2; i++)
+    CoordType T1 = Q.GetColumn(1);
+    CoordType T2 = Q.GetColumn(2);
+
+    // find sin and cos for the Givens rotation
+    float s,c;
+    // Gabriel Taubin hint and Valentino Fiorin impementation
+    float alpha = QtMQ[1][1]-QtMQ[2][2];
+    float beta  = QtMQ[2][1];
+
+    float h[2];
+    float delta = sqrtf(4.0f*powf(alpha, 2) +16.0f*powf(beta, 2));
+    h[0] = (2.0f*alpha + delta) / (2.0f*beta);
+    h[1] = (2.0f*alpha - delta) / (2.0f*beta);
+
+    float t[2];
+    float best_c, best_s;
+    float min_error = std::numeric_limits<ScalarType>::infinity();
+    for (int i=0; i<2; i++)
+    {
+      delta = sqrtf(powf(h[i], 2) + 4.0f);
+      t[0] = (h[i]+delta) / 2.0f;
+      t[1] = (h[i]-delta) / 2.0f;
+
+      for (int j=0; j<2; j++)
+      {
+        float squared_t = powf(t[j], 2);
+        float denominator = 1.0f + squared_t;
+        s = (2.0f*t[j])		/ denominator;
+        c = (1-squared_t) / denominator;
+
+        float approximation = c*s*alpha + (powf(c, 2) - powf(s, 2))*beta;
+        float angle_similarity = fabs(acosf(c)/asinf(s));
+        float error = fabs(1.0f-angle_similarity)+fabs(approximation);
+        if (error<min_error)
         {
-          delta = sqrtf(powf(h[i], 2) + 4.0f);
-          t[0] = (h[i]+delta) / 2.0f;
-          t[1] = (h[i]-delta) / 2.0f;
-
-          for (int j=0; j<2; j++)
-          {
-            float squared_t = powf(t[j], 2);
-            float denominator = 1.0f + squared_t;
-            s = (2.0f*t[j])		/ denominator;
-            c = (1-squared_t) / denominator;
-
-            float approximation = c*s*alpha + (powf(c, 2) - powf(s, 2))*beta;
-            float angle_similarity = fabs(acosf(c)/asinf(s));
-            float error = fabs(1.0f-angle_similarity)+fabs(approximation);
-            if (error<min_error)
-            {
-              min_error = error;
-              best_c = c;
-              best_s = s;
-            }
-          }
+          min_error = error;
+          best_c = c;
+          best_s = s;
         }
-        c = best_c;
-        s = best_s;
+      }
+    }
+    c = best_c;
+    s = best_s;
 
-        Eigen::Matrix2f minor2x2;
-        Eigen::Matrix2f S;
+    Eigen::Matrix2f minor2x2;
+    Eigen::Matrix2f S;
 
 
-        // diagonalize M
-        minor2x2(0,0) = QtMQ[1][1];
-        minor2x2(0,1) = QtMQ[1][2];
-        minor2x2(1,0) = QtMQ[2][1];
-        minor2x2(1,1) = QtMQ[2][2];
+    // diagonalize M
+    minor2x2(0,0) = QtMQ[1][1];
+    minor2x2(0,1) = QtMQ[1][2];
+    minor2x2(1,0) = QtMQ[2][1];
+    minor2x2(1,1) = QtMQ[2][2];
 
-        S(0,0) = S(1,1) = c;
-        S(0,1) = s;
-        S(1,0) = -1.0f * s;
+    S(0,0) = S(1,1) = c;
+    S(0,1) = s;
+    S(1,0) = -1.0f * s;
 
-        Eigen::Matrix2f StMS = S.transpose() * minor2x2 * S;
+    Eigen::Matrix2f StMS = S.transpose() * minor2x2 * S;
 
-        // compute curvatures and curvature directions
-        float Principal_Curvature1 = (3.0f * StMS(0,0)) - StMS(1,1);
-        float Principal_Curvature2 = (3.0f * StMS(1,1)) - StMS(0,0);
+    // compute curvatures and curvature directions
+    float Principal_Curvature1 = (3.0f * StMS(0,0)) - StMS(1,1);
+    float Principal_Curvature2 = (3.0f * StMS(1,1)) - StMS(0,0);
 
-        CoordType Principal_Direction1 = T1 * c - T2 * s;
-        CoordType Principal_Direction2 = T1 * s + T2 * c;
+    CoordType Principal_Direction1 = T1 * c - T2 * s;
+    CoordType Principal_Direction2 = T1 * s + T2 * c;
 
-        (*vi).PD1().Import(Principal_Direction1);
-        (*vi).PD2().Import(Principal_Direction2);
-        (*vi).K1() =  Principal_Curvature1;
-        (*vi).K2() =  Principal_Curvature2;
-      }
-    }
+    central_vertex->PD1().Import(Principal_Direction1);
+    central_vertex->PD2().Import(Principal_Direction2);
+    central_vertex->K1() =  Principal_Curvature1;
+    central_vertex->K2() =  Principal_Curvature2;
   }
 
 
@@ -308,9 +327,8 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
     int jj = 0;
     for(vi  = m.vert.begin(); vi != m.vert.end(); ++vi)
     {
-      vcg::Matrix33<ScalarType> A, eigenvectors;
-      vcg::Point3<ScalarType> bp, eigenvalues;
-//      int nrot;
+      vcg::Matrix33<ScalarType> A;
+      vcg::Point3<ScalarType> bp;
 
       // sample the neighborhood
       if(pointVSfaceInt)
@@ -330,12 +348,82 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
         vcg::tri::Inertia<MeshType>::Covariance(tmpM,_bary,A);
       }
 
-//      Eigen::Matrix3f AA; AA=A;
-//      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eig(AA);
-//      Eigen::Vector3f c_val = eig.eigenvalues();
-//      Eigen::Matrix3f c_vec = eig.eigenvectors();
+      PrincipalDirectionsFromCovariance(*vi,A,r);
+      if (cb)
+      {
+        (*cb)(int(100.0f * (float)jj / (float)m.vn),"Vertices Analysis");
+        ++jj;
+      }
+    }
+  }
 
-//      Jacobi(A,  eigenvalues , eigenvectors, nrot);
+  /// \brief Parallel version of PrincipalDirectionsPCA().
+  /**
+   The neighborhood of each vertex is gathered with grid queries that do not use the mesh marks
+   (LocalTmark) into per-thread containers, so vertices are processed concurrently.
+   When pointVSfaceInt is false the face grid queries use the face normals, which must be
+   up to date and normalized; as in the serial version they are not recomputed here.
+   */
+  static void PrincipalDirectionsPCAParallel(MeshType &m, ScalarType r, bool pointVSfaceInt = true)
+  {
+    ScalarType area=0;
+    MeshType tmpM;
+    vcg::tri::TrivialSampler<MeshType> vs;
+    tri::UpdateNormal<MeshType>::PerVertexAngleWeightedParallel(m);
+    tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
+
+    MeshGridType mGrid;
+    PointsGridType pGrid;
+
+    if(pointVSfaceInt)
+    {
+      area = Stat<MeshType>::ComputeMeshArea(m);
+      vcg::tri::SurfaceSampling<MeshType,vcg::tri::TrivialSampler<MeshType> >::Montecarlo(m,vs,1000 * area / (2*M_PI*r*r ));
+      VertexIterator vi = vcg::tri::Allocator<MeshType>::AddVertices(tmpM,m.vert.size());
+      for(size_t y  = 0; y <  m.vert.size(); ++y,++vi)  (*vi).P() =  m.vert[y].P();
+      pGrid.Set(tmpM.vert.begin(),tmpM.vert.end());
+    }
+    else
+    {
+      tri::RequirePerFaceNormal(m);
+      mGrid.Set(m.face.begin(),m.face.end());
+    }
+
+    const int vn=int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int i=0;i<vn;++i)
+    {
+      VertexType &v=m.vert[i];
+      if(v.IsD()) continue;
+      vcg::Matrix33<ScalarType> A;
+      if(pointVSfaceInt)
+      {
+        std::vector<VertexType*> closests;
+        std::vector<ScalarType> distances;
+        std::vector<CoordType> points;
+        vcg::Point3<ScalarType> bp;
+        LocalTmark<MeshType,VertexType> mv;
+        vcg::vertex::PointDistanceFunctor<ScalarType> fn;
+        pGrid.GetInSphere(fn,mv,v.cP(),r,closests,distances,points);
+        A.Covariance(points,bp);
+        A*=area*area/1000;
+      }
+      else
+      {
+        MeshType ballM;
+        IntersectionBallMesh<MeshType,ScalarType>(&mGrid, m ,vcg::Sphere3<ScalarType>(v.cP(),r),ballM);
+        vcg::Point3<ScalarType> _bary;
+        vcg::tri::Inertia<MeshType>::Covariance(ballM,_bary,A);
+      }
+      PrincipalDirectionsFromCovariance(v,A,r);
+    }
+  }
+
+  /// \brief Set principal directions and curvatures of a vertex from the covariance of its neighborhood of radius r.
+  static void PrincipalDirectionsFromCovariance(VertexType &v, const vcg::Matrix33<ScalarType> &A, ScalarType r)
+  {
+      vcg::Matrix33<ScalarType> eigenvectors;
+      vcg::Point3<ScalarType> eigenvalues;
 
       Eigen::Matrix3d AA;
       A.ToEigenMatrix(AA);
@@ -344,47 +432,40 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
       Eigen::Matrix3d c_vec = eig.eigenvectors(); // eigenvector are stored as columns.
       eigenvectors.FromEigenMatrix(c_vec);
       eigenvalues.FromEigenVector(c_val);
-//	  EV.transposeInPlace();
-//	  ev.FromEigenVector(c_val);
 
       // get the estimate of curvatures from eigenvalues and eigenvectors
       // find the 2 most tangent eigenvectors (by finding the one closest to the normal)
-      int best = 0; ScalarType bestv = fabs( (*vi).cN().dot(eigenvectors.GetColumn(0).normalized()) );
+      int best = 0; ScalarType bestv = fabs( v.cN().dot(eigenvectors.GetColumn(0).normalized()) );
       for(int i  = 1 ; i < 3; ++i){
-        ScalarType prod = fabs((*vi).cN().dot(eigenvectors.GetColumn(i).normalized()));
+        ScalarType prod = fabs(v.cN().dot(eigenvectors.GetColumn(i).normalized()));
         if( prod > bestv){bestv = prod; best = i;}
       }
 
-      (*vi).PD1().Import(eigenvectors.GetColumn( (best+1)%3).normalized());
-      (*vi).PD2().Import(eigenvectors.GetColumn( (best+2)%3).normalized());
+      v.PD1().Import(eigenvectors.GetColumn( (best+1)%3).normalized());
+      v.PD2().Import(eigenvectors.GetColumn( (best+2)%3).normalized());
 
       // project them to the plane identified by the normal
       vcg::Matrix33<CurScalarType> rot;
-      CurVecType NN = CurVecType::Construct((*vi).N());
+      CurVecType NN = CurVecType::Construct(v.N());
       CurScalarType angle;
-      angle = acos((*vi).PD1().dot(NN));
-      rot.SetRotateRad(  - (M_PI*0.5 - angle),(*vi).PD1()^NN);
-      (*vi).PD1() = rot*(*vi).PD1();
-      angle = acos((*vi).PD2().dot(NN));
-      rot.SetRotateRad(  - (M_PI*0.5 - angle),(*vi).PD2()^NN);
-      (*vi).PD2() = rot*(*vi).PD2();
+      angle = acos(v.PD1().dot(NN));
+      rot.SetRotateRad(  - (M_PI*0.5 - angle),v.PD1()^NN);
+      v.PD1() = rot*v.PD1();
+      angle = acos(v.PD2().dot(NN));
+      rot.SetRotateRad(  - (M_PI*0.5 - angle),v.PD2()^NN);
+      v.PD2() = rot*v.PD2();
 
 
       // copmutes the curvature values
       const ScalarType r5 = r*r*r*r*r;
       const ScalarType r6 = r*r5;
-      (*vi).K1() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+2)%3]-45.0*eigenvalues[(best+1)%3])/(M_PI*r6);
-      (*vi).K2() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+1)%3]-45.0*eigenvalues[(best+2)%3])/(M_PI*r6);
-      if((*vi).K1() < (*vi).K2())	{	std::swap((*vi).K1(),(*vi).K2());
-        std::swap((*vi).PD1(),(*vi).PD2());
-        if (cb)
-        {
-          (*cb)(int(100.0f * (float)jj / (float)m.vn),"Vertices Analysis");
-          ++jj;
-        }													}
-    }
-
-
+      v.K1() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+2)%3]-45.0*eigenvalues[(best+1)%3])/(M_PI*r6);
+      v.K2() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+1)%3]-45.0*eigenvalues[(best+2)%3])/(M_PI*r6);
+      if(v.K1() < v.K2())
+      {
+        std::swap(v.K1(),v.K2());
+        std::swap(v.PD1(),v.PD2());
+      }
   }
 
 /// \brief Computes the discrete mean gaussian curvature.
@@ -235,78 +235,102 @@ class Quadric
         vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
 
-        VertexIterator vi;
-        for(vi = m.vert.begin(); vi!=m.vert.end(); ++vi )
-        {
-            std::vector<CoordType> ref = computeReferenceFrames(&*vi);
+        for(VertexIterator vi = m.vert.begin(); vi!=m.vert.end(); ++vi )
+            computeCurvatureSingleVertex(&*vi);
+    }
 
-            Quadric q = fitQuadric(&*vi,ref);
-            double a = q.a();
-            double b = q.b();
-            double c = q.c();
-            double d = q.d();
-            double e = q.e();
+    /// \brief Parallel version of computeCurvature().
+    /**
+     Each vertex reads the positions of its second ring and writes only its own normal and curvature,
+     so vertices are processed concurrently.
+     */
+    static void computeCurvatureParallel(MeshType & m)
+    {
+        Allocator<MeshType>::CompactVertexVector(m);
+        tri::RequireCompactness(m);
+        tri::RequireVFAdjacency(m);
 
-            double E = 1.0 + d*d;
-            double F = d*e;
-            double G = 1.0 + e*e;
+        vcg::tri::UpdateTopology<MeshType>::VertexFace(m);
 
-            CoordType n = CoordType(-d,-e,1.0).Normalize();
+        vcg::tri::UpdateNormal<MeshType>::PerVertexAngleWeightedParallel(m);
+        vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
-            vi->N() = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
+        const int vn=int(m.vert.size());
+#pragma omp parallel for schedule(dynamic, 256)
+        for(int i=0; i<vn; ++i)
+            computeCurvatureSingleVertex(&m.vert[i]);
+    }
 
-            double L = 2.0 * a * n.Z();
-            double M = b * n.Z();
-            double N = 2 * c * n.Z();
+    static void computeCurvatureSingleVertex(VertexTypeP vi)
+    {
+        std::vector<CoordType> ref = computeReferenceFrames(vi);
 
-            // ----------------- Eigen stuff
-            Eigen::Matrix2d m;
-            m << L*G - M*F, M*E-L*F, M*E-L*F, N*E-M*F;
-            m = m / (E*G-F*F);
-            Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eig(m);
+        Quadric q = fitQuadric(vi,ref);
+        double a = q.a();
+        double b = q.b();
+        double c = q.c();
+        double d = q.d();
+        double e = q.e();
 
-            Eigen::Vector2d c_val = eig.eigenvalues();
-            Eigen::Matrix2d c_vec = eig.eigenvectors();
+        double E = 1.0 + d*d;
+        double F = d*e;
+        double G = 1.0 + e*e;
 
-            c_val = -c_val;
+        CoordType n = CoordType(-d,-e,1.0).Normalize();
 
-            CoordType v1, v2;
-            v1[0] = c_vec(0,0);
-            v1[1] = c_vec(0,1);
-            v1[2] = 0;
+        vi->N() = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
 
-            v2[0] = c_vec(1,0);
-            v2[1] = c_vec(1,1);
-            v2[2] = 0;
+        double L = 2.0 * a * n.Z();
+        double M = b * n.Z();
+        double N = 2 * c * n.Z();
 
-            v1 = v1.Normalize();
-            v2 = v2.Normalize();
+        // ----------------- Eigen stuff
+        Eigen::Matrix2d m;
+        m << L*G - M*F, M*E-L*F, M*E-L*F, N*E-M*F;
+        m = m / (E*G-F*F);
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eig(m);
 
-            v1 = v1 * c_val[0];
-            v2 = v2 * c_val[1];
+        Eigen::Vector2d c_val = eig.eigenvalues();
+        Eigen::Matrix2d c_vec = eig.eigenvectors();
 
-            CoordType v1global = ref[0] * v1[0] + ref[1] * v1[1] + ref[2] * v1[2];
-            CoordType v2global = ref[0] * v2[0] + ref[1] * v2[1] + ref[2] * v2[2];
+        c_val = -c_val;
 
-            v1global.Normalize();
-            v2global.Normalize();
+        CoordType v1, v2;
+        v1[0] = c_vec(0,0);
+        v1[1] = c_vec(0,1);
+        v1[2] = 0;
 
-            if (c_val[0] > c_val[1])
-            {
-                (*vi).PD1().Import(v1global);
-                (*vi).PD2().Import(v2global);
-                (*vi).K1()  = c_val[0];
-                (*vi).K2()  = c_val[1];
-            }
-            else
-            {
-                (*vi).PD1().Import(v2global);
-                (*vi).PD2().Import(v1global);
-                (*vi).K1()  = c_val[1];
-                (*vi).K2()  = c_val[0];
-            }
-            // ---- end Eigen stuff
+        v2[0] = c_vec(1,0);
+        v2[1] = c_vec(1,1);
+        v2[2] = 0;
+
+        v1 = v1.Normalize();
+        v2 = v2.Normalize();
+
+        v1 = v1 * c_val[0];
+        v2 = v2 * c_val[1];
+
+        CoordType v1global = ref[0] * v1[0] + ref[1] * v1[1] + ref[2] * v1[2];
+        CoordType v2global = ref[0] * v2[0] + ref[1] * v2[1] + ref[2] * v2[2];
+
+        v1global.Normalize();
+        v2global.Normalize();
+
+        if (c_val[0] > c_val[1])
+        {
+            (*vi).PD1().Import(v1global);
+            (*vi).PD2().Import(v2global);
+            (*vi).K1()  = c_val[0];
+            (*vi).K2()  = c_val[1];
         }
+        else
+        {
+            (*vi).PD1().Import(v2global);
+            (*vi).PD2().Import(v1global);
+            (*vi).K1()  = c_val[1];
+            (*vi).K2()  = c_val[0];
+        }
+        // ---- end Eigen stuff
     }
 
     // GG LOCAL CURVATURE
@@ -372,8 +396,8 @@ class Quadric
         {
             assert(VV.size() >= 5);
             Eigen::MatrixXd A(VV.size(),5);
-            Eigen::MatrixXd b(VV.size(),1);
-            Eigen::MatrixXd sol(5,1);
+            Eigen::VectorXd b(VV.size());
+            Eigen::VectorXd sol(5);
 
             for(unsigned int c=0; c < VV.size(); ++c)
             {
@@ -391,7 +415,6 @@ class Quadric
             }
 
 
-            static int count = 0, index = 0;
             double min = 0.000000000001; //1.0e-12
             /*
             if (!count)
@@ -402,20 +425,18 @@ class Quadric
             {
                 //A.svd().solve(b, &sol); A.svd().solve(b, &sol);
                 //cout << sol << endl;
-                printf("Quadric: unsolvable vertex %d %d\n", count, ++index);
+                printf("Quadric: unsolvable vertex\n");
                 //return Quadric (1, 1, 1, 1, 1);
 //                A.svd().solve(b, &sol);
-                Eigen::JacobiSVD<Eigen::MatrixXd> svd(A);
+                Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
                 sol=svd.solve(b);
                 return QuadricLocal(sol[0],sol[1],sol[2],sol[3],sol[4]);
             }
-            count++;
-
             //for (int i = 0; i < 100; i++)
             {
                 if (svdRes)
                 {
-                  Eigen::JacobiSVD<Eigen::MatrixXd> svd(A);
+                  Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
                   sol=svd.solve(b);
                   //A.svd().solve(b, &sol);
                 }
@@ -428,9 +449,10 @@ class Quadric
         }
     };
 
+    template <class RingType = Nring<MeshType> >
     static void expandMaxLocal (MeshType & mesh, VertexType *v, int max, std::vector<VertexType*> *vv)
     {
-    Nring<MeshType> rw = Nring<MeshType> (v, &mesh);
+    RingType rw = RingType (v, &mesh);
     do rw.expand (); while (rw.allV.size() < max+1);
     if (rw.allV[0] != v)
         printf ("rw.allV[0] != *v\n");
@@ -442,9 +464,12 @@ class Quadric
     }
 
 
+    /// Collect the vertices of the rings around v closer than r (at least min of them).
+    /// The RingType defaults to Nring, that uses the V flags; NringLocal can be used to expand concurrently.
+    template <class RingType = Nring<MeshType> >
     static void expandSphereLocal (MeshType & mesh, VertexType *v, float r, int min, std::vector<VertexType*> *vv)
     {
-    Nring<MeshType> rw = Nring<MeshType> (v, &mesh);
+    RingType rw = RingType (v, &mesh);
 
     bool isInside = true;
     while (isInside)
@@ -471,7 +496,7 @@ class Quadric
     if (vv->size() < min)
     {
         vv->clear();
-        expandMaxLocal (mesh, v, min, vv);
+        expandMaxLocal<RingType> (mesh, v, min, vv);
     }
     }
 
@@ -548,7 +573,8 @@ class Quadric
     }
 
 
-    static void finalEigenStuff (VertexType *v, std::vector<CoordType> ref, QuadricLocal q)
+    /// Set the curvature of v from the fitted quadric. The fitted normal is written in *normal if given, in v->N() otherwise.
+    static void finalEigenStuff (VertexType *v, std::vector<CoordType> ref, QuadricLocal q, CoordType *normal = 0)
     {
     double a = q.a();
     double b = q.b();
@@ -562,7 +588,8 @@ class Quadric
 
     CoordType n = CoordType(-d,-e,1.0).Normalize();
 
-    v->N() = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
+    if(normal) *normal = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
+    else v->N() = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
 
     double L = 2.0 * a * n.Z();
     double M = b * n.Z();
@@ -580,12 +607,12 @@ class Quadric
     c_val = -c_val;
 
     CoordType v1, v2;
-    v1[0] = c_vec[0];
-    v1[1] = c_vec[1];
+    v1[0] = c_vec(0,0);
+    v1[1] = c_vec(1,0);
     v1[2] = d * v1[0] + e * v1[1];
 
-    v2[0] = c_vec[2];
-    v2[1] = c_vec[3];
+    v2[0] = c_vec(0,1);
+    v2[1] = c_vec(1,1);
     v2[2] = d * v2[0] + e * v2[1];
 
     v1 = v1.Normalize();
@@ -700,6 +727,47 @@ class Quadric
         printf ("average vertex num in each fit: %f\n", ((float) vertexesPerFit) / mesh.vn);
     }
 
+    /// \brief Parallel version of updateCurvatureLocal().
+    /**
+     Rings are expanded with NringLocal (no V flags) and all the fits read the normals of the input mesh:
+     the fitted normals are stored aside and assigned at the end. For this reason the result does not depend
+     on the vertex order, while the serial version reads the normals already updated by the previous vertices.
+     */
+    static void updateCurvatureLocalParallel (MeshType & mesh, float radiusSphere)
+    {
+    const int vn=int(mesh.vert.size());
+    std::vector<CoordType> fittedNormal(mesh.vert.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int i=0; i<vn; ++i)
+    {
+        VertexType *vp=&mesh.vert[i];
+        if(vp->IsD()) continue;
+        std::vector<VertexType*> vv;
+        std::vector<VertexType*> vvtmp;
+
+        expandSphereLocal<NringLocal<MeshType> > (mesh, vp, radiusSphere, 5, &vv);
+
+        CoordType ppn;
+        getAverageNormal (vp, vv, &ppn);
+
+        vvtmp.reserve (vv.size ());
+        applyProjOnPlane (ppn, vv, &vvtmp);
+        if (vvtmp.size() >= 5)
+            vv = vvtmp;
+
+        std::vector<CoordType> ref;
+        computeReferenceFramesLocal (vp, ppn, &ref);
+
+        QuadricLocal q;
+        fitQuadricLocal (vp, ref, vv, &q);
+
+        finalEigenStuff (vp, ref, q, &fittedNormal[i]);
+    }
+    for(int i=0; i<vn; ++i)
+        if(!mesh.vert[i].IsD())
+            mesh.vert[i].N()=fittedNormal[i];
+    }
+
 };
 
 }
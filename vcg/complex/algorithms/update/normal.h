@@ -162,6 +162,29 @@ static void PerVertexNelsonMaxWeighted(ComputeMeshType &m)
    }
 }
 
+/// \brief Parallel version of PerVertex() for triangle meshes.
+/**
+ Face contributions are computed per wedge in parallel and then gathered per vertex
+ through a vertex-to-wedge table, so no two threads ever write the same vertex normal.
+ Contributions are summed in face order, so the result is the same of PerVertex().
+ */
+static void PerVertexParallel(ComputeMeshType &m)
+{
+  PerVertexGather(m,AreaWeightedWedge);
+}
+
+/// \brief Parallel version of PerVertexAngleWeighted() for triangle meshes.
+static void PerVertexAngleWeightedParallel(ComputeMeshType &m)
+{
+  PerVertexGather(m,AngleWeightedWedge);
+}
+
+/// \brief Parallel version of PerVertexNelsonMaxWeighted() for triangle meshes.
+static void PerVertexNelsonMaxWeightedParallel(ComputeMeshType &m)
+{
+  PerVertexGather(m,NelsonMaxWeightedWedge);
+}
+
 /// \brief Calculates the face normal
 ///
 /// Not normalized. Use PerFaceNormalized() or call NormalizePerVertex() if you need unit length per face normals.
@@ -174,6 +197,53 @@ static void PerFace(ComputeMeshType &m)
 }
 
 
+/// \brief Parallel version of PerFace().
+/**
+ Faces are processed in blocks; the edge vectors of each block are copied in a SoA layout
+ so that the cross product and the normalization run as a vectorizable loop.
+ */
+static void PerFaceParallel(ComputeMeshType &m)
+{
+  RequirePerFaceNormal(m);
+  RequireTriangularMesh(m);
+  const int BlockSize=256;
+  const int fn=int(m.face.size());
+  const int blockNum=(fn+BlockSize-1)/BlockSize;
+#pragma omp parallel for schedule(static)
+  for(int b=0;b<blockNum;++b)
+  {
+    ScalarType e[6][BlockSize];
+    ScalarType n[3][BlockSize];
+    const int first=b*BlockSize;
+    const int cnt=std::min(BlockSize,fn-first);
+    for(int k=0;k<cnt;++k)
+    {
+      const FaceType &f=m.face[first+k];
+      if(f.IsD()) { for(int c=0;c<6;++c) e[c][k]=0; continue; }
+      const CoordType e0=f.cP(1)-f.cP(0);
+      const CoordType e1=f.cP(2)-f.cP(0);
+      e[0][k]=e0[0]; e[1][k]=e0[1]; e[2][k]=e0[2];
+      e[3][k]=e1[0]; e[4][k]=e1[1]; e[5][k]=e1[2];
+    }
+#pragma omp simd
+    for(int k=0;k<cnt;++k)
+    {
+      const ScalarType nx=e[1][k]*e[5][k]-e[2][k]*e[4][k];
+      const ScalarType ny=e[2][k]*e[3][k]-e[0][k]*e[5][k];
+      const ScalarType nz=e[0][k]*e[4][k]-e[1][k]*e[3][k];
+      const ScalarType len=std::sqrt(nx*nx+ny*ny+nz*nz);
+      const ScalarType inv= len>0 ? ScalarType(1)/len : ScalarType(0);
+      n[0][k]=nx*inv; n[1][k]=ny*inv; n[2][k]=nz*inv;
+    }
+    for(int k=0;k<cnt;++k)
+    {
+      FaceType &f=m.face[first+k];
+      if(!f.IsD())
+        f.N()=typename FaceType::NormalType(n[0][k],n[1][k],n[2][k]);
+    }
+  }
+}
+
 /// \brief computePerPolygonalFace computes the normal of each polygonal face.
 ///
 /// Not normalized. Use PerPolygonalFaceNormalized() or call NormalizePerFace() if you need unit length per face normals.
@@ -453,6 +523,87 @@ static void PerFaceRW(ComputeMeshType &m, bool normalize=false)
 }
 
 
+private:
+/// Per wedge contribution functors used by PerVertexGather; each one fills the three wedge normals of a face.
+static void AreaWeightedWedge(const FaceType &f, NormalType *wn)
+{
+  const NormalType t = vcg::TriangleNormal(f);
+  wn[0]=wn[1]=wn[2]=t;
+}
+
+static void AngleWeightedWedge(const FaceType &f, NormalType *wn)
+{
+  const NormalType t = TriangleNormal(f).Normalize();
+  const NormalType e0 = (f.cP(1)-f.cP(0)).Normalize();
+  const NormalType e1 = (f.cP(2)-f.cP(1)).Normalize();
+  const NormalType e2 = (f.cP(0)-f.cP(2)).Normalize();
+  wn[0]=t*AngleN(e0,-e2);
+  wn[1]=t*AngleN(-e0,e1);
+  wn[2]=t*AngleN(-e1,e2);
+}
+
+static void NelsonMaxWeightedWedge(const FaceType &f, NormalType *wn)
+{
+  const NormalType t = TriangleNormal(f);
+  const ScalarType e0 = SquaredDistance(f.cP(0),f.cP(1));
+  const ScalarType e1 = SquaredDistance(f.cP(1),f.cP(2));
+  const ScalarType e2 = SquaredDistance(f.cP(2),f.cP(0));
+  wn[0]=t/(e0*e2);
+  wn[1]=t/(e0*e1);
+  wn[2]=t/(e1*e2);
+}
+
+/// \brief Build for each vertex the list of the wedges (3*faceIndex+j) referring to it, in CSR layout.
+/// Wedges are listed in face order so that the gather sums them in the same order of the serial scatter.
+static void VertexWedgeTable(ComputeMeshType &m, std::vector<int> &start, std::vector<int> &wedge)
+{
+  start.assign(m.vert.size()+1,0);
+  for(size_t i=0;i<m.face.size();++i)
+    if(!m.face[i].IsD())
+      for(int j=0;j<3;++j)
+        ++start[tri::Index(m,m.face[i].cV(j))+1];
+  for(size_t i=0;i<m.vert.size();++i)
+    start[i+1]+=start[i];
+  wedge.resize(start.back());
+  std::vector<int> pos(start.begin(),start.end()-1);
+  for(size_t i=0;i<m.face.size();++i)
+    if(!m.face[i].IsD())
+      for(int j=0;j<3;++j)
+        wedge[pos[tri::Index(m,m.face[i].cV(j))]++]=int(i*3+j);
+}
+
+/// \brief Race free per vertex accumulation: wedge contributions are computed in parallel over faces
+/// and then gathered in parallel over vertices. Vertices not referenced by any face are left untouched.
+static void PerVertexGather(ComputeMeshType &m, void (*wedgeFunc)(const FaceType &, NormalType *))
+{
+  RequirePerVertexNormal(m);
+  RequireTriangularMesh(m);
+  const int fn=int(m.face.size());
+  const int vn=int(m.vert.size());
+  std::vector<NormalType> wn(m.face.size()*3);
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<fn;++i)
+  {
+    const FaceType &f=m.face[i];
+    if(!f.IsD() && f.IsR()) wedgeFunc(f,&wn[i*3]);
+    else wn[i*3]=wn[i*3+1]=wn[i*3+2]=NormalType(0,0,0);
+  }
+
+  std::vector<int> start,wedge;
+  VertexWedgeTable(m,start,wedge);
+
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<vn;++i)
+  {
+    VertexType &v=m.vert[i];
+    if(start[i]==start[i+1] || v.IsD() || !v.IsRW()) continue;
+    NormalType n(0,0,0);
+    for(int k=start[i];k<start[i+1];++k)
+      n+=wn[wedge[k]];
+    v.N()=n;
+  }
+}
+
 }; // end class
 
 }	// End namespace
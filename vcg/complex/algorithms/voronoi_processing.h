@@ -57,6 +57,7 @@ struct VoronoiProcessingParameter
     triangulateRegion=false;
     unbiasedSeedFlag = true;
     geodesicRelaxFlag = true;
+    incrementalRelaxFlag = false;
     relaxOnlyConstrainedFlag=false;
     refinementRatio = 5.0f;
     seedPerturbationProbability=0;
@@ -98,6 +99,8 @@ struct VoronoiProcessingParameter
   float collapseShortEdgePerc;
 
   bool geodesicRelaxFlag;
+  bool incrementalRelaxFlag;    /// If true during relaxation the partition is updated only around the seeds that moved
+                                /// (see ParallelGeodesic::Update) instead of being recomputed from scratch at each step.
 };
 
 template <class MeshType, class DistanceFunctor = EuclideanDistance<MeshType> >
@@ -1301,13 +1304,19 @@ static int VoronoiRelaxing(MeshType &m, std::vector<VertexType *> &seedVec,
   tri::UpdateFlags<MeshType>::VertexBorderFromFaceBorder(m);
   PerVertexPointerHandle sources = tri::Allocator<MeshType>:: template GetPerVertexAttribute<VertexPointer> (m,"sources");
   PerVertexBoolHandle fixed = tri::Allocator<MeshType>:: template GetPerVertexAttribute<bool> (m,"fixed");
+  ParallelGeodesic<MeshType> *incGeo = vpp.incrementalRelaxFlag ? new ParallelGeodesic<MeshType>(m) : 0;
   int iter;
   for(iter=0;iter<relaxIter;++iter)
   {
     if(cb) cb(iter*100/relaxIter,"Voronoi Lloyd Relaxation: First Partitioning");
 
     // first run: find for each point what is the closest to one of the seeds.
-    tri::Geodesic<MeshType>::Compute(m, seedVec, df,std::numeric_limits<ScalarType>::max(),0,&sources);
+    if(incGeo==0)
+      tri::Geodesic<MeshType>::Compute(m, seedVec, df,std::numeric_limits<ScalarType>::max(),0,&sources);
+    else if(iter==0)
+      incGeo->Compute(seedVec, df,std::numeric_limits<ScalarType>::max(),0,&sources);
+    else
+      incGeo->Update(seedVec, df, &sources);
 
     if(vpp.colorStrategy == VoronoiProcessingParameter::DistanceFromSeed)
       tri::UpdateColor<MeshType>::PerVertexQualityRamp(m);
@@ -1350,7 +1359,13 @@ static int VoronoiRelaxing(MeshType &m, std::vector<VertexType *> &seedVec,
 
   // Last run: Needed if we have changed the seed set to leave the sources handle correct.
   if(iter==relaxIter)
-    tri::Geodesic<MeshType>::Compute(m, seedVec, df,std::numeric_limits<ScalarType>::max(),0,&sources);
+  {
+    if(incGeo==0)
+      tri::Geodesic<MeshType>::Compute(m, seedVec, df,std::numeric_limits<ScalarType>::max(),0,&sources);
+    else
+      incGeo->Update(seedVec, df, &sources);
+  }
+  delete incGeo;
 
   if(vpp.relaxOnlyConstrainedFlag)
   {
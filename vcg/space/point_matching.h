@@ -72,30 +72,51 @@ void ComputeCrossCovarianceMatrix(const std::vector<Point3<S> > &spVec, Point3<S
     m-=spe*tpe.transpose();
 }
 
-/*! \brief Compute the roto-translation that applied to PMov bring them onto Pfix
- * Rotation is computed as a quaternion.
- *
- * E.g. it find a matrix such that:
- *
- *       Pfix[i] = res * Pmov[i]
- *
- * Ref:
- * Besl, McKay
- * A method for registration of 3d Shapes
- * IEEE TPAMI Vol 14, No 2 1992
- */
+/*! \brief Compute the weighted cross covariance
 
-template < class  S >
-void ComputeRigidMatchMatrix(std::vector<Point3<S> > &Pfix,
-                             std::vector<Point3<S> > &Pmov,
-                             Quaternion<S>  &q,
-                             Point3<S>  &tr)
+Same as ComputeCrossCovarianceMatrix() but each pair of points contributes with its own (non negative) weight;
+the barycenters are weighted too.
+*/
+template <class S >
+void ComputeWeightedCrossCovarianceMatrix(const std::vector<Point3<S> > &spVec, Point3<S> &spBarycenter,
+                                          const std::vector<Point3<S> > &tpVec, Point3<S> &tpBarycenter,
+                                          const std::vector<S> &weightVec,
+                                          Eigen::Matrix3d &m)
 {
-  Eigen::Matrix3d ccm;
-  Point3<S> bfix,bmov; // baricenter of src e trg
-
-  ComputeCrossCovarianceMatrix(Pmov,bmov,Pfix,bfix,ccm);
+    assert(spVec.size()==tpVec.size() && spVec.size()==weightVec.size());
+    m.setZero();
+    Eigen::Vector3d spe,tpe;
+    Eigen::Vector3d sb(0,0,0),tb(0,0,0);
+    double wSum=0;
+    for(size_t i=0;i<spVec.size();++i){
+        const double w=weightVec[i];
+        spVec[i].ToEigenVector(spe);
+        tpVec[i].ToEigenVector(tpe);
+        sb+=w*spe;
+        tb+=w*tpe;
+        m+=w*spe*tpe.transpose();
+        wSum+=w;
+    }
+    if(wSum>0){
+        sb/=wSum;
+        tb/=wSum;
+        m/=wSum;
+    }
+    m-=sb*tb.transpose();
+    spBarycenter.FromEigenVector(sb);
+    tpBarycenter.FromEigenVector(tb);
+}
 
+/*! \brief Compute the roto-translation from the cross covariance matrix (of the moving and the fix points) and their barycenters.
+ * Rotation is computed as a quaternion (see ComputeRigidMatchMatrix()).
+ */
+template < class  S >
+void ComputeRigidMatchFromCrossCovariance(const Eigen::Matrix3d &ccm,
+                                          const Point3<S> &bfix,
+                                          const Point3<S> &bmov,
+                                          Quaternion<S>  &q,
+                                          Point3<S>  &tr)
+{
   Eigen::Matrix3d cyc; // the cyclic components of the cross covariance matrix.
   cyc=ccm-ccm.transpose();
 
@@ -129,6 +150,32 @@ void ComputeRigidMatchMatrix(std::vector<Point3<S> > &Pfix,
   tr= (bfix - Rot*bmov);
 }
 
+/*! \brief Compute the roto-translation that applied to PMov bring them onto Pfix
+ * Rotation is computed as a quaternion.
+ *
+ * E.g. it find a matrix such that:
+ *
+ *       Pfix[i] = res * Pmov[i]
+ *
+ * Ref:
+ * Besl, McKay
+ * A method for registration of 3d Shapes
+ * IEEE TPAMI Vol 14, No 2 1992
+ */
+
+template < class  S >
+void ComputeRigidMatchMatrix(std::vector<Point3<S> > &Pfix,
+                             std::vector<Point3<S> > &Pmov,
+                             Quaternion<S>  &q,
+                             Point3<S>  &tr)
+{
+  Eigen::Matrix3d ccm;
+  Point3<S> bfix,bmov; // baricenter of src e trg
+
+  ComputeCrossCovarianceMatrix(Pmov,bmov,Pfix,bfix,ccm);
+  ComputeRigidMatchFromCrossCovariance(ccm,bfix,bmov,q,tr);
+}
+
 
 /*! \brief Compute the roto-translation that applied to PMov bring them onto Pfix
  * Rotation is computed as a quaternion.
@@ -161,6 +208,105 @@ void ComputeRigidMatchMatrix(std::vector<Point3<S> > &Pfix,
     res=Trn*Rot;
 }
 
+/*! \brief Weighted version of ComputeRigidMatchMatrix()
+ *
+ * It finds the matrix minimizing sum_i weight[i] * |Pfix[i] - res * Pmov[i]|^2
+ */
+template < class  S >
+void ComputeWeightedRigidMatchMatrix(const std::vector<Point3<S> > &Pfix,
+                                     const std::vector<Point3<S> > &Pmov,
+                                     const std::vector<S> &weight,
+                                     Matrix44<S> &res)
+{
+    Eigen::Matrix3d ccm;
+    Point3<S> bfix,bmov;
+    ComputeWeightedCrossCovarianceMatrix(Pmov,bmov,Pfix,bfix,weight,ccm);
+    Quaternion<S>  q;
+    Point3<S>  tr;
+    ComputeRigidMatchFromCrossCovariance(ccm,bfix,bmov,q,tr);
+
+    Matrix44<S> Rot;
+    q.ToMatrix(Rot);
+    Matrix44<S> Trn;
+    Trn.SetTranslate(tr);
+    res=Trn*Rot;
+}
+
+/*! \brief Compute the roto-translation that minimizes the weighted point to plane distances
+ *
+ * It finds the matrix minimizing sum_i weight[i] * ((res * Pmov[i] - Pfix[i]) * Nfix[i])^2,
+ * with Nfix the unit normals at the fix points. The rotation is linearized (small angles),
+ * so the result is exact only for small motions and it is meant to be iterated (as in ICP);
+ * the returned matrix is anyway a true roto-translation. The rotation is computed around the
+ * barycenter of Pmov for a better conditioning. Returns false if the system is degenerate
+ * (e.g. all the points on a plane, a cylinder or a sphere), that is if the smallest pivot of its
+ * LDLT factorization is less than 1e-6 times the largest one.
+ *
+ * Ref:
+ * K.Low
+ * Linear Least-Squares Optimization for Point-to-Plane ICP Surface Registration
+ * Tech. Rep. TR04-004, University of North Carolina 2004
+ */
+template < class  S >
+bool ComputeRigidMatchMatrixPointToPlane(const std::vector<Point3<S> > &Pfix,
+                                         const std::vector<Point3<S> > &Nfix,
+                                         const std::vector<Point3<S> > &Pmov,
+                                         const std::vector<S> &weight,
+                                         Matrix44<S> &res)
+{
+    assert(Pfix.size()==Pmov.size() && Nfix.size()==Pmov.size() && weight.size()==Pmov.size());
+    typedef Point3<double> Point3x;
+    Point3x c(0,0,0);
+    double wSum=0;
+    for(size_t i=0;i<Pmov.size();++i){
+        c+=Point3x::Construct(Pmov[i])*double(weight[i]);
+        wSum+=weight[i];
+    }
+    res.SetIdentity();
+    if(wSum<=0) return false;
+    c/=wSum;
+    // rms distance from the barycenter: the rotation is solved in units of 1/radius,
+    // so that the pivots of the rotation and of the translation are comparable
+    double radius=0;
+    for(size_t i=0;i<Pmov.size();++i)
+        radius+=double(weight[i])*(Point3x::Construct(Pmov[i])-c).SquaredNorm();
+    radius=std::sqrt(radius/wSum);
+    if(radius<=0) return false;
+
+    // unknowns: x = (rotation vector * radius, translation), row of each pair: [ (p-c)/radius ^ n , n ]
+    Eigen::Matrix<double,6,6> A;
+    Eigen::Matrix<double,6,1> b;
+    A.setZero(); b.setZero();
+    for(size_t i=0;i<Pmov.size();++i){
+        const Point3x p=Point3x::Construct(Pmov[i])-c;
+        const Point3x n=Point3x::Construct(Nfix[i]);
+        const Point3x pn=(p/radius)^n;
+        Eigen::Matrix<double,6,1> row;
+        row<<pn[0],pn[1],pn[2],n[0],n[1],n[2];
+        const double r=(Point3x::Construct(Pfix[i])-c-p)*n;
+        A+=double(weight[i])*row*row.transpose();
+        b+=double(weight[i])*r*row;
+    }
+    Eigen::LDLT<Eigen::Matrix<double,6,6> > ldlt(A);
+    if(ldlt.info()!=Eigen::Success) return false;
+    // A is positive semidefinite: a (nearly) singular one still passes isPositive(), test the pivots
+    const Eigen::Matrix<double,6,1> pivot=ldlt.vectorD();
+    if(!(pivot.minCoeff()>1e-6*pivot.maxCoeff())) return false;
+    const Eigen::Matrix<double,6,1> x=ldlt.solve(b);
+    if(!x.allFinite()) return false;
+
+    // res = T(c+t) * R * T(-c), with R the exact rotation of the rotation vector
+    Point3x w(x[0]/radius,x[1]/radius,x[2]/radius);
+    const double angle=w.Norm();
+    Matrix44<S> rot,tc,tmc;
+    rot.SetIdentity();
+    if(angle>0) rot.SetRotateRad(S(angle),Point3<S>::Construct(w/angle));
+    tc.SetTranslate(Point3<S>::Construct(c+Point3x(x[3],x[4],x[5])));
+    tmc.SetTranslate(Point3<S>::Construct(-c));
+    res=tc*rot*tmc;
+    return true;
+}
+
 
 /*
 Compute a similarity matching (rigid + uniform scaling)